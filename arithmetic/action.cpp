@@ -1,5 +1,7 @@
 #include "action.h"
 #include "algorithm.h"
+#include "trace.h"
+#include "builder.h"
 
 namespace arithmetic
 {
@@ -164,13 +166,17 @@ State Parallel::evaluate(const State &curr, TypeSet types) {
 }
 
 Expression Parallel::guard() {
-	Expression result = Expression::vdd();
+	Builder b;
+	Handle result = b.of(Expression::vdd());
 	for (auto a = actions.begin(); a != actions.end(); a++) {
 		if (not a->rvalue.isConstant()) {
-			result = result & a->rvalue;
+			result = result & b.of(a->rvalue);
+		} else if (a->isPassive() and a->rvalue.isNeutral()) {
+			// a guard that can never pass
+			return Expression::gnd();
 		}
 	}
-	return result;
+	return b.take(result);
 }
 
 void Parallel::applyVars(const Mapping<size_t> &m) {
@@ -295,7 +301,25 @@ bool Choice::isPassive() const {
 	return true;
 }
 
+// Whether at most one term's guard can pass at a time
+bool Choice::isMutex() const {
+	vector<Expression> guards;
+	for (auto i = terms.begin(); i != terms.end(); i++) {
+		guards.push_back(Parallel(*i).guard());
+	}
+
+	for (size_t i = 0; i < guards.size(); i++) {
+		for (size_t j = i+1; j < guards.size(); j++) {
+			if (not areMutex(guards[i], guards[j])) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 Region Choice::evaluate(const State &curr, TypeSet types) {
+	TraceScope trace("Choice::evaluate");
 	Region result;
 	for (auto i = terms.begin(); i != terms.end(); i++) {
 		result.states.push_back(i->evaluate(curr, types));
@@ -308,11 +332,12 @@ Expression Choice::guard() {
 		return Expression::vdd();
 	}
 
-	Expression result = Expression::gnd();
+	Builder b;
+	Handle result = b.of(Expression::gnd());
 	for (auto t = terms.begin(); t != terms.end(); t++) {
-		result = result | t->guard();
+		result = result | b.of(t->guard());
 	}
-	return result;
+	return b.take(result);
 }
 
 void Choice::applyVars(const Mapping<size_t> &m) {
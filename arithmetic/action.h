@@ -82,6 +82,7 @@ struct Choice {
 	bool isInfeasible() const;
 	bool isVacuous() const;
 	bool isPassive() const;
+	bool isMutex() const;
 
 	Region evaluate(const State &curr, TypeSet types=TypeSet());
 	Expression guard();
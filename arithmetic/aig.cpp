@@ -0,0 +1,585 @@
+#include "aig.h"
+#include "algorithm.h"
+#include "bdd.h"
+
+#include <common/text.h>
+
+namespace arithmetic {
+
+const Aig::Literal Aig::ZERO;
+const Aig::Literal Aig::ONE;
+
+Aig::Aig() {
+	// the constant
+	nodes.push_back({ZERO, ZERO});
+}
+
+Aig::~Aig() {
+}
+
+Aig::Literal Aig::complement(Literal a) {
+	return a^1u;
+}
+
+uint32_t Aig::nodeOf(Literal a) {
+	return a>>1;
+}
+
+bool Aig::isComplemented(Literal a) {
+	return (a&1u) != 0;
+}
+
+bool Aig::isGate(uint32_t node) const {
+	return nodes[node][0] != nodes[node][1];
+}
+
+size_t Aig::gates() const {
+	return nodes.size()-1-inputs.size();
+}
+
+Aig::Literal Aig::input() {
+	uint32_t node = (uint32_t)nodes.size();
+	nodes.push_back({ZERO, ZERO});
+	inputs.push_back(node);
+	return node*2;
+}
+
+Aig::Literal Aig::andOf(Literal a, Literal b) {
+	if (a > b) {
+		std::swap(a, b);
+	}
+
+	if (a == ZERO or a == complement(b)) {
+		return ZERO;
+	} else if (a == ONE or a == b) {
+		return b;
+	}
+
+	uint64_t key = ((uint64_t)a<<32) | (uint64_t)b;
+	auto pos = table.find(key);
+	if (pos != table.end()) {
+		return pos->second;
+	}
+
+	Literal result = (Literal)nodes.size()*2;
+	nodes.push_back({a, b});
+	table.insert({key, result});
+	return result;
+}
+
+Aig::Literal Aig::orOf(Literal a, Literal b) {
+	return complement(andOf(complement(a), complement(b)));
+}
+
+Aig::Literal Aig::xorOf(Literal a, Literal b) {
+	return orOf(andOf(a, complement(b)), andOf(complement(a), b));
+}
+
+Aig::Literal Aig::mux(Literal s, Literal t, Literal f) {
+	if (t == f) {
+		return t;
+	}
+	return orOf(andOf(s, t), andOf(complement(s), f));
+}
+
+vector<uint64_t> Aig::simulate(const vector<uint64_t> &values) const {
+	vector<uint64_t> result(nodes.size(), 0);
+	size_t next = 0;
+	for (size_t i = 1; i < nodes.size(); i++) {
+		if (isGate((uint32_t)i)) {
+			result[i] = valueOf(result, nodes[i][0]) & valueOf(result, nodes[i][1]);
+		} else if (next < values.size()) {
+			result[i] = values[next++];
+		}
+	}
+	return result;
+}
+
+uint64_t Aig::valueOf(const vector<uint64_t> &values, Literal a) {
+	uint64_t result = values[nodeOf(a)];
+	return isComplemented(a) ? ~result : result;
+}
+
+BitBlaster::BitBlaster() {
+}
+
+BitBlaster::~BitBlaster() {
+}
+
+vector<BitBlaster::Literal> BitBlaster::variable(size_t index, Type type) {
+	auto pos = vars.find(index);
+	if (pos != vars.end()) {
+		return pos->second;
+	}
+
+	int width = std::min(63, std::max(1, digitsOf(type)));
+	vector<Literal> result;
+	for (int i = 0; i < width; i++) {
+		result.push_back(aig.input());
+	}
+	// unsigned
+	result.push_back(Aig::ZERO);
+	vars.insert({index, result});
+	return result;
+}
+
+vector<BitBlaster::Literal> BitBlaster::constant(int64_t value) {
+	vector<Literal> result;
+	for (int i = 0; i < 64; i++) {
+		result.push_back(((value>>i)&1) ? Aig::ONE : Aig::ZERO);
+	}
+	return trim(result);
+}
+
+// Sign extend or truncate a to width bits
+vector<BitBlaster::Literal> BitBlaster::extend(vector<Literal> a, size_t width) {
+	Literal sign = a.empty() ? Aig::ZERO : a.back();
+	a.resize(width, sign);
+	return a;
+}
+
+// Wrap at 64 bits, then drop any sign bits that are copies of the bit below
+vector<BitBlaster::Literal> BitBlaster::trim(vector<Literal> a) {
+	if (a.size() > 64u) {
+		a.resize(64);
+	}
+	while (a.size() > 1u and a[a.size()-1] == a[a.size()-2]) {
+		a.pop_back();
+	}
+	return a;
+}
+
+BitBlaster::Literal BitBlaster::truth(const vector<Literal> &a) {
+	Literal result = Aig::ZERO;
+	for (auto i = a.begin(); i != a.end(); i++) {
+		result = aig.orOf(result, *i);
+	}
+	return result;
+}
+
+vector<BitBlaster::Literal> BitBlaster::boolOf(Literal a) {
+	return vector<Literal>({a, Aig::ZERO});
+}
+
+// A ripple carry adder one bit wider than the widest argument
+vector<BitBlaster::Literal> BitBlaster::add(vector<Literal> a, vector<Literal> b, Literal carry) {
+	size_t width = std::max(a.size(), b.size())+1;
+	a = extend(a, width);
+	b = extend(b, width);
+
+	vector<Literal> result;
+	for (size_t i = 0; i < width; i++) {
+		Literal half = aig.xorOf(a[i], b[i]);
+		result.push_back(aig.xorOf(half, carry));
+		carry = aig.orOf(aig.andOf(a[i], b[i]), aig.andOf(carry, half));
+	}
+	return trim(result);
+}
+
+vector<BitBlaster::Literal> BitBlaster::negate(vector<Literal> a) {
+	a = extend(a, a.size()+1);
+	for (auto i = a.begin(); i != a.end(); i++) {
+		*i = Aig::complement(*i);
+	}
+	return add(a, constant(0), Aig::ONE);
+}
+
+vector<BitBlaster::Literal> BitBlaster::subtract(vector<Literal> a, vector<Literal> b) {
+	b = extend(b, std::max(a.size(), b.size())+1);
+	for (auto i = b.begin(); i != b.end(); i++) {
+		*i = Aig::complement(*i);
+	}
+	return add(a, b, Aig::ONE);
+}
+
+// Shift and add. The low bits of a two's complement product don't depend on
+// the sign, so the partial products are formed from the sign extended
+// arguments and truncated.
+vector<BitBlaster::Literal> BitBlaster::multiply(vector<Literal> a, vector<Literal> b) {
+	size_t width = std::min((size_t)64, a.size()+b.size());
+	a = extend(a, width);
+	b = extend(b, width);
+
+	vector<Literal> result(width, Aig::ZERO);
+	for (size_t i = 0; i < width; i++) {
+		if (a[i] == Aig::ZERO) {
+			continue;
+		}
+
+		Literal carry = Aig::ZERO;
+		for (size_t j = i; j < width; j++) {
+			Literal bit = aig.andOf(a[i], b[j-i]);
+			Literal half = aig.xorOf(result[j], bit);
+			Literal next = aig.orOf(aig.andOf(result[j], bit), aig.andOf(carry, half));
+			result[j] = aig.xorOf(half, carry);
+			carry = next;
+		}
+	}
+	return trim(result);
+}
+
+// Restoring division on the magnitudes, then the signs are fixed so the
+// quotient truncates toward zero and the remainder takes the sign of a.
+vector<BitBlaster::Literal> BitBlaster::divide(vector<Literal> a, vector<Literal> b, bool remainder) {
+	size_t width = std::min((size_t)64, std::max(a.size(), b.size())+1);
+	a = extend(a, width);
+	b = extend(b, width);
+	Literal sa = a.back();
+	Literal sb = b.back();
+
+	// magnitudes as width bit unsigned numbers
+	a = mux(sa, extend(negate(a), width), a);
+	b = mux(sb, extend(negate(b), width), b);
+	a.push_back(Aig::ZERO);
+	b.push_back(Aig::ZERO);
+
+	vector<Literal> q(width+1, Aig::ZERO);
+	vector<Literal> r(width+1, Aig::ZERO);
+	for (size_t i = width; i-- > 0; ) {
+		// r is always less than b, so its top bit is zero before the shift
+		r.insert(r.begin(), a[i]);
+		r.pop_back();
+		vector<Literal> diff = extend(subtract(r, b), width+2);
+		Literal fits = Aig::complement(diff.back());
+		r = mux(fits, extend(diff, width+1), r);
+		q[i] = fits;
+	}
+
+	Literal sign = remainder ? sa : aig.xorOf(sa, sb);
+	vector<Literal> result = remainder ? r : q;
+	return trim(mux(sign, negate(result), result));
+}
+
+vector<BitBlaster::Literal> BitBlaster::shiftLeft(vector<Literal> a, vector<Literal> b) {
+	bool fixed = true;
+	int64_t amount = 0;
+	for (size_t k = 0; k < b.size() and fixed; k++) {
+		fixed = (b[k] == Aig::ZERO or b[k] == Aig::ONE);
+		if (fixed and b[k] == Aig::ONE) {
+			amount |= ((int64_t)1)<<std::min(k, (size_t)63);
+		}
+	}
+
+	if (fixed) {
+		if (amount < 0 or amount >= 64) {
+			return constant(0);
+		}
+		a.insert(a.begin(), (size_t)amount, Aig::ZERO);
+		return trim(a);
+	}
+
+	// Barrel shifter over the low six bits of the amount
+	a = extend(a, 64);
+	for (size_t k = 0; k < 6 and k < b.size(); k++) {
+		size_t step = (size_t)1<<k;
+		vector<Literal> shifted(step, Aig::ZERO);
+		shifted.insert(shifted.end(), a.begin(), a.end()-step);
+		a = mux(b[k], shifted, a);
+	}
+	return trim(a);
+}
+
+vector<BitBlaster::Literal> BitBlaster::shiftRight(vector<Literal> a, vector<Literal> b) {
+	Literal sign = a.back();
+	for (size_t k = 0; k < 6 and k < b.size(); k++) {
+		size_t step = (size_t)1<<k;
+		vector<Literal> shifted;
+		if (step < a.size()) {
+			shifted.insert(shifted.end(), a.begin()+step, a.end());
+		}
+		shifted.resize(a.size(), sign);
+		a = mux(b[k], shifted, a);
+	}
+	return trim(a);
+}
+
+vector<BitBlaster::Literal> BitBlaster::mux(Literal s, vector<Literal> t, vector<Literal> f) {
+	size_t width = std::max(t.size(), f.size());
+	t = extend(t, width);
+	f = extend(f, width);
+	for (size_t i = 0; i < width; i++) {
+		t[i] = aig.mux(s, t[i], f[i]);
+	}
+	return t;
+}
+
+BitBlaster::Literal BitBlaster::equal(vector<Literal> a, vector<Literal> b) {
+	size_t width = std::max(a.size(), b.size());
+	a = extend(a, width);
+	b = extend(b, width);
+	Literal result = Aig::ONE;
+	for (size_t i = 0; i < width; i++) {
+		result = aig.andOf(result, Aig::complement(aig.xorOf(a[i], b[i])));
+	}
+	return result;
+}
+
+// signed a < b
+BitBlaster::Literal BitBlaster::less(vector<Literal> a, vector<Literal> b) {
+	size_t width = std::max(a.size(), b.size())+1;
+	return extend(subtract(a, b), width).back();
+}
+
+vector<BitBlaster::Literal> BitBlaster::blast(ConstOperationSet ops, Operand top, const vector<Type> &types) {
+	map<size_t, vector<Literal> > exprs;
+	auto get = [&](Operand o, bool &ok) -> vector<Literal> {
+		if (o.isExpr()) {
+			auto pos = exprs.find(o.index);
+			if (pos != exprs.end()) {
+				return pos->second;
+			}
+		} else if (o.isVar()) {
+			return variable(o.index, o.index < types.size() ? types[o.index] : Type());
+		} else if (o.isConst() and o.cnst.isValid()) {
+			if (o.cnst.type == Value::INT) {
+				return constant(o.cnst.ival);
+			} else if (o.cnst.type == Value::BOOL) {
+				return boolOf(o.cnst.bval ? Aig::ONE : Aig::ZERO);
+			} else if (o.cnst.type == Value::WIRE) {
+				return boolOf(Aig::ONE);
+			}
+		} else if (o.isConst() and o.cnst.isNeutral()) {
+			return boolOf(Aig::ZERO);
+		}
+		printf("error: unable to bit-blast operand %s\n", ::to_string(o).c_str());
+		ok = false;
+		return vector<Literal>();
+	};
+
+	if (not top.isExpr()) {
+		bool ok = true;
+		return get(top, ok);
+	}
+
+	// Whether each expression is a wire. Anything else that's valid is vdd
+	// to a wire operator, like wireOf(), even when it's zero.
+	map<size_t, bool> wires;
+	auto isWire = [&](Operand o) -> bool {
+		if (o.isExpr()) {
+			return wires[o.index];
+		}
+		return o.isConst() and (o.cnst.type == Value::WIRE or o.cnst.isNeutral());
+	};
+
+	for (ConstUpIterator i(ops, {top}); not i.done(); ++i) {
+		bool ok = true;
+		vector<vector<Literal> > args;
+		vector<Literal> valid;
+		for (auto j = i->operands.begin(); j != i->operands.end() and ok; j++) {
+			args.push_back(get(*j, ok));
+			valid.push_back(isWire(*j) ? truth(args.back()) : Aig::ONE);
+		}
+		if (not ok or args.empty()) {
+			return vector<Literal>();
+		}
+
+		bool wire = false;
+		vector<Literal> result;
+		switch (i->func) {
+		case Operation::IDENTITY:
+			result = args[0];
+			wire = isWire(i->operands[0]);
+			break;
+		case Operation::NEGATION: result = negate(args[0]); break;
+		case Operation::ADD:
+			result = args[0];
+			for (size_t j = 1; j < args.size(); j++) {
+				result = add(result, args[j]);
+			}
+			break;
+		case Operation::MULTIPLY:
+			result = args[0];
+			for (size_t j = 1; j < args.size(); j++) {
+				result = multiply(result, args[j]);
+			}
+			break;
+		case Operation::SUBTRACT: result = subtract(args[0], args[1]); break;
+		case Operation::DIVIDE: result = divide(args[0], args[1], false); break;
+		case Operation::MOD: result = divide(args[0], args[1], true); break;
+		case Operation::SHIFT_LEFT: result = shiftLeft(args[0], args[1]); break;
+		case Operation::SHIFT_RIGHT: result = shiftRight(args[0], args[1]); break;
+
+		case Operation::EQUAL: result = boolOf(equal(args[0], args[1])); break;
+		case Operation::NOT_EQUAL: result = boolOf(Aig::complement(equal(args[0], args[1]))); break;
+		case Operation::LESS: result = boolOf(less(args[0], args[1])); break;
+		case Operation::GREATER: result = boolOf(less(args[1], args[0])); break;
+		case Operation::LESS_EQUAL: result = boolOf(Aig::complement(less(args[1], args[0]))); break;
+		case Operation::GREATER_EQUAL: result = boolOf(Aig::complement(less(args[0], args[1]))); break;
+
+		case Operation::BOOLEAN_NOT: result = boolOf(Aig::complement(truth(args[0]))); break;
+		case Operation::BOOLEAN_AND:
+		case Operation::BOOLEAN_OR:
+		case Operation::BOOLEAN_XOR: {
+			Literal bit = truth(args[0]);
+			for (size_t j = 1; j < args.size(); j++) {
+				if (i->func == Operation::BOOLEAN_AND) {
+					bit = aig.andOf(bit, truth(args[j]));
+				} else if (i->func == Operation::BOOLEAN_OR) {
+					bit = aig.orOf(bit, truth(args[j]));
+				} else {
+					bit = aig.xorOf(bit, truth(args[j]));
+				}
+			}
+			result = boolOf(bit);
+		} break;
+
+		case Operation::TRUTHINESS:
+			result = boolOf(truth(args[0]));
+			wire = true;
+			break;
+		case Operation::VALIDITY:
+			result = boolOf(valid[0]);
+			wire = true;
+			break;
+		case Operation::WIRE_NOT:
+			result = boolOf(Aig::complement(valid[0]));
+			wire = true;
+			break;
+		case Operation::WIRE_AND:
+		case Operation::WIRE_OR:
+		case Operation::WIRE_XOR: {
+			Literal bit = valid[0];
+			for (size_t j = 1; j < valid.size(); j++) {
+				if (i->func == Operation::WIRE_AND) {
+					bit = aig.andOf(bit, valid[j]);
+				} else if (i->func == Operation::WIRE_OR) {
+					bit = aig.orOf(bit, valid[j]);
+				} else {
+					bit = aig.xorOf(bit, valid[j]);
+				}
+			}
+			result = boolOf(bit);
+			wire = true;
+		} break;
+
+		case Operation::TERNARY:
+			if (args.size() != 3u or isWire(i->operands[1]) != isWire(i->operands[2])) {
+				printf("error: unable to bit-blast operator %s\n", ::to_string(*i).c_str());
+				return vector<Literal>();
+			}
+			result = trim(mux(truth(args[0]), args[1], args[2]));
+			wire = isWire(i->operands[1]);
+			break;
+		default:
+			printf("error: unable to bit-blast operator %s\n", ::to_string(*i).c_str());
+			return vector<Literal>();
+		}
+
+		exprs[i->exprIndex] = result;
+		wires[i->exprIndex] = wire;
+	}
+
+	return exprs[top.index];
+}
+
+// Build the BDD of a literal. The bits of the variables are interleaved in
+// the variable order, lowest bit first, which keeps adders and comparators
+// linear in the width. Returns false if the BDD grew past its limit.
+static bool bddOf(const BitBlaster &blaster, Aig::Literal root, Bdd &bdd, Bdd::Node &result) {
+	const Aig &aig = blaster.aig;
+	vector<Bdd::Node> nodes(aig.nodes.size(), Bdd::ZERO);
+	size_t order = 0;
+	for (size_t bit = 0; order < aig.inputs.size() and bit < 64; bit++) {
+		for (auto v = blaster.vars.begin(); v != blaster.vars.end(); v++) {
+			if (bit < v->second.size() and v->second[bit] != Aig::ZERO) {
+				nodes[Aig::nodeOf(v->second[bit])] = bdd.variable((uint32_t)order++);
+			}
+		}
+	}
+
+	// only the gates that root depends on
+	vector<bool> cone(aig.nodes.size(), false);
+	cone[Aig::nodeOf(root)] = true;
+	for (size_t i = aig.nodes.size(); i-- > 1; ) {
+		if (cone[i] and aig.isGate((uint32_t)i)) {
+			cone[Aig::nodeOf(aig.nodes[i][0])] = true;
+			cone[Aig::nodeOf(aig.nodes[i][1])] = true;
+		}
+	}
+
+	auto literal = [&](Aig::Literal a) {
+		Bdd::Node n = nodes[Aig::nodeOf(a)];
+		return Aig::isComplemented(a) ? bdd.notOf(n) : n;
+	};
+
+	for (size_t i = 1; i < aig.nodes.size() and not bdd.exceeded; i++) {
+		if (cone[i] and aig.isGate((uint32_t)i)) {
+			nodes[i] = bdd.andOf(literal(aig.nodes[i][0]), literal(aig.nodes[i][1]));
+		}
+	}
+
+	result = literal(root);
+	return not bdd.exceeded;
+}
+
+Equivalence::Result equivalent(ConstOperationSet ops0, Operand top0, ConstOperationSet ops1, Operand top1, vector<Type> vars, size_t limit) {
+	BitBlaster blaster;
+	vector<Aig::Literal> r0 = blaster.blast(ops0, top0, vars);
+	vector<Aig::Literal> r1 = blaster.blast(ops1, top1, vars);
+	if (r0.empty() or r1.empty()) {
+		return Equivalence::UNKNOWN;
+	}
+
+	// true wherever the two differ
+	size_t width = std::max(r0.size(), r1.size());
+	r0 = BitBlaster::extend(r0, width);
+	r1 = BitBlaster::extend(r1, width);
+	Aig::Literal miter = Aig::ZERO;
+	for (size_t i = 0; i < width; i++) {
+		miter = blaster.aig.orOf(miter, blaster.aig.xorOf(r0[i], r1[i]));
+	}
+
+	if (miter == Aig::ZERO) {
+		return Equivalence::EQUAL;
+	} else if (miter == Aig::ONE) {
+		return Equivalence::DIFFERENT;
+	}
+
+	// The first six inputs cycle within each word of patterns, and the rest
+	// count up across words.
+	static const uint64_t cycle[6] = {
+		0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+		0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull,
+	};
+
+	size_t n = blaster.aig.inputs.size();
+	vector<uint64_t> values(n, 0);
+	if (n <= 20u) {
+		uint64_t words = n <= 6u ? 1u : ((uint64_t)1 << (n-6));
+		for (uint64_t w = 0; w < words; w++) {
+			for (size_t i = 0; i < n; i++) {
+				values[i] = i < 6u ? cycle[i] : (((w >> (i-6)) & 1u) ? ~(uint64_t)0 : 0);
+			}
+			if (Aig::valueOf(blaster.aig.simulate(values), miter) != 0) {
+				return Equivalence::DIFFERENT;
+			}
+		}
+		return Equivalence::EQUAL;
+	}
+
+	// Random simulation finds most differences quickly
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	for (int w = 0; w < 1024; w++) {
+		for (size_t i = 0; i < n; i++) {
+			// xorshift64
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			values[i] = state;
+		}
+		if (Aig::valueOf(blaster.aig.simulate(values), miter) != 0) {
+			return Equivalence::DIFFERENT;
+		}
+	}
+
+	// then the miter is decided exactly, if its BDD fits
+	Bdd bdd;
+	bdd.limit = limit;
+	Bdd::Node differ = Bdd::ZERO;
+	if (not bddOf(blaster, miter, bdd, differ)) {
+		return Equivalence::UNKNOWN;
+	}
+	return differ == Bdd::ZERO ? Equivalence::EQUAL : Equivalence::DIFFERENT;
+}
+
+}
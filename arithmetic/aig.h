@@ -0,0 +1,120 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include <unordered_map>
+
+#include "operation_set.h"
+#include "type.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) An And-Inverter Graph. Every node is either an input
+// or a two-input AND gate, and inversion lives on the edges. A literal is
+// node*2, or node*2+1 for its complement. Node 0 is the constant, so literal
+// 0 is false and literal 1 is true. Gates are structurally hashed: a gate is
+// only created if no gate with the same fanins exists, and trivial gates are
+// folded away, so equivalent structure is shared automatically.
+struct Aig {
+	Aig();
+	~Aig();
+
+	typedef uint32_t Literal;
+
+	static const Literal ZERO = 0;
+	static const Literal ONE = 1;
+
+	// The fanins of each node. The constant and the inputs have {0, 0}, which
+	// no gate can have because and(a, a) is folded to a.
+	vector<std::array<Literal, 2> > nodes;
+	// the node of each input in order of creation
+	vector<uint32_t> inputs;
+	// fanins to gate, keyed on the two fanins, smallest first
+	std::unordered_map<uint64_t, Literal> table;
+
+	static Literal complement(Literal a);
+	static uint32_t nodeOf(Literal a);
+	static bool isComplemented(Literal a);
+
+	bool isGate(uint32_t node) const;
+	// number of AND gates
+	size_t gates() const;
+
+	Literal input();
+	Literal andOf(Literal a, Literal b);
+	Literal orOf(Literal a, Literal b);
+	Literal xorOf(Literal a, Literal b);
+	Literal mux(Literal s, Literal t, Literal f);
+
+	// Simulate 64 input patterns at once. Bit k of inputs[i] is the value of
+	// input i in pattern k. Returns the value of every node.
+	vector<uint64_t> simulate(const vector<uint64_t> &values) const;
+	static uint64_t valueOf(const vector<uint64_t> &values, Literal a);
+};
+
+// DESIGN(edward.bingham) Integers are lowered to two's complement bit vectors
+// stored least significant bit first, and the most significant bit is the
+// sign. Each operation grows its result just enough to avoid overflow, up to
+// the 64 bits of Value::ival where it wraps the same way evaluate() does.
+// Variables are unsigned and as wide as digitsOf() their type, at least one
+// bit. Booleans and wires are one-bit values extended with a zero sign bit.
+// Boolean operations treat a wider operand as true when it is nonzero, like
+// boolOf(). Wire operations follow wireOf() instead: a wire is its bit, and
+// any other valid value is vdd, even zero. Division truncates toward zero like C++, and the result of a
+// division by zero is unspecified.
+struct BitBlaster {
+	BitBlaster();
+	~BitBlaster();
+
+	typedef Aig::Literal Literal;
+
+	Aig aig;
+	// the bits of each variable, least significant first
+	map<size_t, vector<Literal> > vars;
+
+	vector<Literal> variable(size_t index, Type type);
+	vector<Literal> constant(int64_t value);
+
+	// Lower top into the network. Returns an empty vector if the expression
+	// uses something that can't be lowered.
+	vector<Literal> blast(ConstOperationSet ops, Operand top, const vector<Type> &types);
+
+	static vector<Literal> extend(vector<Literal> a, size_t width);
+	static vector<Literal> trim(vector<Literal> a);
+
+	Literal truth(const vector<Literal> &a);
+	vector<Literal> boolOf(Literal a);
+
+	vector<Literal> add(vector<Literal> a, vector<Literal> b, Literal carry=Aig::ZERO);
+	vector<Literal> negate(vector<Literal> a);
+	vector<Literal> subtract(vector<Literal> a, vector<Literal> b);
+	vector<Literal> multiply(vector<Literal> a, vector<Literal> b);
+	vector<Literal> divide(vector<Literal> a, vector<Literal> b, bool remainder);
+	vector<Literal> shiftLeft(vector<Literal> a, vector<Literal> b);
+	vector<Literal> shiftRight(vector<Literal> a, vector<Literal> b);
+	vector<Literal> mux(Literal s, vector<Literal> t, vector<Literal> f);
+
+	Literal equal(vector<Literal> a, vector<Literal> b);
+	Literal less(vector<Literal> a, vector<Literal> b);
+};
+
+struct Equivalence {
+	enum Result {
+		// there is an assignment on which the two differ
+		DIFFERENT = 0,
+		// the two agree on every assignment
+		EQUAL = 1,
+		// neither could be shown, either because an operator can't be bit
+		// blasted or because the BDD of the miter grew past its limit
+		UNKNOWN = 2,
+	};
+};
+
+// Check whether two expressions compute the same value for every assignment
+// of their variables. Variable widths come from vars. Inputs up to 20 bits
+// wide in total are simulated exhaustively. Wider inputs are first simulated
+// at random to look for a difference, then decided by building the BDD of
+// the miter with at most limit nodes.
+Equivalence::Result equivalent(ConstOperationSet ops0, Operand top0, ConstOperationSet ops1, Operand top1, vector<Type> vars, size_t limit=1u<<20);
+
+}
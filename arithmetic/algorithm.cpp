@@ -1,9 +1,16 @@
 #include "algorithm.h"
+#include "builtin.h"
+#include "trace.h"
 
 #include <common/text.h>
 #include <common/combinatoric.h>
 #include <common/message.h>
 #include <sstream>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
 
 namespace arithmetic {
 
@@ -93,91 +100,6 @@ bool operator!=(const UpIterator &i0, const UpIterator &i1) {
 	return i0.stack != i1.stack;
 }
 
-ConstUpIterator::ConstUpIterator(ConstOperationSet root, vector<Operand> start) : root(root) {
-	for (auto i = start.begin(); i != start.end(); i++) {
-		if (i->isExpr()) {
-			stack.push_back(i->index);
-			setSeen(i->index);
-		}
-	}
-	stack.push_back(-1);
-	++*this;
-}
-
-ConstUpIterator::~ConstUpIterator() {
-}
-
-void ConstUpIterator::setSeen(size_t index) {
-	if (index >= seen.size()) {
-		seen.resize(index+1, false);
-	}
-	seen[index] = true;
-}
-
-bool ConstUpIterator::getSeen(size_t index) const {
-	return index < seen.size() and seen[index];
-}
-
-const Operation &ConstUpIterator::get() {
-	return *root.getExpr(stack.back());
-}
-
-const Operation &ConstUpIterator::operator*() {
-	return *root.getExpr(stack.back());
-}
-
-const Operation *ConstUpIterator::operator->() {
-	return root.getExpr(stack.back());
-}
-
-ConstUpIterator &ConstUpIterator::operator++() {
-	if (not stack.empty()) {
-		stack.pop_back();
-	}
-
-	while (not stack.empty()) {
-		if (stack.back() >= expand.size()) {
-			expand.resize(stack.back()+1, false);
-		}
-		if (expand[stack.back()]) {
-			return *this;
-		}
-
-		expand[stack.back()] = true;
-		auto curr = root.getExpr(stack.back());
-		if (curr != nullptr) {
-			for (auto i = curr->operands.begin(); i != curr->operands.end(); i++) {
-				if (i->isExpr() and not getSeen(i->index)) {
-					stack.push_back(i->index);
-					setSeen(i->index);
-				} else if (i->isExpr()) {
-					auto pos = find(stack.begin(), stack.end(), i->index);
-					if (pos != stack.end()) {
-						stack.erase(pos);
-						stack.push_back(i->index);
-					}
-				}
-			}
-		} else {
-			internal("", "malformed arithmetic expression", __FILE__, __LINE__);
-		}
-	}
-
-	return *this;
-}
-
-bool ConstUpIterator::done() const {
-	return stack.empty();
-}
-
-bool operator==(const ConstUpIterator &i0, const ConstUpIterator &i1) {
-	return i0.stack == i1.stack;
-}
-
-bool operator!=(const ConstUpIterator &i0, const ConstUpIterator &i1) {
-	return i0.stack != i1.stack;
-}
-
 DownIterator::DownIterator(OperationSet root, vector<Operand> start) : root(root) {
 	for (auto i = start.begin(); i != start.end(); i++) {
 		if (i->isExpr()) {
@@ -414,46 +336,108 @@ bool operator!=(const PostOrderDFSIterator &i0, const PostOrderDFSIterator &i1)
 	return !(i0 == i1);
 }
 
-string to_string(ConstOperationSet ops, Operand top, bool debug) {
-	std::ostringstream result;
-	if (debug) {
-		result << "top: " << top << endl;
-		vector<Operand> idx = ops.exprIndex();
-		for (auto i = idx.rbegin(); i != idx.rend(); i++) {
-			result << *ops.getExpr(i->index) << endl;
+// Write the text between operand j and operand j+1 of an operation with n
+// operands
+static void separator(ostream &os, const Operator &func, size_t j, size_t n) {
+	if (j == 0 and not func.trigger.empty()) {
+		os << func.trigger;
+	} else if (j == n-1) {
+		os << func.postfix;
+	} else {
+		os << func.infix;
+	}
+}
+
+// Write the operation at index. Operations marked in bound are written by
+// name rather than expanded.
+static void printExpr(ostream &os, ConstOperationSet ops, size_t index, const vector<bool> &bound) {
+	// the exprIndex of each open operation and the next operand to write
+	vector<std::array<size_t, 2> > stack;
+	stack.push_back({index, 0});
+	os << "(" << Operation::operators[ops.getExpr(index)->func].prefix;
+	while (not stack.empty()) {
+		size_t curr = stack.back()[0];
+		size_t j = stack.back()[1]++;
+		const Operation *expr = ops.getExpr(curr);
+		const Operator &func = Operation::operators[expr->func];
+		size_t n = expr->operands.size();
+		if (j >= n) {
+			os << ")";
+			stack.pop_back();
+			if (not stack.empty()) {
+				const Operation *parent = ops.getExpr(stack.back()[0]);
+				separator(os, Operation::operators[parent->func], stack.back()[1]-1, parent->operands.size());
+			}
+			continue;
 		}
 
-	} else {
-		index_vector<string> strs;
+		Operand op = expr->operands[j];
+		const Operation *sub = nullptr;
+		if (op.isExpr() and (op.index >= bound.size() or not bound[op.index])) {
+			sub = ops.getExpr(op.index);
+		}
+
+		if (sub != nullptr) {
+			os << "(" << Operation::operators[sub->func].prefix;
+			stack.push_back({op.index, 0});
+		} else {
+			os << op;
+			separator(os, func, j, n);
+		}
+	}
+}
+
+void print(ostream &os, ConstOperationSet ops, Operand top, bool share) {
+	if (not top.isExpr() or ops.getExpr(top.index) == nullptr) {
+		os << top;
+		return;
+	}
+
+	vector<bool> bound;
+	if (share) {
+		// Count the references to each operation from inside the DAG
+		vector<uint32_t> refs;
+		vector<size_t> order;
 		for (ConstUpIterator i(ops, {top}); not i.done(); ++i) {
-			Operator func = Operation::operators[i->func];
-			std::ostringstream oss;
-			oss << "(";
-			oss << func.prefix;
-			for (int j = 0; j < (int)i->operands.size(); j++) {
-				if (i->operands[j].isExpr()) {
-					oss << strs[i->operands[j].index];
-				} else {
-					oss << i->operands[j];
-				}
-				if (j == 0 and not func.trigger.empty()) {
-					oss << func.trigger;
-				} else if (j == (int)i->operands.size()-1) {
-					oss << func.postfix;
-				} else {
-					oss << func.infix;
+			order.push_back(i->exprIndex);
+			for (auto j = i->operands.begin(); j != i->operands.end(); j++) {
+				if (j->isExpr()) {
+					if (j->index >= refs.size()) {
+						refs.resize(j->index+1, 0);
+					}
+					refs[j->index]++;
 				}
 			}
+		}
 
-			oss << ")";
-			strs.emplace_at(i->op().index, oss.str());
+		bool first = true;
+		bound.resize(refs.size(), false);
+		for (auto i = order.begin(); i != order.end(); i++) {
+			if (*i < refs.size() and refs[*i] > 1u and *i != top.index) {
+				os << (first ? "let " : ", ") << Operand::exprOf(*i) << " = ";
+				printExpr(os, ops, *i, bound);
+				bound[*i] = true;
+				first = false;
+			}
+		}
+		if (not first) {
+			os << " in ";
 		}
+	}
 
-		if (top.isExpr()) {
-			result << strs[top.index];
-		} else {
-			result << top;
+	printExpr(os, ops, top.index, bound);
+}
+
+string to_string(ConstOperationSet ops, Operand top, bool debug) {
+	std::ostringstream result;
+	if (debug) {
+		result << "top: " << top << endl;
+		vector<Operand> idx = ops.exprIndex();
+		for (auto i = idx.rbegin(); i != idx.rend(); i++) {
+			result << *ops.getExpr(i->index) << endl;
 		}
+	} else {
+		print(result, ops, top);
 	}
 	return result.str();
 }
@@ -464,25 +448,18 @@ ostream &operator<<(ostream &os, Match m) {
 }
 
 ValRef evaluate(ConstOperationSet ops, Operand top, State values, TypeSet types, Caller caller) {
-	if (not top.isExpr()) {
-		return top.get(values, vector<ValRef>());
-	}
+	TraceScope trace("evaluate");
+	return evaluateOn(ops, top, values, types, caller);
+}
 
-	size_t prev = 0;
-	vector<ValRef> exprs;
-	for (auto i = ConstUpIterator(ops, {top}); not i.done(); ++i) {
-		if (i->exprIndex >= exprs.size()) {
-			exprs.resize(i->exprIndex+1, Value::X());
-		}
-		exprs[i->exprIndex] = i->evaluate(values, exprs, types, caller);
-		prev = i->exprIndex;
-	}
+ValRef evaluate(const Expression &ops, Operand top, const State &values, TypeSet types, Caller caller) {
+	TraceScope trace("evaluate");
+	return evaluateOn(ops, top, values, types, caller);
+}
 
-	if (prev >= exprs.size()) {
-		printf("internal:%s:%d: malformed expression structure\n", __FILE__, __LINE__);
-		return Value::X();
-	}
-	return exprs[prev];
+ValRef evaluate(const SimpleOperationSet &ops, Operand top, const State &values, TypeSet types, Caller caller) {
+	TraceScope trace("evaluate");
+	return evaluateOn(ops, top, values, types, caller);
 }
 
 size_t lvalueBase(ConstOperationSet ops, Operand top, TypeSet types) {
@@ -512,49 +489,23 @@ size_t lvalueBase(ConstOperationSet ops, Operand top, TypeSet types) {
 }
 
 
-Cost cost(ConstOperationSet ops, Operand top, vector<Type> vars) {
-	if (not top.isExpr()) {
-		return Cost();
-	}
-
-	double complexity = 0.0;
-	vector<Type> expr;
+Cost cost(ConstOperationSet ops, Operand top, vector<Type> vars, Cost::Model model) {
+	return costOn(ops, top, vars, model);
+}
 
-	for (auto curr = ConstUpIterator(ops, {top}); not curr.done(); ++curr) {
-		pair<Type, double> result(Type(0.0, 0.0, 0.0), 0.0);
-		vector<Type> args;
-		for (auto j = curr->operands.begin(); j != curr->operands.end(); j++) {
-			if (j->isConst()) {
-				args.push_back(j->cnst.typeOf());
-			} else if (j->isVar() and j->index < vars.size()) {
-				args.push_back(vars[j->index]);
-			} else if (j->isExpr() and j->index < expr.size()) {
-				args.push_back(expr[j->index]);
-			} else {
-				printf("error: variable not defined for expression\n");
-				args.push_back(Type());
-			}
-		}
-		result = curr->funcCost(curr->func, args);
-		if (curr->exprIndex >= expr.size()) {
-			expr.resize(curr->exprIndex+1);
-		}
-		expr[curr->exprIndex] = result.first;
-		complexity += result.second;
-	}
+Cost cost(const Expression &ops, Operand top, const vector<Type> &vars, Cost::Model model) {
+	return costOn(ops, top, vars, model);
+}
 
-	double delay = 0.0;
-	if (top.index < expr.size()) {
-		delay = expr[top.index].delay;
-	}
-	return Cost(complexity, delay);
+Cost cost(const SimpleOperationSet &ops, Operand top, const vector<Type> &vars, Cost::Model model) {
+	return costOn(ops, top, vars, model);
 }
 
 Operand extract(OperationSet expr, size_t from, vector<size_t> operands) {
-	Operation o0 = *expr.getExpr(from);
 	Operand result = expr.pushExpr(Operation());
-	expr.setExpr(o0.extract(operands, result.index));
-	expr.setExpr(o0);
+	// after the push, which may move the operations
+	Operation part = expr.refExpr(from)->extract(operands, result.index);
+	expr.setExpr(part);
 	return result;
 }
 
@@ -576,6 +527,8 @@ Expression subExpr(ConstOperationSet e0, Operand top) {
 // 5. merge successive commutative operations
 // 6. sort operands into a canonical order for commutative operations
 Mapping<Operand> tidy(OperationSet expr, vector<Operand> top, bool rules) {
+	TraceScope trace("tidy");
+
 	// Start from the top and do depth first search. That zips up the graph for
 	// us. First, we need a mapping of index in operations to exprIndex so we
 	// don't have to search for the exprIndex each time.
@@ -738,53 +691,106 @@ Mapping<Operand> tidy(OperationSet expr, vector<Operand> top, bool rules) {
 // TODO(edward.bingham) I need a way to canonicalize expressions and hash
 // them so that I can do the state search algorithm.
 //
-// TODO(edward.bingham) rules aren't currently able to match with a variable
-// number of operands. I need to create a comprehension functionality to
-// support those more complex matches.
-//
 // TODO(edward.bingham) look into "tree automata" and "regular tree grammar"
 // as a form of regex for trees instead of sequences.
 
+// DESIGN(edward.bingham) The matcher is a backtracking depth-first search.
+// Instead of copying the partial match at every branch, variable bindings and
+// pending leaves are pushed onto stacks as the search descends and popped off
+// again as it backtracks. The stacks keep their capacity across seeds, so
+// the search itself doesn't allocate once it has warmed up.
 struct Matcher {
-	Matcher(ConstOperationSet source, const RuleSet &rules) : source(source), rules(rules) {}
+	Matcher(ConstOperationSet source, const RuleSet &rules, const vector<Operand> &pin, const Labeling &labels, RewriteStats *stats=nullptr) : source(source), rules(rules), pin(pin), labels(labels), stats(stats) {}
 	~Matcher() {}
 
 	ConstOperationSet source;
 	const RuleSet &rules;
-	Match match;
+	// these expressions cannot be contained in a match except at the very top
+	const vector<Operand> &pin;
+	// the rules that may match at each expression
+	const Labeling &labels;
+	// only recorded when built with ARITHMETIC_STATS
+	RewriteStats *stats;
+
+	// flat binding array indexed by rule variable number. Each entry is the
+	// range in operands bound to that variable, or unbound if the range is
+	// empty.
+	vector<std::array<size_t, 2> > bound;
+	vector<Operand> operands;
+	// the variables in the order they were bound
+	vector<size_t> trail;
+
+	// rule leaves that still need to be matched
 	vector<Rule> leaves;
+	// leaves that have already been consumed by the current branch
+	vector<Rule> consumed;
+	// the valid operand assignments at each depth of the search
+	vector<vector<size_t> > options;
+	// for commutative operations, the source operands already assigned and
+	// which source operands fit each pattern operand
+	vector<vector<bool> > taken;
+	vector<vector<bool> > fits;
+	// scratch space for the bipartite matching
+	vector<size_t> owner;
+	vector<bool> visited;
+
+	// the expression, replacement, and matched operands for the current branch
+	Match match;
 
-	bool map(vector<Operand> from, Operand to, bool top=false) {
+	size_t mark() const {
+		return trail.size();
+	}
+
+	void undo(size_t to) {
+		while (trail.size() > to) {
+			size_t v = trail.back();
+			trail.pop_back();
+			operands.resize(bound[v][0]);
+			bound[v] = {0, 0};
+		}
+	}
+
+	bool map(const Operand *from, size_t n, Operand to, bool top=false) {
 		if (to.isConst()) {
-			for (auto i = from.begin(); i != from.end(); i++) {
+			for (const Operand *i = from; i != from+n; i++) {
 				if (not i->isConst() or (not areSame(i->cnst, to.cnst) and not (i->cnst.isValid() and to.cnst.isUnknown()))) {
 					return false;
 				}
 			}
 			return true;
 		} else if (to.isVar()) {
-			auto ins = match.vars.insert({to.index, from});
-			if (ins.second) {
+			if (to.index >= bound.size()) {
+				bound.resize(to.index+1, {0, 0});
+			}
+			std::array<size_t, 2> &b = bound[to.index];
+			if (b[0] == b[1]) {
+				b = {operands.size(), operands.size()+n};
+				operands.insert(operands.end(), from, from+n);
+				trail.push_back(to.index);
 				return true;
-			} else if (from.size() != ins.first->second.size()) {
+			} else if (n != b[1]-b[0]) {
 				return false;
 			}
-			for (int i = 0; i < (int)from.size(); i++) {
-				if (from[i] != ins.first->second[i]) {
+			for (size_t i = 0; i < n; i++) {
+				if (from[i] != operands[b[0]+i]) {
 					return false;
 				}
 			}
 			return true;
 		} else if (to.isExpr()) {
-			for (auto i = from.begin(); i != from.end(); i++) {
+			auto toExpr = rules.sub.getExpr(to.index);
+			for (const Operand *i = from; i != from+n; i++) {
 				if (not i->isExpr()) {
 					return false;
 				}
+				// Only the top of a match may have operands left over, because
+				// the replacement keeps them. Below the top, a commutative pattern
+				// may only match a wider operation if its one operand, a variable
+				// or a comprehension, absorbs all of them.
 				auto fromExpr = source.getExpr(i->index);
-				auto toExpr = rules.sub.getExpr(to.index);
 				if (not (fromExpr->func == toExpr->func
 					and (fromExpr->operands.size() == toExpr->operands.size()
-						or ((toExpr->isCommutative() or top)
+						or ((top or (toExpr->isCommutative() and toExpr->operands.size() == 1u))
 							and fromExpr->operands.size() > toExpr->operands.size())))) {
 					return false;
 				}
@@ -793,163 +799,638 @@ struct Matcher {
 		}
 		return false;
 	}
-};
 
-// pin - these expression IDs cannot be contained in a match except at the very
-// top of the match. These must be preserved through a replace.
-vector<Match> search(ConstOperationSet ops, vector<Operand> pin, const RuleSet &rules, size_t count, bool fwd, bool bwd) {
-	vector<Matcher> stack;
-
-	// initialize the initial matches
-	vector<Operand> indices = ops.exprIndex();
-	for (auto i = indices.begin(); i != indices.end(); i++) {
-		// search through the rules and add all of the matching starts
-		for (auto j = rules.rules.begin(); j != rules.rules.end(); j++) {
-			// map left to right
-			{
-				Matcher next(ops, rules);
-				if (next.map({*i}, j->left, true)) {
-					next.match.expr = i->index;
-					next.match.replace = j->right;
-					next.leaves.push_back(Rule(*i, j->left));
-					stack.push_back(next);
+	void emit(vector<Match> &result) {
+		Match m;
+		m.replace = match.replace;
+		m.expr = match.expr;
+		m.top = match.top;
+		for (size_t v = 0; v < bound.size(); v++) {
+			if (bound[v][0] != bound[v][1]) {
+				m.vars.insert({v, vector<Operand>(operands.begin()+bound[v][0], operands.begin()+bound[v][1])});
+			}
+		}
+		result.push_back(m);
+	}
+
+	// Match the remaining leaves. Returns true when the search should stop
+	// because count matches were found.
+	bool explore(size_t depth, vector<Match> &result, size_t count) {
+		REWRITE_STATS(if (stats) {
+			stats->peakDepth = std::max(stats->peakDepth, depth);
+			stats->peakLeaves = std::max(stats->peakLeaves, leaves.size());
+		})
+
+		// Leaves on variables and constants were fully checked by map()
+		size_t base = consumed.size();
+		while (not leaves.empty() and not leaves.back().right.isExpr()) {
+			consumed.push_back(leaves.back());
+			leaves.pop_back();
+		}
+
+		bool stop = false;
+		if (leaves.empty()) {
+			emit(result);
+			stop = (count != 0 and result.size() >= count);
+		} else {
+			Rule rule = leaves.back();
+			leaves.pop_back();
+			stop = expand(rule, depth, result, count);
+			leaves.push_back(rule);
+		}
+
+		while (consumed.size() > base) {
+			leaves.push_back(consumed.back());
+			consumed.pop_back();
+		}
+		return stop;
+	}
+
+	bool expand(Rule rule, size_t depth, vector<Match> &result, size_t count) {
+		auto fOp = source.getExpr(rule.left.index);
+		auto tOp = rules.sub.getExpr(rule.right.index);
+
+		for (auto i = fOp->operands.begin(); i != fOp->operands.end(); i++) {
+			if (i->isExpr() and find(pin.begin(), pin.end(), *i) != pin.end()) {
+				return false;
+			}
+		}
+
+		size_t m = mark();
+		size_t l = leaves.size();
+		size_t t = match.top.size();
+		bool stop = false;
+
+		bool commute = tOp->isCommutative();
+		if (commute and tOp->operands.size() == 1u and tOp->operands[0].isExpr()
+			and rules.sub.getExpr(tOp->operands[0].index)->func == Operation::EACH) {
+			return comprehend(rule, depth, result, count);
+		} else if (commute and tOp->operands.size() == 1u) {
+			//cout << "Elastic Commutative" << endl;
+			if (map(fOp->operands.data(), fOp->operands.size(), tOp->operands[0])) {
+				for (size_t i = 0; i < fOp->operands.size(); i++) {
+					leaves.push_back(Rule(fOp->operands[i], tOp->operands[0]));
+					if (match.top.empty()) {
+						match.top.push_back(i);
+					}
+				}
+				stop = explore(depth+1, result, count);
+			}
+			leaves.resize(l);
+			match.top.resize(t);
+			undo(m);
+			return stop;
+		}
+
+		if (depth >= options.size()) {
+			options.resize(depth+1);
+			taken.resize(depth+1);
+			fits.resize(depth+1);
+		}
+
+		size_t k = tOp->operands.size();
+		if (commute) {
+			return permute(rule, depth, result, count);
+		}
+
+		// Find every valid window of operands first. They are then explored in
+		// reverse order, which is the order the original stack-based search
+		// visited them in.
+		options[depth].clear();
+		size_t found = 0;
+		for (CombinatoricIterator it(fOp->operands.size(), k);
+			not it.done(); it.nextShift()) {
+			bool valid = true;
+			for (size_t i = 0; i < k and valid; i++) {
+				valid = map(&fOp->operands[it[i]], 1, tOp->operands[i]);
+			}
+			undo(m);
+			if (valid) {
+				for (size_t i = 0; i < k; i++) {
+					options[depth].push_back(it[i]);
 				}
+				found++;
 			}
+		}
 
-			// map right to left
-			if (not j->directed) {
-				Matcher next(ops, rules);
-				if (next.map({*i}, j->right, true)) {
-					next.match.expr = i->index;
-					next.match.replace = j->left;
-					next.leaves.push_back(Rule(*i, j->right));
-					stack.push_back(next);
+		bool top = match.top.empty();
+		for (size_t j = found; j > 0 and not stop; j--) {
+			for (size_t i = 0; i < k; i++) {
+				size_t idx = options[depth][(j-1)*k+i];
+				leaves.push_back(Rule(fOp->operands[idx], tOp->operands[i]));
+				if (top) {
+					match.top.push_back(idx);
 				}
+				map(&fOp->operands[idx], 1, tOp->operands[i]);
 			}
+
+			stop = explore(depth+1, result, count);
+
+			leaves.resize(l);
+			match.top.resize(t);
+			undo(m);
 		}
+		return stop;
 	}
 
-	//cout << "Search:" << endl;
-	//for (int i = 0; i < (int)stack.size(); i++) {
-	//	cout << "Stack " << i << ": " << ::to_string(stack[i].first) << " " << stack[i].second << endl;
-	//}
-	// Find expression matches with depth-first search
-	vector<Match> result;
-	while (not stack.empty()) {
-		Matcher curr = stack.back();
-		stack.pop_back();
+	// Match each(v, f(v)) against the operands of a commutative operation.
+	// Every operand is first matched against f(v) on its own to find all the
+	// ways it could match. The other variables in f(v) must agree across the
+	// selected operands, so each of those ways is tried as an anchor and the
+	// remaining operands are chosen greedily to agree with it. The anchor that
+	// selects the most operands wins and v is bound to the list of their
+	// elements. Like the elastic patterns, at least two operands must be
+	// selected.
+	bool comprehend(Rule rule, size_t depth, vector<Match> &result, size_t count) {
+		auto fOp = source.getExpr(rule.left.index);
+		auto tOp = rules.sub.getExpr(rule.right.index);
+		auto each = rules.sub.getExpr(tOp->operands[0].index);
+		if (each->operands.size() != 2u or not each->operands[0].isVar()) {
+			printf("internal:%s:%d: comprehension expects a variable and an expression\n", __FILE__, __LINE__);
+			return false;
+		}
+		size_t elem = each->operands[0].index;
+		size_t n = fOp->operands.size();
+
+		vector<vector<Match> > ways(n);
+		for (size_t j = 0; j < n; j++) {
+			Matcher inner(source, rules, pin, labels, stats);
+			inner.bound = bound;
+			inner.operands = operands;
+			if (elem < inner.bound.size()) {
+				inner.bound[elem] = {0, 0};
+			}
+			// keep the inner match from recording its own top
+			inner.match.top.push_back(0);
+			if (inner.map(&fOp->operands[j], 1, each->operands[1])) {
+				inner.leaves.push_back(Rule(fOp->operands[j], each->operands[1]));
+				inner.explore(depth+1, ways[j], 0);
+			}
+		}
 
-		Rule rule = curr.leaves.back();
-		curr.leaves.pop_back();
+		size_t m = mark();
+		vector<const Match*> best;
+		size_t found = 0;
+		vector<const Match*> pick;
+		for (size_t a = 0; a < n; a++) {
+			for (auto w = ways[a].begin(); w != ways[a].end(); w++) {
+				pick.assign(n, nullptr);
+				size_t total = 0;
+				if (agree(*w, elem)) {
+					pick[a] = &(*w);
+					total++;
+					for (size_t j = 0; j < n; j++) {
+						for (auto u = ways[j].begin(); j != a and u != ways[j].end(); u++) {
+							size_t e = mark();
+							if (agree(*u, elem)) {
+								pick[j] = &(*u);
+								total++;
+								break;
+							}
+							undo(e);
+						}
+					}
+				}
+				undo(m);
 
-		//cout << "Curr: " << curr << " from=" << from << " to=" << to << endl;
-		//cout << "Leaves: " << ::to_string(leaves) << endl;
+				if (total > found) {
+					best = pick;
+					found = total;
+				}
+			}
+		}
 
-		if (rule.right.isExpr()) {
-			auto fOp = ops.getExpr(rule.left.index);
-			auto tOp = rules.sub.getExpr(rule.right.index);
+		if (found < 2u) {
+			return false;
+		}
 
-			bool foundPin = false;
-			for (auto i = fOp->operands.begin(); i != fOp->operands.end(); i++) {
-				if (i->isExpr() and find(pin.begin(), pin.end(), *i) != pin.end()) {
-					foundPin = true;
-					break;
+		vector<Operand> elems;
+		vector<size_t> selected;
+		for (size_t j = 0; j < n; j++) {
+			if (best[j] != nullptr) {
+				agree(*best[j], elem);
+				auto v = best[j]->vars.find(elem);
+				if (v != best[j]->vars.end()) {
+					elems.insert(elems.end(), v->second.begin(), v->second.end());
 				}
+				selected.push_back(j);
+			}
+		}
+
+		bool stop = false;
+		size_t t = match.top.size();
+		if (map(elems.data(), elems.size(), Operand::varOf(elem))) {
+			if (match.top.empty()) {
+				match.top = selected;
 			}
-			if (foundPin) {
+			stop = explore(depth+1, result, count);
+			match.top.resize(t);
+		}
+		undo(m);
+		return stop;
+	}
+
+	// Bind the variables from the match of one element of a comprehension,
+	// other than the element variable itself.
+	bool agree(const Match &with, size_t elem) {
+		for (auto v = with.vars.begin(); v != with.vars.end(); v++) {
+			if (v->first != elem and not map(v->second.data(), v->second.size(), Operand::varOf(v->first))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// DESIGN(edward.bingham) Commutative operations are matched as multisets.
+	// Each pattern operand is assigned a distinct source operand, one at a
+	// time, and the bindings are checked as they are made so a bad prefix is
+	// never extended. Before descending, a bipartite matching between the
+	// remaining pattern operands and the unused source operands confirms that
+	// a complete assignment still exists. Source operands that are identical
+	// are interchangeable, so only one of them is tried at each position.
+	// Together this keeps the search polynomial in the number of operands for
+	// each match found, instead of enumerating every partial permutation of a
+	// wide node that tidy() has flattened.
+	bool permute(Rule rule, size_t depth, vector<Match> &result, size_t count) {
+		auto fOp = source.getExpr(rule.left.index);
+		auto tOp = rules.sub.getExpr(rule.right.index);
+		size_t n = fOp->operands.size();
+		size_t k = tOp->operands.size();
+		if (k > n) {
+			return false;
+		}
+
+		// Which source operands could ever fill each pattern operand, ignoring
+		// variable bindings.
+		fits[depth].assign(k*n, false);
+		for (size_t i = 0; i < k; i++) {
+			for (size_t j = 0; j < n; j++) {
+				fits[depth][i*n+j] = (tOp->operands[i].isVar() or map(&fOp->operands[j], 1, tOp->operands[i]));
+			}
+		}
+		taken[depth].assign(n, false);
+		options[depth].assign(k, 0);
+		if (not feasible(depth, 0, n, k)) {
+			return false;
+		}
+		return assign(rule, depth, 0, result, count);
+	}
+
+	// Assign a source operand to pattern operand i and everything after it.
+	// Source operands are tried from last to first, which is the order the
+	// original search visited them in.
+	bool assign(Rule rule, size_t depth, size_t i, vector<Match> &result, size_t count) {
+		auto fOp = source.getExpr(rule.left.index);
+		auto tOp = rules.sub.getExpr(rule.right.index);
+		size_t n = fOp->operands.size();
+		size_t k = tOp->operands.size();
+
+		if (i == k) {
+			size_t l = leaves.size();
+			size_t t = match.top.size();
+			bool top = (t == 0);
+			for (size_t p = 0; p < k; p++) {
+				size_t idx = options[depth][p];
+				leaves.push_back(Rule(fOp->operands[idx], tOp->operands[p]));
+				if (top) {
+					match.top.push_back(idx);
+				}
+			}
+			sort(match.top.begin()+t, match.top.end());
+
+			bool stop = explore(depth+1, result, count);
+
+			leaves.resize(l);
+			match.top.resize(t);
+			return stop;
+		}
+
+		for (size_t j = n; j > 0; j--) {
+			size_t s = j-1;
+			if (taken[depth][s] or not fits[depth][i*n+s]) {
 				continue;
 			}
 
-			bool commute = tOp->isCommutative();
-			if (commute and tOp->operands.size() == 1u) {
-				//cout << "Elastic Commutative" << endl;
-				Matcher next = curr;
-				if (next.map(fOp->operands, tOp->operands[0])) {
-					for (size_t i = 0; i < fOp->operands.size(); i++) {
-						next.leaves.push_back(Rule(fOp->operands[i], tOp->operands[0]));
-						if (next.match.top.empty()) {
-							next.match.top.push_back(i);
-						}
-					}
-					stack.push_back(next);
+			// An identical operand was already tried in this position
+			bool repeat = false;
+			for (size_t o = s+1; o < n and not repeat; o++) {
+				repeat = (not taken[depth][o] and fOp->operands[o] == fOp->operands[s]);
+			}
+			if (repeat) {
+				continue;
+			}
+
+			size_t m = mark();
+			bool stop = false;
+			if (map(&fOp->operands[s], 1, tOp->operands[i])) {
+				taken[depth][s] = true;
+				options[depth][i] = s;
+				if (feasible(depth, i+1, n, k)) {
+					stop = assign(rule, depth, i+1, result, count);
 				}
-			} else {
-				//cout << "Looking for Partial Permutations" << endl;
-				for (CombinatoricIterator it(fOp->operands.size(), tOp->operands.size());
-					not it.done(); (commute ? it.nextPerm() : it.nextShift())) {
-					Matcher next = curr;
-					bool found = true;
-					bool top = next.match.top.empty();
-					//cout << "Looking at [";
-					for (size_t i = 0; i < it.size() and found; i++) {
-						//cout << *i << "(" << fOp->operands[it[i]] << "==" << tOp->operands[i] << ") ";
-						next.leaves.push_back(Rule(fOp->operands[it[i]], tOp->operands[i]));
-						if (top) {
-							next.match.top.push_back(it[i]);
-						}
-						found = next.map({fOp->operands[it[i]]}, tOp->operands[i]);
-					}
-					//cout << "]" << endl;
+				taken[depth][s] = false;
+			}
+			undo(m);
+			if (stop) {
+				return true;
+			}
+		}
+		return false;
+	}
 
-					if (found) {
-						sort(next.match.top.begin(), next.match.top.end());
-						stack.push_back(next);
-					}
+	// Check that pattern operands from..k can each be given a distinct source
+	// operand that isn't taken yet, using augmenting paths.
+	bool feasible(size_t depth, size_t from, size_t n, size_t k) {
+		owner.assign(n, k);
+		for (size_t i = from; i < k; i++) {
+			visited.assign(n, false);
+			if (not augment(depth, i, n, k)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool augment(size_t depth, size_t i, size_t n, size_t k) {
+		for (size_t j = 0; j < n; j++) {
+			if (not taken[depth][j] and fits[depth][i*n+j] and not visited[j]) {
+				visited[j] = true;
+				if (owner[j] == k or augment(depth, owner[j], n, k)) {
+					owner[j] = i;
+					return true;
 				}
 			}
-		} else if (curr.leaves.empty()) {
-			//cout << "Found " << curr << endl;
-			result.push_back(curr.match);
-			if (count != 0 and result.size() >= count) {
-				return result;
+		}
+		return false;
+	}
+
+	// Find matches rooted at seed, appending them to result. Returns true when
+	// the search should stop because count matches were found.
+	bool searchAt(Operand seed, vector<Match> &result, size_t count) {
+		// Check each rule the automaton accepted at the seed in each allowed
+		// direction. As with every other branch, these are explored in reverse
+		// order.
+		if (options.empty()) {
+			options.resize(1);
+		}
+		options[0].clear();
+		REWRITE_STATS(if (stats) stats->seeds++;)
+		const vector<size_t> &accepted = labels.at(seed.index);
+		for (auto j = accepted.begin(); j != accepted.end(); j++) {
+			const Rule &rule = rules.rules[*j/2];
+			size_t m = mark();
+			if (map(&seed, 1, (*j%2 == 0 ? rule.left : rule.right), true)) {
+				options[0].push_back(*j);
+				REWRITE_STATS(if (stats) stats->rule(*j/2).attempts++;)
 			}
-		} else {
-			stack.push_back(curr);
+			undo(m);
+		}
+
+		vector<size_t> starts;
+		starts.swap(options[0]);
+		bool stop = false;
+		for (auto i = starts.rbegin(); i != starts.rend() and not stop; i++) {
+			const Rule &rule = rules.rules[*i/2];
+			Operand from = (*i%2 == 0 ? rule.left : rule.right);
+			Operand to = (*i%2 == 0 ? rule.right : rule.left);
+
+			size_t m = mark();
+			map(&seed, 1, from, true);
+			match.expr = seed.index;
+			match.replace = to;
+			match.top.clear();
+			leaves.push_back(Rule(seed, from));
+
+			REWRITE_STATS(
+				size_t found = result.size();
+				auto start = std::chrono::steady_clock::now();
+			)
+			stop = explore(1, result, count);
+			REWRITE_STATS(if (stats) {
+				RuleStats &r = stats->rule(*i/2);
+				r.matches += result.size()-found;
+				r.seconds += secondsSince(start);
+			})
+
+			leaves.clear();
+			undo(m);
+		}
+		starts.swap(options[0]);
+		return stop;
+	}
+};
+
+CancelToken::CancelToken(const CancelToken *parent) : flag(false), parent(parent) {
+	hasDeadline = false;
+}
+
+CancelToken::~CancelToken() {
+}
+
+void CancelToken::cancel() {
+	flag.store(true, std::memory_order_relaxed);
+}
+
+void CancelToken::expireAfter(double seconds) {
+	hasDeadline = seconds > 0.0;
+	if (hasDeadline) {
+		deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+	}
+}
+
+bool CancelToken::isCancelled() const {
+	return flag.load(std::memory_order_relaxed)
+		or (hasDeadline and std::chrono::steady_clock::now() >= deadline)
+		or (parent != nullptr and parent->isCancelled());
+}
+
+bool CancelToken::isExpired() const {
+	return (hasDeadline and std::chrono::steady_clock::now() >= deadline)
+		or (parent != nullptr and parent->isExpired());
+}
+
+// pin - these expression IDs cannot be contained in a match except at the very
+// top of the match. These must be preserved through a replace.
+vector<Match> searchAt(ConstOperationSet ops, Operand seed, const vector<Operand> &pin, const RuleSet &rules, size_t count, RewriteStats *stats) {
+	return searchAt(ops, seed, pin, rules, label(rules, ops, {seed}), count, stats);
+}
+
+vector<Match> searchAt(ConstOperationSet ops, Operand seed, const vector<Operand> &pin, const RuleSet &rules, const Labeling &labels, size_t count, RewriteStats *stats) {
+	REWRITE_STATS(if (stats) stats->searches++;)
+	vector<Match> result;
+	Matcher(ops, rules, pin, labels, stats).searchAt(seed, result, count);
+	return result;
+}
+
+SearchOptions::SearchOptions() {
+	count = 0;
+	threads = 1;
+	cancel = nullptr;
+	stats = nullptr;
+}
+
+SearchOptions::~SearchOptions() {
+}
+
+vector<Match> search(ConstOperationSet ops, vector<Operand> pin, const RuleSet &rules, size_t count, bool fwd, bool bwd) {
+	SearchOptions options;
+	options.count = count;
+	return search(ops, pin, rules, options);
+}
+
+vector<Match> search(ConstOperationSet ops, vector<Operand> pin, const RuleSet &rules, const SearchOptions &options) {
+	TraceScope trace("search");
+	size_t count = options.count;
+	size_t threads = options.threads;
+	const CancelToken *cancel = options.cancel;
+	RewriteStats *stats = options.stats;
+	REWRITE_STATS(if (stats) stats->searches++;)
+
+	// Matches are reported starting from the last expression in the index.
+	vector<Operand> seeds = ops.exprIndex();
+	std::reverse(seeds.begin(), seeds.end());
+
+	// Label every expression with the rules that may match there in a single
+	// pass, and only search from the seeds where some rule may match.
+	Labeling labels = label(rules, ops, seeds);
+	seeds.erase(std::remove_if(seeds.begin(), seeds.end(), [&](Operand seed) {
+		return labels.at(seed.index).empty();
+	}), seeds.end());
+
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::min(threads, seeds.size());
+
+	vector<Match> result;
+	if (threads <= 1u) {
+		Matcher matcher(ops, rules, pin, labels, stats);
+		for (auto i = seeds.begin(); i != seeds.end(); i++) {
+			if ((cancel != nullptr and cancel->isCancelled())
+				or matcher.searchAt(*i, result, count)) {
+				break;
+			}
+		}
+		return result;
+	}
+
+	// DESIGN(edward.bingham) Seeds are handed out in order, and every seed that
+	// is started is searched to completion. So once enough matches have been
+	// found, the seeds that have been searched are always a prefix of the
+	// sequential order, and merging them in order gives exactly the sequential
+	// result regardless of scheduling.
+	vector<vector<Match> > found(seeds.size());
+	std::atomic<size_t> next(0);
+	std::atomic<size_t> total(0);
+	// each worker keeps its own statistics, merged once they are done
+	vector<RewriteStats> local(stats != nullptr ? threads : 0);
+	vector<std::thread> pool;
+	for (size_t t = 0; t < threads; t++) {
+		pool.push_back(std::thread([&, t]() {
+			TraceScope trace("search/worker");
+			Matcher matcher(ops, rules, pin, labels, local.empty() ? nullptr : &local[t]);
+			while ((count == 0 or total.load() < count)
+				and (cancel == nullptr or not cancel->isCancelled())) {
+				// check before claiming, a claimed seed must always be searched
+				size_t i = next++;
+				if (i >= seeds.size()) {
+					break;
+				}
+				matcher.searchAt(seeds[i], found[i], count);
+				total += found[i].size();
+			}
+		}));
+	}
+	for (auto t = pool.begin(); t != pool.end(); t++) {
+		t->join();
+	}
+	for (auto s = local.begin(); s != local.end(); s++) {
+		*stats += *s;
+	}
+
+	for (auto i = found.begin(); i != found.end(); i++) {
+		result.insert(result.end(), i->begin(), i->end());
+		if (count != 0 and result.size() >= count) {
+			result.resize(count);
+			break;
 		}
-		//cout << endl;
 	}
-	//cout << "Done" << endl;
 	return result;
 }
 
+vector<Operand> instantiate(OperationSet expr, const RuleSet &rules, Operand tmpl, const map<size_t, vector<Operand> > &vars) {
+	if (tmpl.isVar()) {
+		auto v = vars.find(tmpl.index);
+		if (v == vars.end()) {
+			printf("variable not mapped\n");
+			return vector<Operand>();
+		}
+		return v->second;
+	} else if (not tmpl.isExpr()) {
+		return vector<Operand>(1, tmpl);
+	}
+
+	const Operation *curr = rules.sub.getExpr(tmpl.index);
+	if (curr->func == Operation::EACH) {
+		vector<Operand> result;
+		if (curr->operands.size() != 2u or not curr->operands[0].isVar()) {
+			printf("internal:%s:%d: comprehension expects a variable and an expression\n", __FILE__, __LINE__);
+			return result;
+		}
+
+		auto v = vars.find(curr->operands[0].index);
+		if (v == vars.end()) {
+			printf("variable not mapped\n");
+			return result;
+		}
+
+		map<size_t, vector<Operand> > elem = vars;
+		for (auto i = v->second.begin(); i != v->second.end(); i++) {
+			elem[v->first] = vector<Operand>(1, *i);
+			vector<Operand> sub = instantiate(expr, rules, curr->operands[1], elem);
+			result.insert(result.end(), sub.begin(), sub.end());
+		}
+		return result;
+	}
+
+	vector<Operand> args;
+	for (auto i = curr->operands.begin(); i != curr->operands.end(); i++) {
+		vector<Operand> sub = instantiate(expr, rules, *i, vars);
+		args.insert(args.end(), sub.begin(), sub.end());
+	}
+	return vector<Operand>(1, expr.pushExpr(Operation(curr->func, args)));
+}
+
 void replace(OperationSet expr, const RuleSet &rules, Match match) {
+	TraceScope trace("replace");
 	if (not match.replace.isExpr()) {
-		auto slotPtr = expr.getExpr(match.expr);
-		if (slotPtr == nullptr) {
+		Operation *slot = expr.refExpr(match.expr);
+		if (slot == nullptr) {
 			printf("internal:%s:%d: expression %lu not found\n", __FILE__, __LINE__, match.expr);
 			return;
 		}
-		Operation slot = *slotPtr;
-
-		if (match.top.empty() or match.top.size() == slot.operands.size()) {
-			slot.operands.clear();
-			slot.func = Operation::OpType::IDENTITY;
-			match.top.push_back(0);
-		} else {
-			// If this match doesn't cover all operands, we only want to replace
-			// the ones that are covered.
-			for (int i = (int)match.top.size()-1; i >= 0; i--) {
-				slot.operands.erase(slot.operands.begin() + match.top[i]);
-			}
-			match.top.erase(match.top.begin()+1, match.top.end());
-		}
 
+		const Operand *first = &match.replace;
+		const Operand *last = first+1;
 		if (match.replace.isVar()) {
 			auto v = match.vars.find(match.replace.index);
 			if (v != match.vars.end()) {
-				slot.operands.insert(
-					slot.operands.begin()+match.top[0],
-					v->second.begin(), v->second.end());
+				first = v->second.data();
+				last = first+v->second.size();
 			} else {
 				printf("variable not mapped\n");
+				last = first;
 			}
-		} else {
-			slot.operands.insert(
-				slot.operands.begin()+match.top[0],
-				match.replace);
 		}
 
-		expr.setExpr(slot);
+		if (match.top.empty() or match.top.size() == slot->operands.size()) {
+			slot->func = Operation::OpType::IDENTITY;
+			slot->operands.assign(first, last);
+		} else {
+			// If this match doesn't cover all operands, we only want to replace
+			// the ones that are covered.
+			slot->splice(match.top, first, last);
+		}
 	} else {
 		//cout << "top=e" << match.expr << endl;
 		if (match.replace.isExpr()
@@ -970,7 +1451,16 @@ void replace(OperationSet expr, const RuleSet &rules, Match match) {
 
 		// Iterate over the replacement expression
 		map<size_t, size_t> exprMap;
+		// expressions only used inside of a comprehension, these are copied by
+		// instantiate() instead
+		set<size_t> inside;
+		// the new operands for the current operation
+		vector<Operand> operands;
 		for (auto curr = ConstDownIterator(rules.sub, {match.replace}); not curr.done(); ++curr) {
+			if (inside.count(curr->exprIndex) > 0 and exprMap.find(curr->exprIndex) == exprMap.end()) {
+				continue;
+			}
+
 			// Along the way, compute the exprIndex mapping
 			auto pos = exprMap.insert({curr->exprIndex, 0});
 			if (pos.second) {
@@ -980,55 +1470,51 @@ void replace(OperationSet expr, const RuleSet &rules, Match match) {
 					pos.first->second = match.expr;
 				}
 			}
-			auto slotPtr = expr.getExpr(pos.first->second);
-			if (slotPtr == nullptr) {
-				printf("internal:%s:%d: expression %lu not found\n", __FILE__, __LINE__, pos.first->second);
-				return;
-			}
-			Operation slot = *slotPtr;
-
-			slot.func = curr->func;
-			size_t ins = 0;
-			if (match.top.empty()) {
-				slot.operands.clear();
-			} else {
-				for (int i = (int)match.top.size()-1; i >= 0; i--) {
-					slot.operands.erase(slot.operands.begin() + match.top[i]);
-				}
-				ins = match.top[0];
-			}
+			size_t index = pos.first->second;
 
+			// Collect the new operands before touching the operation. Both
+			// instantiate() and pushExpr() may move the operations around.
+			operands.clear();
 			for (auto op = curr->operands.begin(); op != curr->operands.end(); op++) {
-				if (op->isExpr()) {
+				if (op->isExpr() and rules.sub.getExpr(op->index)->func == Operation::EACH) {
+					vector<Operand> elems = instantiate(expr, rules, *op, match.vars);
+					operands.insert(operands.end(), elems.begin(), elems.end());
+					for (ConstDownIterator i(rules.sub, {*op}); not i.done(); ++i) {
+						inside.insert(i->exprIndex);
+					}
+				} else if (op->isExpr()) {
 					pos = exprMap.insert({op->index, 0});
 					if (pos.second) {
 						pos.first->second = expr.pushExpr(Operation()).index;
 					}
-					
-					slot.operands.insert(
-						slot.operands.begin()+ins,
-						Operand::exprOf(pos.first->second));
-					++ins;
+					operands.push_back(Operand::exprOf(pos.first->second));
 				} else if (op->isVar()) {
 					auto v = match.vars.find(op->index);
 					if (v != match.vars.end()) {
-						// TODO(edward.bingham) copy the expression for every combination of variables?
-						slot.operands.insert(
-							slot.operands.begin()+ins,
-							v->second.begin(), v->second.end());
-						ins += v->second.size();
+						// A list is spliced in as is, use each() to copy an expression for
+						// every element instead.
+						operands.insert(operands.end(), v->second.begin(), v->second.end());
 					} else {
 						printf("variable not mapped\n");
 					}
 				} else {
-					slot.operands.insert(
-						slot.operands.begin()+ins,
-						*op);
-					++ins;
+					operands.push_back(*op);
 				}
 			}
+
+			Operation *slot = expr.refExpr(index);
+			if (slot == nullptr) {
+				printf("internal:%s:%d: expression %lu not found\n", __FILE__, __LINE__, index);
+				return;
+			}
+
+			slot->func = curr->func;
+			if (match.top.empty()) {
+				slot->operands.swap(operands);
+			} else {
+				slot->splice(match.top, operands.data(), operands.data()+operands.size());
+			}
 			match.top.clear();
-			expr.setExpr(slot);
 		}
 	}
 	//cout << "after mapping: " << expr.cast<Expression>().to_string(true) << endl;
@@ -1038,30 +1524,98 @@ void replace(OperationSet expr, const RuleSet &rules, Match match) {
 	// cout << "after erase: " << *this << endl;
 }
 
-Mapping<Operand> minimize(OperationSet expr, vector<Operand> top, RuleSet rules) {
-	static const RuleSet defaultRules = rewriteCanonical() + rewriteSimple();
-	if (rules.empty()) {
-		rules = defaultRules;
+MinimizeOptions::MinimizeOptions() {
+	maxRewrites = 0;
+	maxGrowth = 0.0;
+	timeout = 0.0;
+	cancel = nullptr;
+	stats = nullptr;
+}
+
+MinimizeOptions::~MinimizeOptions() {
+}
+
+MinimizeResult::MinimizeResult() : mapping(Operand::undef(), true) {
+	status = DONE;
+	rewrites = 0;
+}
+
+MinimizeResult::~MinimizeResult() {
+}
+
+Mapping<Operand> minimize(OperationSet expr, vector<Operand> top, RuleSet rules, RewriteStats *stats) {
+	MinimizeOptions options;
+	options.stats = stats;
+	return minimize(expr, top, rules, options).mapping;
+}
+
+MinimizeResult minimize(OperationSet expr, vector<Operand> top, const RuleSet &given, const MinimizeOptions &options) {
+	TraceScope trace("minimize");
+	const RuleSet &rules = given.empty() ? Builtin::get(Builtin::DEFAULT) : given;
+
+	RewriteStats *stats = options.stats;
+	REWRITE_STATS(
+		auto start = std::chrono::steady_clock::now();
+		if (stats) stats->nodesBefore += expr.exprIndex().size();
+	)
+
+	CancelToken cancel(options.cancel);
+	cancel.expireAfter(options.timeout);
+
+	size_t limit = 0;
+	if (options.maxGrowth > 0.0) {
+		limit = std::max((size_t)std::ceil(options.maxGrowth*(double)expr.exprIndex().size()), (size_t)1);
 	}
 
 	//cout << "Rules: " << rules << endl;
 
-	Mapping<Operand> result(Operand::undef(), true);
-	result *= tidy(expr, top);
-	top = result.map(top);
-	vector<Match> tokens = search(expr, top, rules, 1u);
+	MinimizeResult result;
+	result.mapping *= tidy(expr, top);
+	REWRITE_STATS(if (stats) stats->tidies++;)
+	top = result.mapping.map(top);
+	SearchOptions first;
+	first.count = 1;
+	first.cancel = &cancel;
+	first.stats = stats;
+	vector<Match> tokens = search(expr, top, rules, first);
 	while (not tokens.empty()) {
+		if (cancel.isCancelled()) {
+			break;
+		} else if (options.maxRewrites != 0 and result.rewrites >= options.maxRewrites) {
+			result.status = MinimizeResult::REWRITES;
+			break;
+		}
+
 		//cout << "Expr: " << ::to_string(top) << " " << expr.cast<Expression>().to_string(true) << endl;
 		//cout << "Match: " << ::to_string(tokens) << endl;
 		replace(expr, rules, tokens.back());
+		result.rewrites++;
+		REWRITE_STATS(if (stats) stats->replaces++;)
 		//cout << "Replace: " << expr.cast<Expression>().to_string(true) << endl;
 		Mapping<Operand> sub = tidy(expr, top);
+		REWRITE_STATS(if (stats) stats->tidies++;)
 		top = sub.map(top);
-		result *= sub;
+		result.mapping *= sub;
 		//cout << "Canon: " << ::to_string(top) << " " << expr.cast<Expression>().to_string(true) << endl << endl;
-		tokens = search(expr, top, rules, 1u);
+
+		if (limit != 0 and expr.exprIndex().size() > limit) {
+			result.status = MinimizeResult::GROWTH;
+			break;
+		}
+		tokens = search(expr, top, rules, first);
+	}
+
+	// A search that was cut short looks the same as one that found nothing, so
+	// this errs on the side of reporting the cancellation.
+	if (result.status == MinimizeResult::DONE and cancel.isCancelled()) {
+		result.status = cancel.isExpired() ? MinimizeResult::TIMEOUT : MinimizeResult::CANCELLED;
 	}
 
+	REWRITE_STATS(if (stats) {
+		stats->nodesAfter += expr.exprIndex().size();
+		stats->seconds += secondsSince(start);
+	})
+
 	// TODO(edward.bingham) Then I need to implement encoding
 	// Use the unidirectional expression rewrite system?
 	// propagate validity?
@@ -1069,44 +1623,184 @@ Mapping<Operand> minimize(OperationSet expr, vector<Operand> top, RuleSet rules)
 	return result;
 }
 
-/*Expression espresso(Expression expr, vector<Type> vars, Expression directed, Expression undirected) {
-	static const Expression rules = rewriteUndirected();
-	if (undirected.operations.empty()) {
-		undirected = rules;
+vector<int> minimizeAll(vector<Expression> &exprs, const RuleSet &given, const MinimizeOptions &options, size_t threads) {
+	TraceScope trace("minimizeAll");
+	const RuleSet &rules = given.empty() ? Builtin::get(Builtin::DEFAULT) : given;
+
+	// Start with the largest expressions so that one big job isn't left
+	// running alone at the end.
+	vector<size_t> order(exprs.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
 	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return exprs[a].size() > exprs[b].size();
+	});
 
-	// TODO(edward.bingham) Implement the bidirectional search function to search
-	// rule applications that minimize the cost function but then apply all of
-	// the unidirectional rules in between
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::max(std::min(threads, exprs.size()), (size_t)1);
+
+	vector<int> result(exprs.size(), MinimizeResult::DONE);
+	// each worker keeps its own statistics, merged once they are done
+	vector<RewriteStats> local(options.stats != nullptr ? threads : 0);
+	std::atomic<size_t> next(0);
+	auto work = [&](size_t t) {
+		MinimizeOptions job = options;
+		job.stats = local.empty() ? nullptr : &local[t];
+		for (size_t i = next++; i < order.size(); i = next++) {
+			Expression &e = exprs[order[i]];
+			MinimizeResult r = minimize(e, {e.top}, rules, job);
+			e.top = r.mapping.map(e.top);
+			result[order[i]] = r.status;
+		}
+	};
 
-	// TODO(edward.bingham) Create a set of unidirectional rewrite rules to
-	// change wire operators into arithmetic operators, and then a set of
-	// unidirectional rules to switch them back
+	if (threads == 1u) {
+		work(0);
+	} else {
+		vector<std::thread> pool;
+		for (size_t t = 0; t < threads; t++) {
+			pool.push_back(std::thread(work, t));
+		}
+		for (auto t = pool.begin(); t != pool.end(); t++) {
+			t->join();
+		}
+	}
 
-	// TODO(edward.bingham) Tie this all together into an easy-to-use
-	// minimization system.
+	for (auto s = local.begin(); s != local.end(); s++) {
+		*options.stats += *s;
+	}
+	return result;
+}
 
-	//Expression result;
-	//Cost best(1e20, 1e20);
-	expr.minimize(directed);
+size_t hashOf(ConstOperationSet ops, Operand top) {
+	vector<size_t> exprs;
+	for (ConstUpIterator i(ops, {top}); not i.done(); ++i) {
+		size_t result = hashCombine((size_t)i->func, i->operands.size());
+		size_t commuted = 0;
+		for (auto j = i->operands.begin(); j != i->operands.end(); j++) {
+			size_t h = hashCombine((size_t)j->type, 0);
+			if (j->isConst()) {
+				h = hashCombine(h, hashOf(j->cnst));
+			} else if (j->isExpr() and j->index < exprs.size()) {
+				h = hashCombine(h, exprs[j->index]);
+			} else {
+				h = hashCombine(h, j->index);
+			}
 
-	/ *vector<pair<Cost, Expression> > stack;
-	stack.push_back({expr.cost(vars), expr});
-	while (not stack.empty()) {
-		pair<Cost, Expression> curr = stack.back();
-		stack.pop_back();
+			if (i->isCommutative()) {
+				commuted += h;
+			} else {
+				result = hashCombine(result, h);
+			}
+		}
+		result = hashCombine(result, commuted);
+
+		if (i->exprIndex >= exprs.size()) {
+			exprs.resize(i->exprIndex+1, 0);
+		}
+		exprs[i->exprIndex] = result;
+	}
+
+	size_t result = hashCombine((size_t)top.type, 0);
+	if (top.isConst()) {
+		return hashCombine(result, hashOf(top.cnst));
+	} else if (top.isExpr() and top.index < exprs.size()) {
+		return hashCombine(result, exprs[top.index]);
+	}
+	return hashCombine(result, top.index);
+}
+
+OptimizeOptions::OptimizeOptions() {
+	model = Cost::WORD;
+	complexity = 1.0;
+	critical = 1.0;
+	beamWidth = 8;
+	depth = 8;
+	timeout = 0.0;
+}
 
-		vector<Expression::Match> opts = curr.second.search(undirected);
-		for (auto i = opts.begin(); i != opts.end(); i++) {
-			Expression next = curr.second;
-			next.replace(undirected, *i);
-			Cost cost = next.cost(vars);
-			stack.push_back({cost, next});
+OptimizeOptions::~OptimizeOptions() {
+}
+
+double OptimizeOptions::score(Cost c) const {
+	return complexity*c.complexity + critical*c.critical;
+}
+
+// Returns false if an expression structurally identical to e was already
+// seen. The hash only narrows it down, since a collision must not drop a
+// distinct candidate.
+static bool firstSeen(std::unordered_map<size_t, vector<Expression> > &seen, const Expression &e) {
+	vector<Expression> &bucket = seen[hashOf(e, e.top)];
+	for (auto i = bucket.begin(); i != bucket.end(); i++) {
+		if (areSame(*i, e)) {
+			return false;
 		}
-	}* /
+	}
+	bucket.push_back(e);
+	return true;
+}
 
-	return expr;
-}*/
+Expression optimize(Expression expr, vector<Type> vars, RuleSet undirected, RuleSet directed, OptimizeOptions options) {
+	if (undirected.empty()) {
+		undirected = Builtin::get(Builtin::UNDIRECTED);
+	}
+
+	// The deadline is shared with every search() and minimize() so that none
+	// of them can run past the budget.
+	CancelToken deadline;
+	deadline.expireAfter(options.timeout);
+	MinimizeOptions bounded;
+	bounded.cancel = &deadline;
+	SearchOptions all;
+	all.cancel = &deadline;
+
+	// minimize() falls back to the default directed rules when none are given
+	expr.minimize(directed, bounded);
+
+	pair<double, Expression> best(options.score(cost(expr, expr.top, vars, options.model)), expr);
+	std::unordered_map<size_t, vector<Expression> > seen;
+	firstSeen(seen, expr);
+
+	// Breadth-first over the number of undirected rewrites, only keeping the
+	// cheapest candidates at each depth.
+	vector<pair<double, Expression> > beam({best});
+	for (size_t d = 0; d < options.depth and not beam.empty() and not deadline.isCancelled(); d++) {
+		vector<pair<double, Expression> > next;
+		for (auto curr = beam.begin(); curr != beam.end() and not deadline.isCancelled(); curr++) {
+			vector<Match> matches = search(curr->second, {curr->second.top}, undirected, all);
+			for (auto m = matches.begin(); m != matches.end() and not deadline.isCancelled(); m++) {
+				Expression cand = curr->second;
+				replace(cand, undirected, *m);
+				// a candidate cut short by the deadline is still equivalent
+				cand.minimize(directed, bounded);
+
+				if (not firstSeen(seen, cand)) {
+					continue;
+				}
+
+				double score = options.score(cost(cand, cand.top, vars, options.model));
+				if (score < best.first) {
+					best = {score, cand};
+				}
+				next.push_back({score, cand});
+			}
+		}
+
+		std::stable_sort(next.begin(), next.end(),
+			[](const pair<double, Expression> &a, const pair<double, Expression> &b) {
+				return a.first < b.first;
+			});
+		if (options.beamWidth != 0 and next.size() > options.beamWidth) {
+			next.erase(next.begin()+options.beamWidth, next.end());
+		}
+		beam = next;
+	}
+
+	return best.second;
+}
 
 }
 
@@ -4,7 +4,11 @@
 #include "type.h"
 #include "expression.h"
 #include "rewrite.h"
+#include "stats.h"
+#include "kernel.h"
 #include <ostream>
+#include <atomic>
+#include <chrono>
 
 namespace arithmetic {
 
@@ -32,29 +36,7 @@ struct UpIterator {
 bool operator==(const UpIterator &i0, const UpIterator &i1);
 bool operator!=(const UpIterator &i0, const UpIterator &i1);
 
-struct ConstUpIterator {
-	ConstUpIterator(ConstOperationSet root, vector<Operand> start=vector<Operand>());
-	~ConstUpIterator();
-
-	ConstOperationSet root;
-	// prefer multiple vector<bool> instead of vector<pair<bool, bool>
-	// > because vector<bool> is a bitset in a c++
-	vector<bool> expand;
-	vector<bool> seen;
-	vector<size_t> stack;
-
-	void setSeen(size_t index);
-	bool getSeen(size_t index) const;
-
-	const Operation &get();
-	const Operation &operator*();
-	const Operation *operator->();
-	ConstUpIterator &operator++();
-	bool done() const;
-};
-
-bool operator==(const ConstUpIterator &i0, const ConstUpIterator &i1);
-bool operator!=(const ConstUpIterator &i0, const ConstUpIterator &i1);
+typedef ConstUpIteratorOn<ConstOperationSet> ConstUpIterator;
 
 struct DownIterator {
 	DownIterator(OperationSet root, vector<Operand> start=vector<Operand>());
@@ -123,6 +105,12 @@ struct PostOrderDFSIterator {
 bool operator==(const PostOrderDFSIterator &i0, const PostOrderDFSIterator &i1);
 bool operator!=(const PostOrderDFSIterator &i0, const PostOrderDFSIterator &i1);
 
+// Write top to os without rendering each subexpression to its own string
+// first. If share is set, every operation used more than once is written
+// once as a let binding and then referred to by its index, which keeps the
+// output linear in the size of the DAG:
+//   let e0 = (v0+v1), e2 = (e0*e0) in (e2-e0)
+void print(ostream &os, ConstOperationSet ops, Operand top, bool share=false);
 string to_string(ConstOperationSet ops, Operand top, bool debug=true);
 
 struct Match {
@@ -143,9 +131,15 @@ struct Match {
 
 ostream &operator<<(ostream &os, Match m);
 
+// The Expression and SimpleOperationSet overloads skip the type erasure,
+// see kernel.h
 ValRef evaluate(ConstOperationSet expr, Operand top, State values, TypeSet types=TypeSet(), Caller caller=Caller());
+ValRef evaluate(const Expression &expr, Operand top, const State &values, TypeSet types=TypeSet(), Caller caller=Caller());
+ValRef evaluate(const SimpleOperationSet &expr, Operand top, const State &values, TypeSet types=TypeSet(), Caller caller=Caller());
 size_t lvalueBase(ConstOperationSet ops, Operand top, TypeSet types=TypeSet());
-Cost cost(ConstOperationSet ops, Operand top, vector<Type> vars);
+Cost cost(ConstOperationSet ops, Operand top, vector<Type> vars, Cost::Model model=Cost::WORD);
+Cost cost(const Expression &ops, Operand top, const vector<Type> &vars, Cost::Model model=Cost::WORD);
+Cost cost(const SimpleOperationSet &ops, Operand top, const vector<Type> &vars, Cost::Model model=Cost::WORD);
 
 bool verifyRuleFormat(ConstOperationSet ops, Operand i, bool msg=true);
 bool verifyRulesFormat(ConstOperationSet ops, Operand top, bool msg=true);
@@ -155,11 +149,138 @@ Expression subExpr(ConstOperationSet e0, Operand top);
 
 Mapping<Operand> tidy(OperationSet expr, vector<Operand> top, bool rules=false);
 
+// Cooperative cancellation for long running rewrites. Another thread may call
+// cancel() at any time, and the token also expires at its deadline. A token
+// is cancelled whenever its parent is, which lets a caller's token be combined
+// with a deadline of its own.
+struct CancelToken {
+	CancelToken(const CancelToken *parent=nullptr);
+	~CancelToken();
+
+	std::atomic<bool> flag;
+	bool hasDeadline;
+	std::chrono::steady_clock::time_point deadline;
+	const CancelToken *parent;
+
+	void cancel();
+	// expire seconds from now, 0 for no deadline
+	void expireAfter(double seconds);
+	bool isCancelled() const;
+	bool isExpired() const;
+};
+
+// Find up to count matches (0 for all) rooted at a single expression. If
+// stats is given, it accumulates the matcher's statistics.
+vector<Match> searchAt(ConstOperationSet ops, Operand seed, const vector<Operand> &pin, const RuleSet &rules, size_t count=0, RewriteStats *stats=nullptr);
+// The same, but only the rule starts that labels accepts at each expression
+// are tried. A labeling that accepts every start skips the automaton.
+vector<Match> searchAt(ConstOperationSet ops, Operand seed, const vector<Operand> &pin, const RuleSet &rules, const Labeling &labels, size_t count=0, RewriteStats *stats=nullptr);
+
+struct SearchOptions {
+	SearchOptions();
+	~SearchOptions();
+
+	// The maximum number of matches to find. 0 means no limit.
+	size_t count;
+	// The seeds are split across this many threads, 0 for one per core. The
+	// result is the same for any number of threads.
+	size_t threads;
+	// Checked between seeds. Once it is cancelled, the search stops early
+	// with the matches found so far. May be null.
+	const CancelToken *cancel;
+	// Accumulate statistics here, may be null
+	RewriteStats *stats;
+};
+
+// Find up to count matches (0 for all) anywhere in the expression
 vector<Match> search(ConstOperationSet ops, vector<Operand> pin, const RuleSet &rules, size_t count=0, bool fwd=true, bool bwd=true);
+vector<Match> search(ConstOperationSet ops, vector<Operand> pin, const RuleSet &rules, const SearchOptions &options);
+// Copy the replacement template tmpl into expr, substituting the variables
+// and expanding comprehensions. Returns the resulting list of operands.
+vector<Operand> instantiate(OperationSet expr, const RuleSet &rules, Operand tmpl, const map<size_t, vector<Operand> > &vars);
 void replace(OperationSet expr, const RuleSet &rules, Match token);
-Mapping<Operand> minimize(OperationSet expr, vector<Operand> top, RuleSet rules=RuleSet());
+Mapping<Operand> minimize(OperationSet expr, vector<Operand> top, RuleSet rules=RuleSet(), RewriteStats *stats=nullptr);
+
+struct MinimizeOptions {
+	MinimizeOptions();
+	~MinimizeOptions();
+
+	// The maximum number of rewrites applied. 0 means no limit.
+	size_t maxRewrites;
+	// The maximum number of operations as a multiple of the number in the
+	// input. 0 means no limit.
+	double maxGrowth;
+	// Wall-clock budget in seconds. 0 means no limit.
+	double timeout;
+	// Stop as soon as this is cancelled, may be null
+	const CancelToken *cancel;
+	// Accumulate statistics here, may be null
+	RewriteStats *stats;
+};
+
+struct MinimizeResult {
+	MinimizeResult();
+	~MinimizeResult();
+
+	enum Status {
+		// no more rules apply
+		DONE = 0,
+		// stopped early by the budget in MinimizeOptions
+		REWRITES = 1,
+		GROWTH = 2,
+		TIMEOUT = 3,
+		CANCELLED = 4
+	};
+
+	// from the operands in the input to the operands in the result
+	Mapping<Operand> mapping;
+	int status;
+	// the number of rewrites applied
+	size_t rewrites;
+};
+
+// DESIGN(edward.bingham) Every rewrite leaves an expression equivalent to the
+// input, so minimize() can stop after any of them and the expression is still
+// correct. With directed rules, the last expression reached is also the
+// smallest, so stopping early returns the best result found so far. The one
+// exception is GROWTH, where the last rewrite pushed the expression over the
+// limit.
+MinimizeResult minimize(OperationSet expr, vector<Operand> top, const RuleSet &rules, const MinimizeOptions &options);
+
+// Minimize each expression in place, spread over threads (0 for one per
+// core). Every thread shares the same rules without copying them. The limits
+// in options apply to each expression separately, and the cancel token to all
+// of them. Statistics from every thread are accumulated into options.stats.
+// Returns the MinimizeResult::Status of each expression.
+vector<int> minimizeAll(vector<Expression> &exprs, const RuleSet &rules=RuleSet(), const MinimizeOptions &options=MinimizeOptions(), size_t threads=0);
+
+// Structural hash of the expression rooted at top. The operands of
+// commutative operations are combined without regard to their order.
+size_t hashOf(ConstOperationSet ops, Operand top);
+
+struct OptimizeOptions {
+	OptimizeOptions();
+	~OptimizeOptions();
+
+	// how to compute and weigh the cost of each candidate
+	Cost::Model model;
+	double complexity;
+	double critical;
+
+	// The number of candidates kept at each depth of the search. 0 keeps every
+	// candidate.
+	size_t beamWidth;
+	// The maximum number of undirected rewrites applied to the input
+	size_t depth;
+	// Wall-clock budget in seconds. 0 means no limit.
+	double timeout;
+
+	double score(Cost c) const;
+};
 
-//Expression espresso(Expression expr, vector<Type> vars=vector<Type>(), Expression directed=Expression(), Expression undirected=Expression());
+// Search the space of undirected rewrites for the cheapest equivalent
+// expression. The directed rules are used to clean up each candidate.
+Expression optimize(Expression expr, vector<Type> vars, RuleSet undirected=RuleSet(), RuleSet directed=RuleSet(), OptimizeOptions options=OptimizeOptions());
 
 }
 
@@ -0,0 +1,259 @@
+#include "automaton.h"
+#include "algorithm.h"
+#include "rewrite.h"
+
+namespace arithmetic {
+
+Automaton::Automaton() {
+}
+
+Automaton::~Automaton() {
+}
+
+void Automaton::compile(ConstOperationSet sub, const vector<Rule> &rules) {
+	clear();
+
+	vector<Operand> roots;
+	for (auto i = rules.begin(); i != rules.end(); i++) {
+		if (i->left.isExpr()) {
+			roots.push_back(i->left);
+		}
+		if (not i->directed and i->right.isExpr()) {
+			roots.push_back(i->right);
+		}
+	}
+
+	for (ConstUpIterator i(sub, roots); not i.done(); ++i) {
+		if (i->exprIndex >= exprs.size()) {
+			exprs.resize(i->exprIndex+1, std::numeric_limits<size_t>::max());
+		} else if (exprs[i->exprIndex] != std::numeric_limits<size_t>::max()) {
+			continue;
+		}
+
+		vector<size_t> args;
+		for (auto j = i->operands.begin(); j != i->operands.end(); j++) {
+			// Comprehensions are checked by the matcher, so they may match
+			// anything here.
+			if (j->isExpr() and sub.getExpr(j->index)->func == Operation::EACH) {
+				args.push_back(std::numeric_limits<size_t>::max());
+				continue;
+			}
+
+			size_t p = patternOf(*j);
+			if (j->isConst() and p == std::numeric_limits<size_t>::max()) {
+				p = patterns.size();
+				patterns.push_back(*j);
+				operands.push_back(vector<size_t>());
+				consts.push_back(p);
+			}
+			args.push_back(p);
+		}
+
+		size_t p = patterns.size();
+		exprs[i->exprIndex] = p;
+		patterns.push_back(Operand::exprOf(i->exprIndex));
+		operands.push_back(args);
+		funcs[i->func].push_back(p);
+	}
+
+	accept.resize(patterns.size());
+	for (size_t j = 0; j < rules.size(); j++) {
+		for (int side = 0; side < (rules[j].directed ? 1 : 2); side++) {
+			Operand from = (side == 0 ? rules[j].left : rules[j].right);
+			if (from.isVar()) {
+				always.push_back(j*2+side);
+			} else if (from.isExpr()) {
+				accept[exprs[from.index]].push_back(j*2+side);
+			}
+		}
+	}
+}
+
+void Automaton::clear() {
+	patterns.clear();
+	operands.clear();
+	exprs.clear();
+	funcs.clear();
+	consts.clear();
+	accept.clear();
+	always.clear();
+}
+
+bool Automaton::empty() const {
+	return patterns.empty() and always.empty();
+}
+
+size_t Automaton::patternOf(Operand op) const {
+	if (op.isExpr()) {
+		if (op.index < exprs.size()) {
+			return exprs[op.index];
+		}
+	} else if (op.isConst()) {
+		for (auto i = consts.begin(); i != consts.end(); i++) {
+			if (areSame(patterns[*i].cnst, op.cnst)) {
+				return *i;
+			}
+		}
+	}
+	return std::numeric_limits<size_t>::max();
+}
+
+Labeling::Labeling() {
+	// state 0 matches nothing, which is the state of every variable
+	stateOf(vector<size_t>(), vector<size_t>());
+}
+
+Labeling::~Labeling() {
+}
+
+size_t Labeling::stateOf(vector<size_t> match, vector<size_t> start) {
+	vector<size_t> key = match;
+	key.push_back(std::numeric_limits<size_t>::max());
+	key.insert(key.end(), start.begin(), start.end());
+
+	auto pos = states.insert({key, matches.size()});
+	if (pos.second) {
+		matches.push_back(match);
+		starts.push_back(start);
+	}
+	return pos.first->second;
+}
+
+bool Labeling::has(size_t state, size_t pattern) const {
+	return std::binary_search(matches[state].begin(), matches[state].end(), pattern);
+}
+
+// Check whether each of the k pattern operands can be given a distinct one
+// of the n operands, using augmenting paths over fits.
+bool Labeling::assignable(size_t k, size_t n) {
+	owner.assign(n, k);
+	for (size_t i = 0; i < k; i++) {
+		visited.assign(n, false);
+		if (not augment(i, k, n)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Labeling::augment(size_t i, size_t k, size_t n) {
+	for (size_t j = 0; j < n; j++) {
+		if (fits[i*n+j] and not visited[j]) {
+			visited[j] = true;
+			if (owner[j] == k or augment(owner[j], k, n)) {
+				owner[j] = i;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+const vector<size_t> &Labeling::at(size_t expr) const {
+	if (expr < label.size() and label[expr] != std::numeric_limits<size_t>::max()) {
+		return starts[label[expr]];
+	}
+	return starts[0];
+}
+
+Labeling label(const RuleSet &rules, ConstOperationSet ops, vector<Operand> top) {
+	const Automaton &automaton = rules.automaton;
+	Labeling result;
+
+	vector<size_t> key;
+	vector<size_t> match;
+	vector<size_t> start;
+	for (ConstUpIterator i(ops, top); not i.done(); ++i) {
+		if (i->exprIndex >= result.label.size()) {
+			result.label.resize(i->exprIndex+1, std::numeric_limits<size_t>::max());
+		}
+
+		// The transition is determined by the function and the state of each
+		// operand. Commutative operations don't care about operand order.
+		key.clear();
+		key.push_back(i->func);
+		for (auto j = i->operands.begin(); j != i->operands.end(); j++) {
+			if (j->isExpr()) {
+				key.push_back(result.label[j->index]);
+			} else if (j->isConst()) {
+				match.clear();
+				for (auto c = automaton.consts.begin(); c != automaton.consts.end(); c++) {
+					const Value &to = automaton.patterns[*c].cnst;
+					if (areSame(j->cnst, to) or (j->cnst.isValid() and to.isUnknown())) {
+						match.push_back(*c);
+					}
+				}
+				key.push_back(result.stateOf(match, vector<size_t>()));
+			} else {
+				key.push_back(0);
+			}
+		}
+		bool commute = i->isCommutative();
+		if (commute) {
+			sort(key.begin()+1, key.end());
+		}
+
+		auto pos = result.delta.find(key);
+		if (pos != result.delta.end()) {
+			result.label[i->exprIndex] = pos->second;
+			continue;
+		}
+
+		size_t n = key.size()-1;
+		match.clear();
+		start = automaton.always;
+		auto f = automaton.funcs.find(i->func);
+		if (f != automaton.funcs.end()) {
+			for (auto p = f->second.begin(); p != f->second.end(); p++) {
+				const vector<size_t> &args = automaton.operands[*p];
+				size_t k = args.size();
+
+				result.fits.assign(k*n, false);
+				for (size_t a = 0; a < k; a++) {
+					for (size_t b = 0; b < n; b++) {
+						result.fits[a*n+b] = (args[a] == std::numeric_limits<size_t>::max() or result.has(key[1+b], args[a]));
+					}
+				}
+
+				// Whether this pattern matches as an operand of another pattern
+				// and whether it matches as the top of a rule. Non-commutative
+				// rules may match a window of a wider operation at the top, and
+				// the matcher checks those windows itself.
+				bool inner = false;
+				bool outer = false;
+				if (commute and k == 1u) {
+					inner = true;
+					for (size_t b = 0; b < n and inner; b++) {
+						inner = result.fits[b];
+					}
+				} else if (commute and n >= k) {
+					inner = result.assignable(k, n);
+				} else if (n == k) {
+					inner = true;
+					for (size_t a = 0; a < k and inner; a++) {
+						inner = result.fits[a*n+a];
+					}
+				} else if (n > k) {
+					outer = true;
+				}
+
+				if (inner) {
+					match.push_back(*p);
+				}
+				if (inner or outer) {
+					start.insert(start.end(), automaton.accept[*p].begin(), automaton.accept[*p].end());
+				}
+			}
+		}
+		sort(start.begin(), start.end());
+		start.erase(unique(start.begin(), start.end()), start.end());
+
+		size_t state = result.stateOf(match, start);
+		result.delta.insert({key, state});
+		result.label[i->exprIndex] = state;
+	}
+
+	return result;
+}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include "operation_set.h"
+
+namespace arithmetic {
+
+struct Rule;
+struct RuleSet;
+
+// DESIGN(edward.bingham) A bottom-up tree automaton compiled from a rule
+// set. The patterns are every constant and operation that appears on a side
+// of a rule that may be matched. An expression's state is the set of patterns
+// it could match given the states of its operands. Variables are checked
+// when the match is made, so this is a filter: it never rejects a match the
+// matcher would accept, but it may accept some that the matcher rejects.
+// Labeling a whole expression is a single post-order pass, and the
+// transitions are cached by function and operand states, so the work per
+// node doesn't grow with the number of rules.
+struct Automaton {
+	Automaton();
+	~Automaton();
+
+	// Every constant and operation in the rule patterns. Operations index
+	// into the rule set's sub.
+	vector<Operand> patterns;
+	// For each pattern, the pattern index of each of its operands, or max
+	// for variables
+	vector<vector<size_t> > operands;
+	// expression index in the rule set to pattern index, max if the
+	// expression isn't a pattern
+	vector<size_t> exprs;
+	// pattern indices of operations grouped by function
+	map<int, vector<size_t> > funcs;
+	// pattern indices of constants
+	vector<size_t> consts;
+
+	// The rule starts accepted at each pattern. A start is rule*2 to match
+	// the left side or rule*2+1 to match the right side of an undirected
+	// rule.
+	vector<vector<size_t> > accept;
+	// starts whose side is a single variable and are accepted everywhere
+	vector<size_t> always;
+
+	void compile(ConstOperationSet sub, const vector<Rule> &rules);
+	void clear();
+	bool empty() const;
+
+	size_t patternOf(Operand op) const;
+};
+
+// The result of running an automaton over an expression
+struct Labeling {
+	Labeling();
+	~Labeling();
+
+	// Each state is a sorted list of the patterns it matches and the rule
+	// starts it accepts.
+	vector<vector<size_t> > matches;
+	vector<vector<size_t> > starts;
+	map<vector<size_t>, size_t> states;
+	// transitions computed so far, keyed on the function and operand states
+	map<vector<size_t>, size_t> delta;
+
+	// the state of each expression, max if it wasn't labeled
+	vector<size_t> label;
+
+	// scratch space for the bipartite matching of commutative operands
+	vector<bool> fits;
+	vector<size_t> owner;
+	vector<bool> visited;
+
+	size_t stateOf(vector<size_t> match, vector<size_t> start);
+	bool has(size_t state, size_t pattern) const;
+	bool assignable(size_t k, size_t n);
+	bool augment(size_t i, size_t k, size_t n);
+
+	// The rule starts that may match at an expression
+	const vector<size_t> &at(size_t expr) const;
+};
+
+// Label every expression reachable from top with its automaton state
+Labeling label(const RuleSet &rules, ConstOperationSet ops, vector<Operand> top);
+
+}
@@ -0,0 +1,277 @@
+#include "bdd.h"
+#include "algorithm.h"
+
+#include <common/text.h>
+
+namespace arithmetic {
+
+const Bdd::Node Bdd::ZERO;
+const Bdd::Node Bdd::ONE;
+
+size_t Bdd::Hash::operator()(const std::array<uint32_t, 3> &key) const {
+	uint64_t h = key[0];
+	h = h*0x9E3779B97F4A7C15ull + key[1];
+	h = h*0x9E3779B97F4A7C15ull + key[2];
+	return (size_t)(h ^ (h >> 29));
+}
+
+Bdd::Bdd() {
+	uint32_t last = std::numeric_limits<uint32_t>::max();
+	nodes.push_back({last, ZERO, ZERO});
+	nodes.push_back({last, ONE, ONE});
+	limit = 0;
+	exceeded = false;
+}
+
+Bdd::~Bdd() {
+}
+
+uint32_t Bdd::varOf(Node n) const {
+	return nodes[n][0];
+}
+
+Bdd::Node Bdd::low(Node n) const {
+	return nodes[n][1];
+}
+
+Bdd::Node Bdd::high(Node n) const {
+	return nodes[n][2];
+}
+
+bool Bdd::isConstant(Node n) const {
+	return n == ZERO or n == ONE;
+}
+
+Bdd::Node Bdd::make(uint32_t var, Node lo, Node hi) {
+	if (lo == hi) {
+		return lo;
+	}
+
+	std::array<uint32_t, 3> key({var, lo, hi});
+	auto pos = unique.find(key);
+	if (pos != unique.end()) {
+		return pos->second;
+	}
+
+	if (limit != 0 and nodes.size() >= limit) {
+		exceeded = true;
+		return ZERO;
+	}
+
+	Node result = (Node)nodes.size();
+	nodes.push_back(key);
+	unique.insert({key, result});
+	return result;
+}
+
+Bdd::Node Bdd::variable(uint32_t var) {
+	return make(var, ZERO, ONE);
+}
+
+Bdd::Node Bdd::ite(Node f, Node g, Node h) {
+	if (exceeded) {
+		return ZERO;
+	} else if (f == ONE) {
+		return g;
+	} else if (f == ZERO) {
+		return h;
+	} else if (g == h) {
+		return g;
+	} else if (g == ONE and h == ZERO) {
+		return f;
+	}
+
+	std::array<uint32_t, 3> key({f, g, h});
+	auto pos = computed.find(key);
+	if (pos != computed.end()) {
+		return pos->second;
+	}
+
+	uint32_t var = std::min(varOf(f), std::min(varOf(g), varOf(h)));
+	auto cofactor = [&](Node n, bool side) {
+		if (varOf(n) != var) {
+			return n;
+		}
+		return side ? high(n) : low(n);
+	};
+
+	Node lo = ite(cofactor(f, false), cofactor(g, false), cofactor(h, false));
+	Node hi = ite(cofactor(f, true), cofactor(g, true), cofactor(h, true));
+	Node result = make(var, lo, hi);
+	computed.insert({key, result});
+	return result;
+}
+
+Bdd::Node Bdd::notOf(Node f) {
+	return ite(f, ZERO, ONE);
+}
+
+Bdd::Node Bdd::andOf(Node f, Node g) {
+	return ite(f, g, ZERO);
+}
+
+Bdd::Node Bdd::orOf(Node f, Node g) {
+	return ite(f, ONE, g);
+}
+
+Bdd::Node Bdd::xorOf(Node f, Node g) {
+	return ite(f, notOf(g), g);
+}
+
+GuardEncoder::GuardEncoder() {
+	count = 0;
+}
+
+GuardEncoder::~GuardEncoder() {
+}
+
+GuardEncoder::Rails GuardEncoder::constant(const Value &v) {
+	if (v.isUnstable()) {
+		return {Bdd::ZERO, Bdd::ONE};
+	} else if (v.isNeutral() or (v.isValid() and v.type == Value::BOOL and not v.bval)) {
+		return {Bdd::ZERO, Bdd::ZERO};
+	}
+	return {Bdd::ONE, Bdd::ZERO};
+}
+
+GuardEncoder::Rails GuardEncoder::atom(ConstOperationSet ops, Operand op) {
+	uint32_t var = 0;
+	if (op.isVar()) {
+		auto pos = vars.insert({op.index, count});
+		if (pos.second) {
+			leaves.push_back(op);
+			count++;
+		}
+		var = pos.first->second;
+	} else {
+		auto pos = atoms.insert({to_string(ops, op, false), count});
+		if (pos.second) {
+			leaves.push_back(op);
+			count++;
+		}
+		var = pos.first->second;
+	}
+	return {bdd.variable(var), Bdd::ZERO};
+}
+
+Bdd::Node GuardEncoder::neutral(Rails r) {
+	return bdd.andOf(bdd.notOf(r.valid), bdd.notOf(r.unstable));
+}
+
+GuardEncoder::Rails GuardEncoder::encode(ConstOperationSet ops, Operand top) {
+	if (top.isUndef()) {
+		return {Bdd::ZERO, Bdd::ONE};
+	} else if (top.isConst() and not top.cnst.isUnknown()) {
+		return constant(top.cnst);
+	} else if (not top.isExpr()) {
+		return atom(ops, top);
+	}
+
+	map<size_t, Rails> exprs;
+	// whether each expression depends on a variable
+	map<size_t, bool> free;
+	// whether each expression is a wire or boolean
+	map<size_t, bool> logic;
+	for (ConstUpIterator i(ops, {top}); not i.done(); ++i) {
+		vector<Rails> args;
+		vector<bool> isLogic;
+		bool depends = false;
+		for (auto j = i->operands.begin(); j != i->operands.end(); j++) {
+			if (j->isExpr()) {
+				args.push_back(exprs[j->index]);
+				isLogic.push_back(logic[j->index]);
+				depends = depends or free[j->index];
+			} else if (j->isConst() and not j->cnst.isUnknown()) {
+				args.push_back(constant(j->cnst));
+				isLogic.push_back(j->cnst.type == Value::WIRE or j->cnst.type == Value::BOOL);
+			} else {
+				args.push_back(atom(ops, *j));
+				isLogic.push_back(true);
+				depends = true;
+			}
+		}
+		free[i->exprIndex] = depends;
+
+		switch (i->func) {
+		case Operation::IDENTITY:
+			logic[i->exprIndex] = not isLogic.empty() and isLogic[0];
+			break;
+		case Operation::TERNARY:
+			logic[i->exprIndex] = isLogic.size() == 3u and isLogic[1] and isLogic[2];
+			break;
+		default:
+			logic[i->exprIndex] = (i->func >= Operation::VALIDITY and i->func <= Operation::GREATER_EQUAL);
+		}
+
+		// Anything that produces a value other than a wire or boolean, like a
+		// ternary choosing between integers, is opaque.
+		Rails result;
+		switch (logic[i->exprIndex] ? i->func : Operation::UNDEF) {
+		case Operation::IDENTITY:
+		case Operation::VALIDITY:
+		case Operation::TRUTHINESS:
+			result = args[0];
+			break;
+		case Operation::WIRE_NOT:
+		case Operation::BOOLEAN_NOT:
+			result.valid = neutral(args[0]);
+			result.unstable = args[0].unstable;
+			break;
+		case Operation::WIRE_AND:
+		case Operation::BOOLEAN_AND: {
+			// neutral wins, then unstable
+			Bdd::Node off = Bdd::ZERO;
+			Bdd::Node unstable = Bdd::ZERO;
+			for (auto j = args.begin(); j != args.end(); j++) {
+				off = bdd.orOf(off, neutral(*j));
+				unstable = bdd.orOf(unstable, j->unstable);
+			}
+			result.unstable = bdd.andOf(bdd.notOf(off), unstable);
+			result.valid = bdd.andOf(bdd.notOf(off), bdd.notOf(unstable));
+		} break;
+		case Operation::WIRE_OR:
+		case Operation::BOOLEAN_OR: {
+			// valid wins, then unstable
+			Bdd::Node on = Bdd::ZERO;
+			Bdd::Node unstable = Bdd::ZERO;
+			for (auto j = args.begin(); j != args.end(); j++) {
+				on = bdd.orOf(on, j->valid);
+				unstable = bdd.orOf(unstable, j->unstable);
+			}
+			result.valid = on;
+			result.unstable = bdd.andOf(bdd.notOf(on), unstable);
+		} break;
+		case Operation::WIRE_XOR:
+		case Operation::BOOLEAN_XOR: {
+			Bdd::Node parity = Bdd::ZERO;
+			Bdd::Node unstable = Bdd::ZERO;
+			for (auto j = args.begin(); j != args.end(); j++) {
+				parity = bdd.xorOf(parity, j->valid);
+				unstable = bdd.orOf(unstable, j->unstable);
+			}
+			result.valid = bdd.andOf(bdd.notOf(unstable), parity);
+			result.unstable = unstable;
+		} break;
+		case Operation::TERNARY:
+			if (args.size() == 3u) {
+				result.valid = bdd.andOf(bdd.notOf(args[0].unstable), bdd.ite(args[0].valid, args[1].valid, args[2].valid));
+				result.unstable = bdd.orOf(args[0].unstable, bdd.ite(args[0].valid, args[1].unstable, args[2].unstable));
+				break;
+			}
+			// fall through
+		default:
+			if (depends) {
+				result = atom(ops, i->op());
+			} else {
+				Value v = evaluate(ops, i->op(), State()).val;
+				result = v.isUnknown() ? atom(ops, i->op()) : constant(v);
+			}
+		}
+
+		exprs[i->exprIndex] = result;
+	}
+
+	return exprs[top.index];
+}
+
+}
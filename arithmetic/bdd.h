@@ -0,0 +1,92 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include <unordered_map>
+
+#include "operation_set.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) A reduced ordered binary decision diagram. Nodes
+// are hash-consed through a unique table, so two functions are equivalent
+// exactly when they are the same node, and every operation is built from
+// if-then-else with a computed cache. Node 0 is false and node 1 is true.
+// Variables are ordered by their index, which is the order in which they
+// were first seen.
+struct Bdd {
+	Bdd();
+	~Bdd();
+
+	typedef uint32_t Node;
+
+	static const Node ZERO = 0;
+	static const Node ONE = 1;
+
+	struct Hash {
+		size_t operator()(const std::array<uint32_t, 3> &key) const;
+	};
+
+	// {variable, low, high} for each node. The terminals have the largest
+	// variable so they sort after every real variable.
+	vector<std::array<uint32_t, 3> > nodes;
+	std::unordered_map<std::array<uint32_t, 3>, Node, Hash> unique;
+	std::unordered_map<std::array<uint32_t, 3>, Node, Hash> computed;
+
+	// If limit isn't 0, make() stops adding nodes once there are limit of them
+	// and sets exceeded. Every result after that is meaningless.
+	size_t limit;
+	bool exceeded;
+
+	uint32_t varOf(Node n) const;
+	Node low(Node n) const;
+	Node high(Node n) const;
+	bool isConstant(Node n) const;
+
+	Node make(uint32_t var, Node lo, Node hi);
+	Node variable(uint32_t var);
+	Node ite(Node f, Node g, Node h);
+
+	Node notOf(Node f);
+	Node andOf(Node f, Node g);
+	Node orOf(Node f, Node g);
+	Node xorOf(Node f, Node g);
+};
+
+// DESIGN(edward.bingham) Guards are three valued: a wire is valid, neutral,
+// or unstable. So each guard is encoded as two functions over its
+// variables, one that is true where the guard is valid and one that is true
+// where it's unstable. Where neither is true, the guard is neutral. Wire
+// and boolean operations follow the rules in value.cpp, with true treated
+// as valid and false as neutral. Variables are assumed to be stable. Any
+// other operation on variables is an opaque atom, identified by how it
+// prints, so the same comparison in two guards is the same atom. That
+// includes a ternary or identity whose result isn't a wire or boolean,
+// since every valid integer would otherwise look like the same value.
+// Operations on constants alone are evaluated.
+struct GuardEncoder {
+	GuardEncoder();
+	~GuardEncoder();
+
+	struct Rails {
+		Bdd::Node valid;
+		Bdd::Node unstable;
+	};
+
+	Bdd bdd;
+	// variable index to bdd variable
+	map<size_t, uint32_t> vars;
+	// opaque subexpressions to bdd variable
+	map<string, uint32_t> atoms;
+	// the operand each bdd variable was made for
+	vector<Operand> leaves;
+	uint32_t count;
+
+	Rails constant(const Value &v);
+	Rails atom(ConstOperationSet ops, Operand op);
+	Rails encode(ConstOperationSet ops, Operand top);
+
+	Bdd::Node neutral(Rails r);
+};
+
+}
@@ -0,0 +1,168 @@
+#include "builder.h"
+#include "algorithm.h"
+
+namespace arithmetic {
+
+Handle::Handle() {
+	ctx = nullptr;
+}
+
+Handle::Handle(Builder *ctx, Operand op) {
+	this->ctx = ctx;
+	this->op = op;
+}
+
+Handle::~Handle() {
+}
+
+Builder::Builder() {
+}
+
+Builder::~Builder() {
+}
+
+Handle Builder::of(Operand op) {
+	return Handle(this, op);
+}
+
+Handle Builder::of(Value v) {
+	return Handle(this, Operand(v));
+}
+
+Handle Builder::of(const Expression &e) {
+	if (not e.top.isExpr()) {
+		return Handle(this, e.top);
+	}
+
+	// Like Expression::append(), this copies every operation in e even if it
+	// already exists here.
+	vector<size_t> m;
+	for (ConstUpIterator i(e, {e.top}); not i.done(); ++i) {
+		Operation o = *i;
+		for (auto j = o.operands.begin(); j != o.operands.end(); j++) {
+			if (j->isExpr()) {
+				j->index = m[j->index];
+			}
+		}
+		Operand op = expr.pushExpr(o);
+		table.insert({hashOf(o), op.index});
+		if (i->exprIndex >= m.size()) {
+			m.resize(i->exprIndex+1, 0u);
+		}
+		m[i->exprIndex] = op.index;
+	}
+	return Handle(this, Operand::exprOf(m[e.top.index]));
+}
+
+Handle Builder::varOf(size_t index) {
+	return Handle(this, Operand::varOf(index));
+}
+
+Handle Builder::push(int func, vector<Operand> args) {
+	Operation o(func, args);
+	size_t h = hashOf(o);
+
+	// Expression::push() reuses the first identical operation in index order
+	size_t found = std::numeric_limits<size_t>::max();
+	auto range = table.equal_range(h);
+	for (auto i = range.first; i != range.second; i++) {
+		if (i->second < found and *expr.getExpr(i->second) == o) {
+			found = i->second;
+		}
+	}
+	if (found != std::numeric_limits<size_t>::max()) {
+		return Handle(this, Operand::exprOf(found));
+	}
+
+	Operand op = expr.pushExpr(o);
+	table.insert({h, op.index});
+	return Handle(this, op);
+}
+
+Handle Builder::push(int func, vector<Handle> args) {
+	vector<Operand> ops;
+	ops.reserve(args.size());
+	for (auto i = args.begin(); i != args.end(); i++) {
+		if (i->ctx != this) {
+			printf("internal:%s:%d: handle from a different builder\n", __FILE__, __LINE__);
+			return Handle(this, Operand::undef());
+		}
+		ops.push_back(i->op);
+	}
+	return push(func, ops);
+}
+
+Expression Builder::get(Handle top) const {
+	Expression result;
+	result.top = top.op;
+	if (not top.op.isExpr()) {
+		return result;
+	}
+
+	Mapping<size_t> m(std::numeric_limits<size_t>::max(), false);
+	for (ConstUpIterator i(expr, {top.op}); not i.done(); ++i) {
+		m.set(i->op().index, result.pushExpr(Operation(*i).applyExprs(m)).index);
+	}
+	result.top.applyExprs(m);
+	return result;
+}
+
+Expression Builder::take(Handle top) {
+	Expression result;
+	std::swap(result.sub, expr.sub);
+	result.top = top.op;
+	clear();
+	return result;
+}
+
+void Builder::clear() {
+	expr.clear();
+	table.clear();
+}
+
+static Handle unary(int func, Handle e) {
+	if (e.ctx == nullptr) {
+		printf("internal:%s:%d: handle without a builder\n", __FILE__, __LINE__);
+		return e;
+	}
+	return e.ctx->push(func, vector<Handle>({e}));
+}
+
+static Handle binary(int func, Handle e0, Handle e1) {
+	if (e0.ctx == nullptr) {
+		printf("internal:%s:%d: handle without a builder\n", __FILE__, __LINE__);
+		return e0;
+	}
+	return e0.ctx->push(func, vector<Handle>({e0, e1}));
+}
+
+Handle operator~(Handle e)  { return unary(Operation::WIRE_NOT,    e); }
+Handle operator-(Handle e)  { return unary(Operation::NEGATION,    e); }
+Handle ident(Handle e)      { return unary(Operation::IDENTITY,    e); }
+Handle isValid(Handle e)    { return unary(Operation::VALIDITY,    e); }
+Handle isTrue(Handle e)     { return unary(Operation::TRUTHINESS,  e); }
+Handle isNegative(Handle e) { return unary(Operation::NEGATIVE,    e); }
+Handle operator!(Handle e)  { return unary(Operation::BOOLEAN_NOT, e); }
+Handle inv(Handle e)        { return unary(Operation::INVERSE,     e); }
+
+Handle operator|(Handle e0, Handle e1)  { return binary(Operation::WIRE_OR,       e0, e1); }
+Handle operator&(Handle e0, Handle e1)  { return binary(Operation::WIRE_AND,      e0, e1); }
+Handle operator^(Handle e0, Handle e1)  { return binary(Operation::WIRE_XOR,      e0, e1); }
+Handle booleanXor(Handle e0, Handle e1) { return binary(Operation::BOOLEAN_XOR,   e0, e1); }
+Handle operator==(Handle e0, Handle e1) { return binary(Operation::EQUAL,         e0, e1); }
+Handle operator!=(Handle e0, Handle e1) { return binary(Operation::NOT_EQUAL,     e0, e1); }
+Handle operator<(Handle e0, Handle e1)  { return binary(Operation::LESS,          e0, e1); }
+Handle operator>(Handle e0, Handle e1)  { return binary(Operation::GREATER,       e0, e1); }
+Handle operator<=(Handle e0, Handle e1) { return binary(Operation::LESS_EQUAL,    e0, e1); }
+Handle operator>=(Handle e0, Handle e1) { return binary(Operation::GREATER_EQUAL, e0, e1); }
+Handle operator<<(Handle e0, Handle e1) { return binary(Operation::SHIFT_LEFT,    e0, e1); }
+Handle operator>>(Handle e0, Handle e1) { return binary(Operation::SHIFT_RIGHT,   e0, e1); }
+Handle operator+(Handle e0, Handle e1)  { return binary(Operation::ADD,           e0, e1); }
+Handle operator-(Handle e0, Handle e1)  { return binary(Operation::SUBTRACT,      e0, e1); }
+Handle operator*(Handle e0, Handle e1)  { return binary(Operation::MULTIPLY,      e0, e1); }
+Handle operator/(Handle e0, Handle e1)  { return binary(Operation::DIVIDE,        e0, e1); }
+Handle operator%(Handle e0, Handle e1)  { return binary(Operation::MOD,           e0, e1); }
+Handle operator&&(Handle e0, Handle e1) { return binary(Operation::BOOLEAN_AND,   e0, e1); }
+Handle operator||(Handle e0, Handle e1) { return binary(Operation::BOOLEAN_OR,    e0, e1); }
+
+}
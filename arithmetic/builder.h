@@ -0,0 +1,89 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include <unordered_map>
+
+#include "expression.h"
+
+namespace arithmetic {
+
+struct Builder;
+
+// A lightweight reference to an operand in a Builder
+struct Handle {
+	Handle();
+	Handle(Builder *ctx, Operand op);
+	~Handle();
+
+	Builder *ctx;
+	Operand op;
+};
+
+// DESIGN(edward.bingham) The operators on Expression copy their left operand
+// and append all of their right operand, so building an n term sum or guard
+// one operator at a time costs O(n^2). A Builder keeps a single expression
+// that everything under construction is added to, and its operators work on
+// Handles into that expression instead, so each one only adds the new
+// operation. Just like Expression::push(), an operation that is identical to
+// one that already exists is reused, but the Builder finds it with a hash
+// table instead of a scan. Since everything is built in one place, this
+// shares more than the Expression operators do, which only reuse operations
+// from their left operand. Expressions copied in with of() are left as they
+// are, so a loop like Parallel::guard() gives exactly the same result.
+struct Builder {
+	Builder();
+	~Builder();
+
+	Expression expr;
+	// from hashOf(Operation) to exprIndex
+	std::unordered_multimap<size_t, size_t> table;
+
+	Handle of(Operand op);
+	Handle of(Value v);
+	// Copy e into the builder
+	Handle of(const Expression &e);
+	Handle varOf(size_t index);
+
+	Handle push(int func, vector<Operand> args);
+	Handle push(int func, vector<Handle> args);
+
+	// Copy the operations reachable from top out into their own expression
+	Expression get(Handle top) const;
+	// Hand the whole expression over with top as its top, leaving the builder
+	// empty. This doesn't copy anything, but it keeps any operations that top
+	// doesn't use.
+	Expression take(Handle top);
+
+	void clear();
+};
+
+Handle operator~(Handle e);
+Handle operator-(Handle e);
+Handle ident(Handle e);
+Handle isValid(Handle e);
+Handle isTrue(Handle e);
+Handle isNegative(Handle e);
+Handle operator!(Handle e);
+Handle inv(Handle e);
+Handle operator|(Handle e0, Handle e1);
+Handle operator&(Handle e0, Handle e1);
+Handle operator^(Handle e0, Handle e1);
+Handle booleanXor(Handle e0, Handle e1);
+Handle operator==(Handle e0, Handle e1);
+Handle operator!=(Handle e0, Handle e1);
+Handle operator<(Handle e0, Handle e1);
+Handle operator>(Handle e0, Handle e1);
+Handle operator<=(Handle e0, Handle e1);
+Handle operator>=(Handle e0, Handle e1);
+Handle operator<<(Handle e0, Handle e1);
+Handle operator>>(Handle e0, Handle e1);
+Handle operator+(Handle e0, Handle e1);
+Handle operator-(Handle e0, Handle e1);
+Handle operator*(Handle e0, Handle e1);
+Handle operator/(Handle e0, Handle e1);
+Handle operator%(Handle e0, Handle e1);
+Handle operator&&(Handle e0, Handle e1);
+Handle operator||(Handle e0, Handle e1);
+
+}
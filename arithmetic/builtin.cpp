@@ -0,0 +1,55 @@
+#include "builtin.h"
+#include "serialize.h"
+
+namespace arithmetic {
+
+const char *Builtin::name(int index) {
+	switch (index) {
+	case CANONICAL: return "canonical";
+	case SIMPLE: return "simple";
+	case HUMAN: return "human";
+	case UNDIRECTED: return "undirected";
+	case DEFAULT: return "default";
+	default: return "undef";
+	}
+}
+
+RuleSet Builtin::build(int index) {
+	switch (index) {
+	case CANONICAL: return rewriteCanonical();
+	case SIMPLE: return rewriteSimple();
+	case HUMAN: return rewriteHuman();
+	case UNDIRECTED: return rewriteUndirected();
+	case DEFAULT: return rewriteCanonical() + rewriteSimple();
+	default:
+		printf("internal:%s:%d: unknown builtin rule set %d\n", __FILE__, __LINE__, index);
+		return RuleSet();
+	}
+}
+
+RuleSet Builtin::load(int index) {
+	RuleSet result;
+	if (index >= 0 and index < COUNT and size[index] > 0
+		and deserialize((const char*)data[index], size[index], result)) {
+		return result;
+	}
+	return build(index);
+}
+
+const RuleSet &Builtin::get(int index) {
+	// One static for each rule set so that only the ones that are used get
+	// decoded, and so that each is initialized exactly once across threads.
+	switch (index) {
+	case CANONICAL: { static const RuleSet rules = load(CANONICAL); return rules; }
+	case SIMPLE: { static const RuleSet rules = load(SIMPLE); return rules; }
+	case HUMAN: { static const RuleSet rules = load(HUMAN); return rules; }
+	case UNDIRECTED: { static const RuleSet rules = load(UNDIRECTED); return rules; }
+	case DEFAULT: { static const RuleSet rules = load(DEFAULT); return rules; }
+	default:
+		printf("internal:%s:%d: unknown builtin rule set %d\n", __FILE__, __LINE__, index);
+		static const RuleSet empty;
+		return empty;
+	}
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include "rewrite.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) Constructing the built in rule sets means building
+// every rule through the expression operators, verifying them, appending
+// them, and tidying the result. Instead, tools/genrules.cpp does that once at
+// build time and embeds the serialized rule sets in the library as static
+// tables. They are decoded the first time they are used. If the tables are
+// empty, as they are in the generator itself, the rule sets are built
+// directly.
+struct Builtin {
+	enum Index {
+		CANONICAL = 0,
+		SIMPLE = 1,
+		HUMAN = 2,
+		UNDIRECTED = 3,
+		// rewriteCanonical() + rewriteSimple(), the default for minimize()
+		DEFAULT = 4,
+		COUNT = 5
+	};
+
+	// defined in the generated source
+	static const unsigned char *const data[COUNT];
+	static const size_t size[COUNT];
+
+	static const char *name(int index);
+	static RuleSet build(int index);
+	static RuleSet load(int index);
+	static const RuleSet &get(int index);
+};
+
+}
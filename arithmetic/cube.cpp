@@ -0,0 +1,633 @@
+#include "cube.h"
+#include "algorithm.h"
+#include "bdd.h"
+
+#include <common/text.h>
+
+namespace arithmetic {
+
+// the low bit of every variable in a word
+static const uint64_t LOW = 0x5555555555555555ull;
+
+// one bit per variable, set where both bits of the variable are set
+static uint64_t full(uint64_t w) {
+	return w & (w>>1) & LOW;
+}
+
+// one bit per variable, set where both bits of the variable are clear
+static uint64_t none(uint64_t w) {
+	return ~w & (~w>>1) & LOW;
+}
+
+Cube::Cube() {
+}
+
+Cube::Cube(int vars) {
+	words.resize((vars+31)/32, ~(uint64_t)0);
+}
+
+Cube::~Cube() {
+}
+
+int Cube::get(int var) const {
+	return (int)((words[var/32] >> (2*(var%32))) & 3u);
+}
+
+void Cube::set(int var, int val) {
+	int shift = 2*(var%32);
+	words[var/32] = (words[var/32] & ~((uint64_t)3 << shift)) | ((uint64_t)(val&3) << shift);
+}
+
+bool Cube::isEmpty() const {
+	for (auto w = words.begin(); w != words.end(); w++) {
+		if (none(*w) != 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Cube::isUniverse() const {
+	for (auto w = words.begin(); w != words.end(); w++) {
+		if (*w != ~(uint64_t)0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int Cube::literals() const {
+	int result = 0;
+	for (auto w = words.begin(); w != words.end(); w++) {
+		result += 32 - __builtin_popcountll(full(*w));
+	}
+	return result;
+}
+
+bool Cube::contains(const Cube &c) const {
+	for (size_t i = 0; i < words.size(); i++) {
+		if ((c.words[i] & ~words[i]) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int Cube::distance(const Cube &c) const {
+	int result = 0;
+	for (size_t i = 0; i < words.size(); i++) {
+		result += __builtin_popcountll(none(words[i] & c.words[i]));
+	}
+	return result;
+}
+
+Cube Cube::cofactor(const Cube &c) const {
+	Cube result(*this);
+	for (size_t i = 0; i < words.size(); i++) {
+		// both bits of every variable c depends on
+		uint64_t lit = ~full(c.words[i]) & LOW;
+		result.words[i] |= lit | (lit<<1);
+	}
+	return result;
+}
+
+Cube &Cube::operator&=(const Cube &c) {
+	for (size_t i = 0; i < words.size(); i++) {
+		words[i] &= c.words[i];
+	}
+	return *this;
+}
+
+Cube &Cube::operator|=(const Cube &c) {
+	for (size_t i = 0; i < words.size(); i++) {
+		words[i] |= c.words[i];
+	}
+	return *this;
+}
+
+bool operator==(const Cube &c0, const Cube &c1) {
+	return c0.words == c1.words;
+}
+
+bool operator!=(const Cube &c0, const Cube &c1) {
+	return c0.words != c1.words;
+}
+
+bool operator<(const Cube &c0, const Cube &c1) {
+	return c0.words < c1.words;
+}
+
+Cube operator&(Cube c0, const Cube &c1) {
+	return c0 &= c1;
+}
+
+Cube operator|(Cube c0, const Cube &c1) {
+	return c0 |= c1;
+}
+
+Cover::Cover() {
+	vars = 0;
+}
+
+Cover::Cover(int vars) {
+	this->vars = vars;
+}
+
+Cover::~Cover() {
+}
+
+bool Cover::isEmpty() const {
+	return cubes.empty();
+}
+
+// Pick the variable that appears in both phases the most often, or -1 if
+// every variable is unate.
+static int binate(const Cover &f) {
+	vector<int> neutral(f.vars, 0);
+	vector<int> valid(f.vars, 0);
+	for (auto c = f.cubes.begin(); c != f.cubes.end(); c++) {
+		for (int v = 0; v < f.vars; v++) {
+			int val = c->get(v);
+			neutral[v] += (val == Cube::NEUTRAL);
+			valid[v] += (val == Cube::VALID);
+		}
+	}
+
+	int result = -1;
+	int best = 0;
+	for (int v = 0; v < f.vars; v++) {
+		if (neutral[v] > 0 and valid[v] > 0 and neutral[v]+valid[v] > best) {
+			result = v;
+			best = neutral[v]+valid[v];
+		}
+	}
+	return result;
+}
+
+// A unate cover is a tautology exactly when it has the universal cube, so
+// only binate variables need to be split on.
+bool Cover::isTautology() const {
+	for (auto c = cubes.begin(); c != cubes.end(); c++) {
+		if (c->isUniverse()) {
+			return true;
+		}
+	}
+
+	int v = binate(*this);
+	if (v < 0) {
+		return false;
+	}
+
+	Cube lit(vars);
+	lit.set(v, Cube::NEUTRAL);
+	if (not cofactor(lit).isTautology()) {
+		return false;
+	}
+	lit.set(v, Cube::VALID);
+	return cofactor(lit).isTautology();
+}
+
+bool Cover::contains(const Cube &c) const {
+	return cofactor(c).isTautology();
+}
+
+int Cover::literals() const {
+	int result = 0;
+	for (auto c = cubes.begin(); c != cubes.end(); c++) {
+		result += c->literals();
+	}
+	return result;
+}
+
+Cover Cover::cofactor(const Cube &c) const {
+	Cover result(vars);
+	for (auto i = cubes.begin(); i != cubes.end(); i++) {
+		if (i->distance(c) == 0) {
+			result.cubes.push_back(i->cofactor(c));
+		}
+	}
+	return result;
+}
+
+// Shannon expansion on the most binate variable. Unate covers are
+// complemented directly with De Morgan's law one cube at a time.
+Cover Cover::complement() const {
+	Cover result(vars);
+	if (cubes.empty()) {
+		result.cubes.push_back(Cube(vars));
+		return result;
+	}
+
+	for (auto c = cubes.begin(); c != cubes.end(); c++) {
+		if (c->isUniverse()) {
+			return result;
+		}
+	}
+
+	if (cubes.size() == 1u) {
+		for (int v = 0; v < vars; v++) {
+			int val = cubes[0].get(v);
+			if (val != Cube::ANY) {
+				Cube c(vars);
+				c.set(v, Cube::ANY & ~val);
+				result.cubes.push_back(c);
+			}
+		}
+		return result;
+	}
+
+	int v = binate(*this);
+	if (v < 0) {
+		// split on any variable that appears
+		for (int u = 0; u < vars and v < 0; u++) {
+			for (auto c = cubes.begin(); c != cubes.end() and v < 0; c++) {
+				if (c->get(u) != Cube::ANY) {
+					v = u;
+				}
+			}
+		}
+	}
+
+	Cube lit0(vars), lit1(vars);
+	lit0.set(v, Cube::NEUTRAL);
+	lit1.set(v, Cube::VALID);
+	vector<Cube> half0 = cofactor(lit0).complement().cubes;
+	vector<Cube> half1 = cofactor(lit1).complement().cubes;
+	std::sort(half0.begin(), half0.end());
+	std::sort(half1.begin(), half1.end());
+
+	// cubes in both halves don't depend on the split variable
+	auto i = half0.begin();
+	auto j = half1.begin();
+	while (i != half0.end() or j != half1.end()) {
+		if (j == half1.end() or (i != half0.end() and *i < *j)) {
+			result.cubes.push_back(*i & lit0);
+			i++;
+		} else if (i == half0.end() or *j < *i) {
+			result.cubes.push_back(*j & lit1);
+			j++;
+		} else {
+			result.cubes.push_back(*i);
+			i++;
+			j++;
+		}
+	}
+	return result;
+}
+
+Cube Cover::supercube() const {
+	if (cubes.empty()) {
+		Cube result(vars);
+		for (int v = 0; v < vars; v++) {
+			result.set(v, Cube::EMPTY);
+		}
+		return result;
+	}
+
+	Cube result = cubes[0];
+	for (auto c = cubes.begin()+1; c != cubes.end(); c++) {
+		result |= *c;
+	}
+	return result;
+}
+
+Cube Cover::complementSupercube() const {
+	Cube result(vars);
+	if (cubes.empty()) {
+		return result;
+	}
+
+	for (auto c = cubes.begin(); c != cubes.end(); c++) {
+		if (c->isUniverse()) {
+			for (int v = 0; v < vars; v++) {
+				result.set(v, Cube::EMPTY);
+			}
+			return result;
+		}
+	}
+
+	int v = binate(*this);
+	if (v < 0) {
+		// The complement of a unate cover includes the point where every
+		// variable takes the phase it doesn't have in the cover, and flipping
+		// any one variable of that point stays in the complement unless a
+		// cube is just that literal.
+		for (auto c = cubes.begin(); c != cubes.end(); c++) {
+			if (c->literals() == 1) {
+				for (int u = 0; u < vars; u++) {
+					int val = c->get(u);
+					if (val != Cube::ANY) {
+						result.set(u, result.get(u) & ~val);
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	Cube lit0(vars), lit1(vars);
+	lit0.set(v, Cube::NEUTRAL);
+	lit1.set(v, Cube::VALID);
+	Cube half0 = cofactor(lit0).complementSupercube();
+	Cube half1 = cofactor(lit1).complementSupercube();
+	if (half0.isEmpty()) {
+		return half1 & lit1;
+	} else if (half1.isEmpty()) {
+		return half0 & lit0;
+	}
+	return (half0 & lit0) | (half1 & lit1);
+}
+
+void Cover::push_back(const Cube &c) {
+	if (not c.isEmpty()) {
+		cubes.push_back(c);
+	}
+}
+
+Cover &Cover::operator|=(const Cover &c) {
+	cubes.insert(cubes.end(), c.cubes.begin(), c.cubes.end());
+	return *this;
+}
+
+Cover &Cover::operator&=(const Cover &c) {
+	vector<Cube> result;
+	for (auto i = cubes.begin(); i != cubes.end(); i++) {
+		for (auto j = c.cubes.begin(); j != c.cubes.end(); j++) {
+			Cube k = *i & *j;
+			if (not k.isEmpty()) {
+				result.push_back(k);
+			}
+		}
+	}
+	cubes = result;
+	return *this;
+}
+
+Cover operator|(Cover c0, const Cover &c1) {
+	return c0 |= c1;
+}
+
+Cover operator&(Cover c0, const Cover &c1) {
+	return c0 &= c1;
+}
+
+Cube cubeOf(const State &s) {
+	Cube result((int)s.values.size());
+	for (int v = 0; v < (int)s.values.size(); v++) {
+		if (not s.values[v].isUndef()) {
+			result.set(v, (int)s.values[v].state);
+		}
+	}
+	return result;
+}
+
+State stateOf(const Cube &c, int vars) {
+	State result;
+	result.values.reserve(vars);
+	for (int v = 0; v < vars; v++) {
+		switch (c.get(v)) {
+		case Cube::EMPTY: result.values.push_back(Value::X()); break;
+		case Cube::NEUTRAL: result.values.push_back(Value::gnd()); break;
+		case Cube::VALID: result.values.push_back(Value::vdd()); break;
+		default: result.values.push_back(Value::U());
+		}
+	}
+	return result;
+}
+
+// Unstable states are kept as they are even though the cover operations
+// treat them as empty.
+Cover coverOf(const Region &r) {
+	Cover result(0);
+	for (auto s = r.states.begin(); s != r.states.end(); s++) {
+		result.vars = max(result.vars, (int)s->values.size());
+	}
+
+	result.cubes.reserve(r.states.size());
+	for (auto s = r.states.begin(); s != r.states.end(); s++) {
+		result.cubes.push_back(cubeOf(*s));
+		result.cubes.back().words.resize((result.vars+31)/32, ~(uint64_t)0);
+	}
+	return result;
+}
+
+Region regionOf(const Cover &c) {
+	Region result;
+	result.states.reserve(c.cubes.size());
+	for (auto i = c.cubes.begin(); i != c.cubes.end(); i++) {
+		result.states.push_back(stateOf(*i, c.vars));
+	}
+	return result;
+}
+
+static Cover coverOf(ConstOperationSet ops, Operand op, int vars, const map<size_t, int> &atoms, map<size_t, Cover> &cache) {
+	Cover result(vars);
+	if (op.isVar() and (int)op.index < vars) {
+		Cube lit(vars);
+		lit.set((int)op.index, Cube::VALID);
+		result.cubes.push_back(lit);
+		return result;
+	} else if (op.isConst()) {
+		Value v = op.cnst;
+		if (v.isUnknown() or v.isUnstable()) {
+			printf("error: '%s' is not a guard\n", ::to_string(v).c_str());
+		} else if (not v.isNeutral() and not (v.type == Value::BOOL and not v.bval)) {
+			result.cubes.push_back(Cube(vars));
+		}
+		return result;
+	} else if (not op.isExpr()) {
+		printf("internal:%s:%d: operand outside of the cover\n", __FILE__, __LINE__);
+		return result;
+	}
+
+	auto atom = atoms.find(op.index);
+	if (atom != atoms.end()) {
+		Cube lit(vars);
+		lit.set(atom->second, Cube::VALID);
+		result.cubes.push_back(lit);
+		return result;
+	}
+
+	auto pos = cache.find(op.index);
+	if (pos != cache.end()) {
+		return pos->second;
+	}
+
+	const Operation *expr = ops.getExpr(op.index);
+	vector<Cover> args;
+	args.reserve(expr->operands.size());
+	for (auto i = expr->operands.begin(); i != expr->operands.end(); i++) {
+		args.push_back(coverOf(ops, *i, vars, atoms, cache));
+	}
+
+	switch (expr->func) {
+	case Operation::IDENTITY:
+	case Operation::VALIDITY:
+	case Operation::TRUTHINESS:
+		result = args[0];
+		break;
+	case Operation::WIRE_NOT:
+	case Operation::BOOLEAN_NOT:
+		result = args[0].complement();
+		break;
+	case Operation::WIRE_AND:
+	case Operation::BOOLEAN_AND:
+		result.cubes.push_back(Cube(vars));
+		for (auto i = args.begin(); i != args.end(); i++) {
+			result &= *i;
+		}
+		break;
+	case Operation::WIRE_OR:
+	case Operation::BOOLEAN_OR:
+		for (auto i = args.begin(); i != args.end(); i++) {
+			result |= *i;
+		}
+		break;
+	case Operation::WIRE_XOR:
+	case Operation::BOOLEAN_XOR:
+		for (auto i = args.begin(); i != args.end(); i++) {
+			result = (result & i->complement()) | (result.complement() & *i);
+		}
+		break;
+	case Operation::TERNARY:
+		if (args.size() == 3u) {
+			result = (args[0] & args[1]) | (args[0].complement() & args[2]);
+			break;
+		}
+		// fall through
+	default: {
+		// only operations on constants are left
+		Value v = evaluate(ops, op, State()).val;
+		result = coverOf(ops, Operand(v), vars, atoms, cache);
+	}
+	}
+
+	// drop cubes that are inside another so the intermediate covers stay
+	// small
+	for (int i = (int)result.cubes.size()-1; i >= 0; i--) {
+		for (int j = 0; j < (int)result.cubes.size(); j++) {
+			if (j != i and result.cubes[j].contains(result.cubes[i])
+				and (result.cubes[j] != result.cubes[i] or j < i)) {
+				result.cubes.erase(result.cubes.begin()+i);
+				break;
+			}
+		}
+	}
+
+	cache.insert({op.index, result});
+	return result;
+}
+
+Cover coverOf(ConstOperationSet ops, Operand top, int vars, const map<size_t, int> &atoms) {
+	map<size_t, Cover> cache;
+	return coverOf(ops, top, vars, atoms, cache);
+}
+
+// The operations that coverOf() builds from its operands rather than
+// treating as an atom
+static bool isLogic(int func) {
+	return func == Operation::VALIDITY
+		or func == Operation::TRUTHINESS
+		or func == Operation::WIRE_NOT
+		or func == Operation::WIRE_AND
+		or func == Operation::WIRE_OR
+		or func == Operation::WIRE_XOR
+		or func == Operation::BOOLEAN_NOT
+		or func == Operation::BOOLEAN_AND
+		or func == Operation::BOOLEAN_OR
+		or func == Operation::BOOLEAN_XOR;
+}
+
+Cover coverOf(const Expression &e, vector<Operand> &leaves) {
+	GuardEncoder enc;
+	enc.encode(e, e.top);
+
+	// Variables keep their index as cube variables and the opaque
+	// operations the encoder found are numbered after them.
+	leaves.clear();
+	for (auto i = enc.leaves.begin(); i != enc.leaves.end(); i++) {
+		if (i->isVar() and (int)i->index >= (int)leaves.size()) {
+			leaves.resize(i->index+1);
+		}
+	}
+	for (int v = 0; v < (int)leaves.size(); v++) {
+		leaves[v] = Operand::varOf(v);
+	}
+
+	map<uint32_t, int> numbered;
+	for (int v = 0; v < (int)enc.leaves.size(); v++) {
+		if (not enc.leaves[v].isVar()) {
+			numbered.insert({(uint32_t)v, (int)leaves.size()});
+			leaves.push_back(enc.leaves[v]);
+		}
+	}
+
+	map<size_t, int> atoms;
+	for (ConstUpIterator i(e, {e.top}); not i.done(); ++i) {
+		if (isLogic(i->func)) {
+			continue;
+		}
+		auto pos = enc.atoms.find(to_string(e, i->op(), false));
+		if (pos != enc.atoms.end()) {
+			atoms.insert({i->exprIndex, numbered[pos->second]});
+		}
+	}
+
+	return coverOf(e, e.top, (int)leaves.size(), atoms);
+}
+
+Cover coverOf(const Expression &e) {
+	vector<Operand> leaves;
+	return coverOf(e, leaves);
+}
+
+Expression exprOf(const Cover &c, bool boolean) {
+	vector<Operand> leaves;
+	leaves.reserve(c.vars);
+	for (int v = 0; v < c.vars; v++) {
+		leaves.push_back(Operand::varOf(v));
+	}
+	return exprOf(c, Expression(), leaves, boolean);
+}
+
+Expression exprOf(const Cover &c, Expression base, const vector<Operand> &leaves, bool boolean) {
+	if (c.isEmpty()) {
+		return boolean ? Expression::boolOf(false) : Expression::gnd();
+	}
+	for (auto i = c.cubes.begin(); i != c.cubes.end(); i++) {
+		if (i->isUniverse()) {
+			return boolean ? Expression::boolOf(true) : Expression::vdd();
+		}
+	}
+
+	int opNot = boolean ? Operation::BOOLEAN_NOT : Operation::WIRE_NOT;
+	int opAnd = boolean ? Operation::BOOLEAN_AND : Operation::WIRE_AND;
+	int opOr = boolean ? Operation::BOOLEAN_OR : Operation::WIRE_OR;
+
+	// The leaves may reference operations in base, so the sum of products is
+	// built on top of it and tidy() removes what isn't used.
+	vector<Operand> terms;
+	for (auto i = c.cubes.begin(); i != c.cubes.end(); i++) {
+		vector<Operand> lits;
+		for (int v = 0; v < c.vars; v++) {
+			int val = i->get(v);
+			if (val == Cube::VALID) {
+				lits.push_back(leaves[v]);
+			} else if (val == Cube::NEUTRAL) {
+				lits.push_back(base.pushExpr(Operation(opNot, {leaves[v]})));
+			}
+		}
+
+		if (lits.size() == 1u) {
+			terms.push_back(lits[0]);
+		} else {
+			terms.push_back(base.pushExpr(Operation(opAnd, lits)));
+		}
+	}
+
+	base.top = terms.size() == 1u ? terms[0] : base.pushExpr(Operation(opOr, terms));
+	base.tidy();
+	return base;
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include "expression.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) Cubes use positional cube notation. Each variable
+// gets two bits, packed 32 variables to a 64-bit word. The low bit is set if
+// the variable may be neutral and the high bit if it may be valid. So 01 is
+// ~x, 10 is x, 11 means the cube doesn't depend on x, and 00 means the cube
+// is empty. Unused bits in the last word are always 11 so they never affect
+// a comparison. Every set operation is a handful of bitwise operations per
+// word.
+//
+// These are the same codes as Value::StateType, and the subset lattice of
+// values in Value::isSubsetOf() is exactly the subset relation on the two
+// bits. So a State of wires is a Cube where 00 is an unstable variable,
+// and intersection, containment, and union of states are the same
+// operations on cubes.
+struct Cube {
+	Cube();
+	// the cube containing everything
+	Cube(int vars);
+	~Cube();
+
+	enum {
+		EMPTY = 0,
+		NEUTRAL = 1,
+		VALID = 2,
+		ANY = 3,
+	};
+
+	vector<uint64_t> words;
+
+	int get(int var) const;
+	void set(int var, int val);
+
+	bool isEmpty() const;
+	bool isUniverse() const;
+	// the number of variables this cube depends on
+	int literals() const;
+
+	bool contains(const Cube &c) const;
+	// the number of variables for which the two cubes have no value in
+	// common, 0 if they intersect
+	int distance(const Cube &c) const;
+	// this cube with every variable that c depends on removed, assuming the
+	// two intersect
+	Cube cofactor(const Cube &c) const;
+
+	Cube &operator&=(const Cube &c);
+	Cube &operator|=(const Cube &c);
+};
+
+bool operator==(const Cube &c0, const Cube &c1);
+bool operator!=(const Cube &c0, const Cube &c1);
+bool operator<(const Cube &c0, const Cube &c1);
+
+// intersection and supercube
+Cube operator&(Cube c0, const Cube &c1);
+Cube operator|(Cube c0, const Cube &c1);
+
+// A sum of cubes
+struct Cover {
+	Cover();
+	Cover(int vars);
+	~Cover();
+
+	int vars;
+	vector<Cube> cubes;
+
+	bool isEmpty() const;
+	bool isTautology() const;
+	// whether every point in c is in this cover
+	bool contains(const Cube &c) const;
+	int literals() const;
+
+	Cover cofactor(const Cube &c) const;
+	Cover complement() const;
+	Cube supercube() const;
+	// the same as complement().supercube() without building the complement
+	Cube complementSupercube() const;
+
+	void push_back(const Cube &c);
+	Cover &operator|=(const Cover &c);
+	Cover &operator&=(const Cover &c);
+};
+
+Cover operator|(Cover c0, const Cover &c1);
+Cover operator&(Cover c0, const Cover &c1);
+
+// Conversions between cubes and states. Variable i of the cube is
+// variable i of the state. Only the state of each value is kept, so a
+// valid integer becomes a valid wire.
+Cube cubeOf(const State &s);
+State stateOf(const Cube &c, int vars);
+Cover coverOf(const Region &r);
+Region regionOf(const Cover &c);
+
+// Build the cover for the wire and boolean logic in top. Variable i of the
+// expression is cube variable i. Any other operation must be listed in
+// atoms, which maps its expression index to a cube variable.
+Cover coverOf(ConstOperationSet ops, Operand top, int vars, const map<size_t, int> &atoms=map<size_t, int>());
+// Build the cover for a whole guard. Variables keep their index and every
+// other operation on variables, like a comparison, is numbered after them.
+// leaves is set to the operand for each cube variable.
+Cover coverOf(const Expression &e, vector<Operand> &leaves);
+Cover coverOf(const Expression &e);
+
+// Build the sum of products for c on top of the operations in base. Cube
+// variable i is leaves[i], or variable i if there are no leaves.
+Expression exprOf(const Cover &c, bool boolean=false);
+Expression exprOf(const Cover &c, Expression base, const vector<Operand> &leaves, bool boolean=false);
+
+}
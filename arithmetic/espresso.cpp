@@ -0,0 +1,121 @@
+#include "espresso.h"
+#include "bdd.h"
+#include "algorithm.h"
+
+namespace arithmetic {
+
+Cover expand(const Cover &f, const Cover &r) {
+	// expand the largest cubes first so they cover the most
+	vector<Cube> order = f.cubes;
+	std::stable_sort(order.begin(), order.end(), [](const Cube &c0, const Cube &c1) {
+		return c0.literals() < c1.literals();
+	});
+
+	Cover result(f.vars);
+	for (auto c = order.begin(); c != order.end(); c++) {
+		bool covered = false;
+		for (auto e = result.cubes.begin(); e != result.cubes.end() and not covered; e++) {
+			covered = e->contains(*c);
+		}
+		if (covered) {
+			continue;
+		}
+
+		Cube cube = *c;
+		for (int v = 0; v < f.vars; v++) {
+			int val = cube.get(v);
+			if (val == Cube::ANY) {
+				continue;
+			}
+
+			cube.set(v, Cube::ANY);
+			for (auto o = r.cubes.begin(); o != r.cubes.end(); o++) {
+				if (cube.distance(*o) == 0) {
+					cube.set(v, val);
+					break;
+				}
+			}
+		}
+		result.cubes.push_back(cube);
+	}
+	return result;
+}
+
+Cover irredundant(Cover f, const Cover &d) {
+	for (int i = (int)f.cubes.size()-1; i >= 0; i--) {
+		Cover rest(f.vars);
+		rest.cubes.reserve(f.cubes.size()+d.cubes.size());
+		for (int j = 0; j < (int)f.cubes.size(); j++) {
+			if (j != i) {
+				rest.cubes.push_back(f.cubes[j]);
+			}
+		}
+		rest |= d;
+
+		if (rest.contains(f.cubes[i])) {
+			f.cubes.erase(f.cubes.begin()+i);
+		}
+	}
+	return f;
+}
+
+Cover reduce(Cover f, const Cover &d) {
+	for (int i = (int)f.cubes.size()-1; i >= 0; i--) {
+		Cover rest(f.vars);
+		for (int j = 0; j < (int)f.cubes.size(); j++) {
+			if (j != i) {
+				rest.cubes.push_back(f.cubes[j]);
+			}
+		}
+		rest |= d;
+
+		// the part of this cube nothing else covers
+		Cube only = f.cubes[i] & rest.cofactor(f.cubes[i]).complementSupercube();
+		if (only.isEmpty()) {
+			f.cubes.erase(f.cubes.begin()+i);
+		} else {
+			f.cubes[i] = only;
+		}
+	}
+	return f;
+}
+
+Cover espresso(Cover f, Cover d) {
+	if (f.isEmpty()) {
+		return f;
+	}
+	d.vars = f.vars;
+
+	Cover r = (f | d).complement();
+	f = irredundant(expand(f, r), d);
+
+	while (true) {
+		Cover next = irredundant(expand(reduce(f, d), r), d);
+		if (next.cubes.size() > f.cubes.size()
+			or (next.cubes.size() == f.cubes.size() and next.literals() >= f.literals())) {
+			break;
+		}
+		f = next;
+	}
+	return f;
+}
+
+Expression espresso(const Expression &e) {
+	GuardEncoder enc;
+	GuardEncoder::Rails rails = enc.encode(e, e.top);
+	if (rails.unstable != Bdd::ZERO) {
+		return e;
+	}
+
+	vector<Operand> leaves;
+	Cover f = espresso(coverOf(e, leaves));
+
+	const Operation *root = e.top.isExpr() ? e.getExpr(e.top.index) : nullptr;
+	bool boolean = root != nullptr and (root->func == Operation::BOOLEAN_AND
+		or root->func == Operation::BOOLEAN_OR
+		or root->func == Operation::BOOLEAN_NOT
+		or root->func == Operation::BOOLEAN_XOR);
+	return exprOf(f, e, leaves, boolean);
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include "cube.h"
+#include "expression.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) This is the heuristic loop from Espresso-II. The
+// off-set is computed once up front. Then expand makes each cube as large as
+// it can be without touching the off-set, irredundant drops cubes covered by
+// the rest, and reduce shrinks each cube back down to what only it covers so
+// the next expand can move it somewhere better. The loop stops once a pass
+// doesn't lower the number of cubes or literals.
+Cover expand(const Cover &f, const Cover &r);
+Cover irredundant(Cover f, const Cover &d);
+Cover reduce(Cover f, const Cover &d);
+
+// Minimize the on-set f given the don't-care set d
+Cover espresso(Cover f, Cover d=Cover());
+
+// Minimize the wire and boolean logic in e into a sum of products. The
+// variables of the cover are the variables of e and any other operations,
+// like comparisons, that the logic is over. e is returned unchanged if it
+// can be unstable.
+Expression espresso(const Expression &e);
+
+}
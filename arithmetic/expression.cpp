@@ -8,6 +8,8 @@
 #include "state.h"
 #include "rewrite.h"
 #include "algorithm.h"
+#include "trace.h"
+#include "bdd.h"
 
 
 namespace arithmetic {
@@ -112,8 +114,8 @@ vector<Operand> Expression::exprIndex() const {
 	return sub.exprIndex();
 }
 
-const Operation *Expression::getExpr(size_t index) const {
-	return sub.getExpr(index);
+Operation *Expression::refExpr(size_t index) {
+	return sub.refExpr(index);
 }
 
 bool Expression::setExpr(Operation o) {
@@ -168,75 +170,25 @@ bool Expression::isUndef() const {
 }
 
 bool Expression::isNull() const {
-	// TODO(edward.bingham) This is wrong. I should do constant propagation here
-	// then check if the top Expression is null after constant propagation using quantified element elimination
-	// TODO(edward.bingham) implement quantified element elimination using cylindrical algebraic decomposition.
-	if (top.isVar() or top.isType() or (top.isConst() and not top.cnst.isUnstable())) {
-		return false;
-	}
-	vector<Operand> idx = exprIndex();
-	for (auto i = idx.begin(); i != idx.end(); i++) {
-		for (auto j = getExpr(i->index)->operands.begin(); j != getExpr(i->index)->operands.end(); j++) {
-			if (j->isVar() or j->isType() or (j->isConst() and not j->cnst.isUnstable())) {
-				return false;
-			}
-		}
-	}
-	return true;
+	GuardEncoder enc;
+	return enc.encode(*this, top).unstable == Bdd::ONE;
 }
 
 bool Expression::isConstant() const {
-	// TODO(edward.bingham) This is wrong. I should do constant propagation here
-	// then check if the top Expression is constant after constant propagation using quantified element elimination
-	// TODO(edward.bingham) implement quantified element elimination using cylindrical algebraic decomposition.
-	if (top.isVar() or top.isType() or (top.isConst() and top.cnst.isUnstable())) {
-		return false;
-	}
-	vector<Operand> idx = exprIndex();
-	for (auto i = idx.begin(); i != idx.end(); i++) {
-		for (auto j = getExpr(i->index)->operands.begin(); j != getExpr(i->index)->operands.end(); j++) {
-			if (j->isVar() or (j->isConst() and j->cnst.isUnstable())) {
-				return false;
-			}
-		}
-	}
-	return true;
+	GuardEncoder enc;
+	GuardEncoder::Rails r = enc.encode(*this, top);
+	return r.unstable == Bdd::ZERO and enc.bdd.isConstant(r.valid);
 }
 
 bool Expression::isValid() const {
-	// TODO(edward.bingham) This is wrong. I should do constant propagation here
-	// then check if the top Expression is constant after constant propagation using quantified element elimination
-	// TODO(edward.bingham) implement quantified element elimination using cylindrical algebraic decomposition.
-	if (top.isVar() or (top.isConst() and (top.cnst.isUnstable() or top.cnst.isNeutral()))) {
-		return false;
-	}
-	vector<Operand> idx = exprIndex();
-	for (auto i = idx.begin(); i != idx.end(); i++) {
-		for (auto j = getExpr(i->index)->operands.begin(); j != getExpr(i->index)->operands.end(); j++) {
-			if (j->isVar() or (j->isConst() and (j->cnst.isUnstable() or j->cnst.isNeutral()))) {
-				return false;
-			}
-		}
-	}
-	return true;
+	GuardEncoder enc;
+	return enc.encode(*this, top).valid == Bdd::ONE;
 }
 
 bool Expression::isNeutral() const {
-	// TODO(edward.bingham) This is wrong. I should do constant propagation here
-	// then check if the top Expression is null after constant propagation using quantified element elimination
-	// TODO(edward.bingham) implement quantified element elimination using cylindrical algebraic decomposition.
-	if (top.isVar() or (top.isConst() and (top.cnst.isUnstable() or top.cnst.isValid()))) {
-		return false;
-	}
-	vector<Operand> idx = exprIndex();
-	for (auto i = idx.begin(); i != idx.end(); i++) {
-		for (auto j = getExpr(i->index)->operands.begin(); j != getExpr(i->index)->operands.end(); j++) {
-			if (j->isVar() or (j->isConst() and (j->cnst.isUnstable() or j->cnst.isValid()))) {
-				return false;
-			}
-		}
-	}
-	return true;
+	GuardEncoder enc;
+	GuardEncoder::Rails r = enc.encode(*this, top);
+	return r.valid == Bdd::ZERO and r.unstable == Bdd::ZERO;
 }
 
 bool Expression::isWire() const {
@@ -335,12 +287,16 @@ bool areSame(Expression e0, Expression e1) {
 	return i.done() and j.done();
 }
 
+void Expression::print(ostream &os, bool share) const {
+	arithmetic::print(os, *this, this->top, share);
+}
+
 string Expression::to_string(bool debug) const {
 	return arithmetic::to_string(*this, this->top, debug);
 }
 
 ostream &operator<<(ostream &os, Expression e) {
-	os << e.to_string();
+	e.print(os);
 	return os;
 }
 
@@ -419,6 +375,8 @@ Expression wireXor(Expression e0) { return e0.push(Operation::WIRE_XOR, {e0.top}
 Expression add(Expression e0)        { return e0.push(Operation::ADD,         {e0.top}); }
 Expression mult(Expression e0)       { return e0.push(Operation::MULTIPLY,    {e0.top}); }
 
+Expression each(Expression v, Expression e0) { Expression e; return e.push(Operation::EACH, e.append({v, e0})); }
+
 Expression array(vector<Expression> e0)      { Expression e; return e.push(Operation::ARRAY,       e.append(e0)); }
 Expression booleanOr(vector<Expression> e0)  { Expression e; return e.push(Operation::BOOLEAN_OR,  e.append(e0)); }
 Expression booleanAnd(vector<Expression> e0) { Expression e; return e.push(Operation::BOOLEAN_AND, e.append(e0)); }
@@ -448,6 +406,8 @@ Expression construct(string funcName, vector<Expression> args) {
 }
 
 int passesGuard(const State &encoding, const State &global, const Expression &guard, State *total) {
+	TraceScope trace("passesGuard");
+
 	vector<ValRef> expressions;
 	vector<ValRef> gexpressions;
 
@@ -509,20 +469,93 @@ int passesGuard(const State &encoding, const State &global, const Expression &gu
 	return 1;
 }
 
+bool areMutex(const Expression &g0, const Expression &g1) {
+	GuardEncoder enc;
+	GuardEncoder::Rails r0 = enc.encode(g0, g0.top);
+	GuardEncoder::Rails r1 = enc.encode(g1, g1.top);
+	return enc.bdd.andOf(r0.valid, r1.valid) == Bdd::ZERO;
+}
+
+bool implies(const Expression &g0, const Expression &g1) {
+	GuardEncoder enc;
+	GuardEncoder::Rails r0 = enc.encode(g0, g0.top);
+	GuardEncoder::Rails r1 = enc.encode(g1, g1.top);
+	return enc.bdd.andOf(r0.valid, enc.bdd.notOf(r1.valid)) == Bdd::ZERO;
+}
+
+// Remove terms from the conjunction in guard for as long as it stays
+// mutually exclusive with exclude.
 Expression weakestGuard(const Expression &guard, const Expression &exclude) {
-	// TODO(edward.bingham) Remove terms from the guard until guard overlaps exclude (using cylidrical algebraic decomposition)
-	// 1. put the guard in conjunctive normal form using the boolean operations & | ~
-	// 2. for each term in the conjunctive normal form, pick a comparison and eliminate it, then check overlap. 
-	return guard;
+	GuardEncoder enc;
+	GuardEncoder::Rails ex = enc.encode(exclude, exclude.top);
+	if (enc.bdd.andOf(enc.encode(guard, guard.top).valid, ex.valid) != Bdd::ZERO) {
+		return guard;
+	}
+
+	// flatten the conjunction
+	const Operation *root = guard.top.isExpr() ? guard.getExpr(guard.top.index) : nullptr;
+	bool boolean = root != nullptr and root->func == Operation::BOOLEAN_AND;
+	vector<Operand> terms;
+	vector<Operand> stack({guard.top});
+	while (not stack.empty()) {
+		Operand curr = stack.back();
+		stack.pop_back();
+		const Operation *op = curr.isExpr() ? guard.getExpr(curr.index) : nullptr;
+		if (op != nullptr and (op->func == Operation::WIRE_AND or op->func == Operation::BOOLEAN_AND)) {
+			stack.insert(stack.end(), op->operands.rbegin(), op->operands.rend());
+		} else {
+			terms.push_back(curr);
+		}
+	}
+
+	vector<GuardEncoder::Rails> rails;
+	for (auto i = terms.begin(); i != terms.end(); i++) {
+		rails.push_back(enc.encode(guard, *i));
+	}
+
+	vector<bool> keep(terms.size(), true);
+	for (int i = (int)terms.size()-1; i >= 0; i--) {
+		keep[i] = false;
+		Bdd::Node rest = ex.valid;
+		for (size_t j = 0; j < terms.size() and rest != Bdd::ZERO; j++) {
+			if (keep[j]) {
+				rest = enc.bdd.andOf(rest, rails[j].valid);
+			}
+		}
+		keep[i] = (rest != Bdd::ZERO);
+	}
+
+	Expression result = Expression::vdd();
+	bool first = true;
+	for (size_t i = 0; i < terms.size(); i++) {
+		if (keep[i]) {
+			Expression term(guard);
+			term.top = terms[i];
+			if (first) {
+				result = term;
+			} else {
+				result = boolean ? (result && term) : (result & term);
+			}
+			first = false;
+		}
+	}
+	result.tidy();
+	return result;
+}
+
+void Expression::minimize(RuleSet rules, RewriteStats *stats) {
+	this->top = arithmetic::minimize(*this, {this->top}, rules, stats).map(this->top);
 }
 
-void Expression::minimize(RuleSet rules) {
-	this->top = arithmetic::minimize(*this, {this->top}, rules).map(this->top);
+int Expression::minimize(const RuleSet &rules, const MinimizeOptions &options) {
+	MinimizeResult result = arithmetic::minimize(*this, {this->top}, rules, options);
+	this->top = result.mapping.map(this->top);
+	return result.status;
 }
 
-Expression Expression::minimized(RuleSet rules) {
+Expression Expression::minimized(RuleSet rules, RewriteStats *stats) {
 	Expression duplicate(*this);
-	duplicate.top = arithmetic::minimize(duplicate, {duplicate.top}, rules).map(duplicate.top);
+	duplicate.top = arithmetic::minimize(duplicate, {duplicate.top}, rules, stats).map(duplicate.top);
 	return duplicate;
 }
 
@@ -7,6 +7,7 @@
 
 #include "operation_set.h"
 #include "rewrite.h"
+#include "stats.h"
 
 namespace arithmetic {
 
@@ -15,6 +16,8 @@ namespace arithmetic {
 // 1. operations[0]*3
 // 2. x*y
 // 3. operations[1]+operations[2]
+struct MinimizeOptions;
+
 struct Expression {
 	Expression(Operand top = Operand::undef());
 	Expression(int func, vector<Operand> args);
@@ -39,15 +42,20 @@ struct Expression {
 	static Expression typeOf(Operand::Type type);
 
 	vector<Operand> exprIndex() const;
-	const Operation *getExpr(size_t index) const;
+	const Operation *getExpr(size_t index) const {
+		return sub.getExpr(index);
+	}
+	Operation *refExpr(size_t index);
 	bool setExpr(Operation o);
 	Operand pushExpr(Operation o);
 	bool eraseExpr(size_t index);
 
 	void clear();
 	void tidy();
-	void minimize(RuleSet rules=RuleSet());
-	Expression minimized(RuleSet rules=RuleSet());
+	void minimize(RuleSet rules=RuleSet(), RewriteStats *stats=nullptr);
+	// returns the MinimizeResult::Status
+	int minimize(const RuleSet &rules, const MinimizeOptions &options);
+	Expression minimized(RuleSet rules=RuleSet(), RewriteStats *stats=nullptr);
 	size_t size() const;
 
 	Operand append(Expression arg);
@@ -65,6 +73,7 @@ struct Expression {
 	Expression &applyVars(const Mapping<int> &m);
 	Expression &apply(const Mapping<Operand> &m);
 
+	void print(ostream &os, bool share=false) const;
 	string to_string(bool debug=false) const;
 
 	Expression operator()(Expression idx) const;
@@ -157,6 +166,12 @@ Expression wireXor(Expression e0);
 Expression add(Expression e0);
 Expression mult(Expression e0);
 
+// Used to create comprehensions in rewrite rules. In a match, each(v, f(v))
+// as the only operand of a commutative operator selects every operand that
+// matches f(v) and binds v to the list of their elements. In a replacement,
+// it copies f(v) once for every operand bound to v.
+Expression each(Expression v, Expression e0);
+
 Expression array(vector<Expression> e);
 Expression booleanOr(vector<Expression> e0);
 Expression booleanAnd(vector<Expression> e0);
@@ -172,6 +187,12 @@ Expression cast(string typeName, Expression e0);
 Expression construct(string typeName, vector<Expression> args);
 
 int passesGuard(const State &encoding, const State &global, const Expression &guard, State *total);
+
+// Decided exactly for guards over wires and booleans, see GuardEncoder
+bool areMutex(const Expression &g0, const Expression &g1);
+bool implies(const Expression &g0, const Expression &g1);
+// Drop terms from the conjunction in guard for as long as it stays mutually
+// exclusive with exclude
 Expression weakestGuard(const Expression &guard, const Expression &exclude);
 
 }
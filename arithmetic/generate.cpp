@@ -0,0 +1,246 @@
+#include "generate.h"
+
+namespace arithmetic {
+
+Generator::Generator(uint64_t seed) {
+	// xorshift has a fixed point at zero
+	rng = seed == 0 ? 0x9E3779B97F4A7C15ull : seed;
+	size = 64;
+	depth = 0;
+	sharing = 0.2;
+	vars = 8;
+	constants = 0.1;
+	useArithmetic();
+}
+
+Generator::~Generator() {
+}
+
+map<int, double> Generator::arithmeticMix() {
+	return {
+		{Operation::ADD, 4.0},
+		{Operation::SUBTRACT, 2.0},
+		{Operation::MULTIPLY, 2.0},
+		{Operation::NEGATION, 1.0},
+	};
+}
+
+map<int, double> Generator::wireMix() {
+	return {
+		{Operation::WIRE_AND, 3.0},
+		{Operation::WIRE_OR, 3.0},
+		{Operation::WIRE_NOT, 2.0},
+	};
+}
+
+map<int, double> Generator::booleanMix() {
+	return {
+		{Operation::BOOLEAN_AND, 3.0},
+		{Operation::BOOLEAN_OR, 3.0},
+		{Operation::BOOLEAN_NOT, 2.0},
+	};
+}
+
+void Generator::useArithmetic() {
+	mix = arithmeticMix();
+	type = Value::INT;
+}
+
+void Generator::useWires() {
+	mix = wireMix();
+	type = Value::WIRE;
+}
+
+void Generator::useBooleans() {
+	mix = booleanMix();
+	type = Value::BOOL;
+}
+
+uint64_t Generator::next() {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+size_t Generator::uniform(size_t n) {
+	return n == 0 ? 0 : (size_t)(next() % (uint64_t)n);
+}
+
+double Generator::real() {
+	return (double)(next() >> 11) * (1.0/9007199254740992.0);
+}
+
+static size_t arity(int func) {
+	switch (func) {
+	case Operation::VALIDITY:
+	case Operation::WIRE_NOT:
+	case Operation::TRUTHINESS:
+	case Operation::BOOLEAN_NOT:
+	case Operation::NEGATIVE:
+	case Operation::IDENTITY:
+	case Operation::NEGATION:
+	case Operation::INVERSE:
+		return 1;
+	case Operation::TERNARY:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+int Generator::function() {
+	double total = 0.0;
+	for (auto i = mix.begin(); i != mix.end(); i++) {
+		total += i->second;
+	}
+
+	double r = real()*total;
+	for (auto i = mix.begin(); i != mix.end(); i++) {
+		if (r < i->second) {
+			return i->first;
+		}
+		r -= i->second;
+	}
+	return mix.empty() ? Operation::ADD : mix.rbegin()->first;
+}
+
+Value Generator::value() {
+	switch (type) {
+	case Value::BOOL:
+		return Value::boolOf(next()&1);
+	case Value::INT:
+		return Value::intOf((int64_t)uniform(201) - 100);
+	case Value::REAL:
+		return Value::realOf(real()*200.0 - 100.0);
+	default:
+		return (next()&1) ? Value::vdd() : Value::gnd();
+	}
+}
+
+Operand Generator::leaf() {
+	if (vars == 0 or real() < constants) {
+		return Operand(value());
+	}
+	return Operand::varOf(uniform(vars));
+}
+
+Expression Generator::expression() {
+	Expression result;
+
+	// the depth of each operation by its index
+	vector<uint32_t> height;
+	// operations that nothing uses yet
+	vector<Operand> frontier;
+	// every operation built so far
+	vector<Operand> built;
+
+	auto heightOf = [&](Operand op) -> uint32_t {
+		return op.isExpr() ? height[op.index] : 0u;
+	};
+
+	auto push = [&](int func, vector<Operand> args) {
+		uint32_t h = 0;
+		for (auto i = args.begin(); i != args.end(); i++) {
+			h = std::max(h, heightOf(*i));
+		}
+
+		Operand op = result.pushExpr(Operation(func, args));
+		if (op.index >= height.size()) {
+			height.resize(op.index+1, 0u);
+		}
+		height[op.index] = h+1;
+		frontier.push_back(op);
+		built.push_back(op);
+		return op;
+	};
+
+	for (size_t n = 0; n < size; n++) {
+		int func = function();
+		vector<Operand> args;
+		for (size_t k = 0; k < arity(func); k++) {
+			// operations that are already too deep are left where they are
+			Operand op = leaf();
+			double r = real();
+			if (r < sharing and not built.empty()) {
+				Operand candidate = built[uniform(built.size())];
+				if (depth == 0 or heightOf(candidate) < depth) {
+					op = candidate;
+				}
+			} else if (r < sharing + (1.0-sharing)*0.5 and not frontier.empty()) {
+				size_t i = uniform(frontier.size());
+				if (depth == 0 or heightOf(frontier[i]) < depth) {
+					op = frontier[i];
+					frontier[i] = frontier.back();
+					frontier.pop_back();
+				}
+			}
+			args.push_back(op);
+		}
+		push(func, args);
+	}
+
+	// join what is left of the frontier so there is one top
+	int join = Operation::ADD;
+	for (auto i = mix.begin(); i != mix.end(); i++) {
+		if (arity(i->first) == 2u) {
+			join = i->first;
+			break;
+		}
+	}
+	// as a balanced tree
+	for (size_t i = 0; i+1 < frontier.size(); i += 2) {
+		push(join, {frontier[i], frontier[i+1]});
+	}
+
+	result.top = frontier.empty() ? leaf() : frontier.back();
+	return result;
+}
+
+Expression Generator::wide(int func, size_t width) {
+	vector<Operand> args;
+	args.reserve(width);
+	for (size_t i = 0; i < width; i++) {
+		args.push_back(leaf());
+	}
+
+	Expression result;
+	result.top = result.pushExpr(Operation(func, args));
+	return result;
+}
+
+Expression Generator::chain(int func, size_t length) {
+	Expression result;
+	result.top = leaf();
+	for (size_t i = 0; i < length; i++) {
+		result.top = result.pushExpr(Operation(func, {result.top, leaf()}));
+	}
+	return result;
+}
+
+State Generator::state() {
+	State result;
+	result.values.reserve(vars);
+	for (size_t i = 0; i < vars; i++) {
+		result.values.push_back(value());
+	}
+	return result;
+}
+
+Parallel Generator::parallel(size_t actions) {
+	Parallel result;
+	for (size_t i = 0; i < actions; i++) {
+		result.actions.push_back(Action(Expression::varOf(uniform(vars)), expression()));
+	}
+	return result;
+}
+
+Choice Generator::choice(size_t terms, size_t actions) {
+	Choice result;
+	for (size_t i = 0; i < terms; i++) {
+		result.terms.push_back(parallel(actions));
+	}
+	return result;
+}
+
+}
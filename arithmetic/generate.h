@@ -0,0 +1,74 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include "expression.h"
+#include "action.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) Reproducible synthetic inputs for benchmarks and
+// scaling studies. Everything is drawn from one xorshift state rather than
+// from <random> so that the same seed gives the same inputs with every
+// standard library. Expressions are built bottom up in a single pass, with
+// each operation consuming operands from a frontier of unused operations,
+// from the operations built so far (sharing), or from new leaves. This makes
+// generation linear in size so it can produce expressions with millions of
+// operations.
+struct Generator {
+	Generator(uint64_t seed=1);
+	~Generator();
+
+	uint64_t rng;
+
+	// The approximate number of operations in each expression
+	size_t size;
+	// The maximum depth of the operations before the unused ones are joined
+	// into a single top, which adds about log2 of their number. 0 for no
+	// limit.
+	size_t depth;
+	// The probability that an operand reuses an operation that was already
+	// built
+	double sharing;
+	// The number of distinct variables
+	size_t vars;
+	// The probability that a leaf is a constant rather than a variable
+	double constants;
+	// The type of the variables and constants
+	Value::ValType type;
+	// The relative weight of each function
+	map<int, double> mix;
+
+	static map<int, double> arithmeticMix();
+	static map<int, double> wireMix();
+	static map<int, double> booleanMix();
+	// set the mix and type together
+	void useArithmetic();
+	void useWires();
+	void useBooleans();
+
+	uint64_t next();
+	// uniform in [0, n)
+	size_t uniform(size_t n);
+	// uniform in [0, 1)
+	double real();
+
+	int function();
+	Operand leaf();
+	Value value();
+
+	Expression expression();
+	// A single operation with width leaves as operands, for stressing
+	// commutative matching
+	Expression wide(int func, size_t width);
+	// length operations in a row, each applied to the previous one and a leaf
+	Expression chain(int func, size_t length);
+
+	// one value for each variable
+	State state();
+	// actions assigning random variables
+	Parallel parallel(size_t actions);
+	Choice choice(size_t terms, size_t actions);
+};
+
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <common/standard.h>
+#include <common/message.h>
+
+#include "operation_set.h"
+#include "state.h"
+#include "type.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) OperationSet and ConstOperationSet are type-erased,
+// so every getExpr() through them is an indirect call that the compiler can't
+// inline. The kernels here are templated on the operation set instead. When
+// they're instantiated on a concrete set like SimpleOperationSet or
+// Expression, whose getExpr() is defined inline, the lookup in the inner loop
+// becomes a bounds check and a load. The type-erased entry points in
+// algorithm.h are thin wrappers around the ConstOperationSet instantiation,
+// and Expression and SimpleOperationSet get overloads that skip the erasure.
+
+// Type-erased sets are small handles and are stored by value. Concrete sets
+// are stored by reference, the iterator must not outlive them.
+template <typename Set>
+struct SetRef {
+	typedef const Set &type;
+};
+
+template <>
+struct SetRef<ConstOperationSet> {
+	typedef ConstOperationSet type;
+};
+
+// Visits every operation reachable from start after all of its operands
+template <typename Set>
+struct ConstUpIteratorOn {
+	ConstUpIteratorOn(typename SetRef<Set>::type root, vector<Operand> start=vector<Operand>()) : root(root) {
+		for (auto i = start.begin(); i != start.end(); i++) {
+			if (i->isExpr()) {
+				stack.push_back(i->index);
+				setSeen(i->index);
+			}
+		}
+		stack.push_back(-1);
+		++*this;
+	}
+	~ConstUpIteratorOn() {}
+
+	typename SetRef<Set>::type root;
+	// prefer multiple vector<bool> instead of vector<pair<bool, bool>
+	// > because vector<bool> is a bitset in a c++
+	vector<bool> expand;
+	vector<bool> seen;
+	vector<size_t> stack;
+
+	void setSeen(size_t index) {
+		if (index >= seen.size()) {
+			seen.resize(index+1, false);
+		}
+		seen[index] = true;
+	}
+
+	bool getSeen(size_t index) const {
+		return index < seen.size() and seen[index];
+	}
+
+	const Operation &get() {
+		return *root.getExpr(stack.back());
+	}
+
+	const Operation &operator*() {
+		return *root.getExpr(stack.back());
+	}
+
+	const Operation *operator->() {
+		return root.getExpr(stack.back());
+	}
+
+	ConstUpIteratorOn &operator++() {
+		if (not stack.empty()) {
+			stack.pop_back();
+		}
+
+		while (not stack.empty()) {
+			if (stack.back() >= expand.size()) {
+				expand.resize(stack.back()+1, false);
+			}
+			if (expand[stack.back()]) {
+				return *this;
+			}
+
+			expand[stack.back()] = true;
+			auto curr = root.getExpr(stack.back());
+			if (curr != nullptr) {
+				for (auto i = curr->operands.begin(); i != curr->operands.end(); i++) {
+					if (i->isExpr() and not getSeen(i->index)) {
+						stack.push_back(i->index);
+						setSeen(i->index);
+					} else if (i->isExpr()) {
+						auto pos = find(stack.begin(), stack.end(), i->index);
+						if (pos != stack.end()) {
+							stack.erase(pos);
+							stack.push_back(i->index);
+						}
+					}
+				}
+			} else {
+				internal("", "malformed arithmetic expression", __FILE__, __LINE__);
+			}
+		}
+
+		return *this;
+	}
+
+	bool done() const {
+		return stack.empty();
+	}
+};
+
+template <typename Set>
+bool operator==(const ConstUpIteratorOn<Set> &i0, const ConstUpIteratorOn<Set> &i1) {
+	return i0.stack == i1.stack;
+}
+
+template <typename Set>
+bool operator!=(const ConstUpIteratorOn<Set> &i0, const ConstUpIteratorOn<Set> &i1) {
+	return i0.stack != i1.stack;
+}
+
+template <typename Set>
+ValRef evaluateOn(const Set &ops, Operand top, const State &values, TypeSet types=TypeSet(), Caller caller=Caller()) {
+	if (not top.isExpr()) {
+		return top.get(values, vector<ValRef>());
+	}
+
+	size_t prev = 0;
+	vector<ValRef> exprs;
+	for (auto i = ConstUpIteratorOn<Set>(ops, {top}); not i.done(); ++i) {
+		if (i->exprIndex >= exprs.size()) {
+			exprs.resize(i->exprIndex+1, Value::X());
+		}
+		exprs[i->exprIndex] = i->evaluate(values, exprs, types, caller);
+		prev = i->exprIndex;
+	}
+
+	if (prev >= exprs.size()) {
+		printf("internal:%s:%d: malformed expression structure\n", __FILE__, __LINE__);
+		return Value::X();
+	}
+	return exprs[prev];
+}
+
+template <typename Set>
+Cost costOn(const Set &ops, Operand top, const vector<Type> &vars, Cost::Model model=Cost::WORD) {
+	if (not top.isExpr()) {
+		return Cost();
+	}
+
+	double complexity = 0.0;
+	vector<Type> expr;
+	vector<Type> args;
+
+	for (auto curr = ConstUpIteratorOn<Set>(ops, {top}); not curr.done(); ++curr) {
+		args.clear();
+		for (auto j = curr->operands.begin(); j != curr->operands.end(); j++) {
+			if (j->isConst()) {
+				args.push_back(j->cnst.typeOf());
+			} else if (j->isVar() and j->index < vars.size()) {
+				args.push_back(vars[j->index]);
+			} else if (j->isExpr() and j->index < expr.size()) {
+				args.push_back(expr[j->index]);
+			} else {
+				printf("error: variable not defined for expression\n");
+				args.push_back(Type());
+			}
+		}
+		pair<Type, double> result = curr->funcCost(curr->func, args, model);
+		if (curr->exprIndex >= expr.size()) {
+			expr.resize(curr->exprIndex+1);
+		}
+		expr[curr->exprIndex] = result.first;
+		complexity += result.second;
+	}
+
+	double delay = 0.0;
+	if (top.index < expr.size()) {
+		delay = expr[top.index].delay;
+	}
+	return Cost(complexity, delay);
+}
+
+}
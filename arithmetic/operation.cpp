@@ -4,6 +4,7 @@
 
 #include <sstream>
 #include <array>
+#include <algorithm>
 #include <common/standard.h>
 #include <common/text.h>
 
@@ -71,7 +72,7 @@ bool Operand::isType() const {
 	return type == TYPE;
 }
 
-ValRef Operand::get(State values, vector<ValRef> expressions) const {
+ValRef Operand::get(const State &values, const vector<ValRef> &expressions) const {
 	switch (type)
 	{
 	case CONST:
@@ -260,15 +261,17 @@ bool operator<(Operand o0, Operand o1) {
 Operator::Operator() {
 	commutative = false;
 	reflexive = true;
+	precedence = 0;
 }
 
-Operator::Operator(string prefix, string trigger, string infix, string postfix, uint8_t flags) {
+Operator::Operator(string prefix, string trigger, string infix, string postfix, uint8_t flags, int precedence) {
 	this->prefix = prefix;
 	this->trigger = trigger;
 	this->infix = infix;
 	this->postfix = postfix;
 	this->commutative = (flags & COMMUTATIVE) != 0;
 	this->reflexive = (flags & REFLEXIVE) != 0;
+	this->precedence = precedence;
 }
 
 Operator::~Operator() {
@@ -305,41 +308,44 @@ void Operation::loadOperators() {
 	// the expression engine. Channel actions should be decomposed into their
 	// appropriate protocols while expanding the CHP.
 
+	// DESIGN(edward.bingham) The precedence of the infix operators is used by
+	// the parser, see parser.h.
+
 	if (Operation::operators.count() == 0) {
 		//printf("loading operators\n");
 
 		set(OpType::VALIDITY, Operator("valid(", "", "", ")"));
 		set(OpType::WIRE_NOT, Operator("~", "", "", ""));
-		set(OpType::WIRE_OR, Operator("", "", "|", "", Operator::COMMUTATIVE));
-		set(OpType::WIRE_AND, Operator("", "", "&", "", Operator::COMMUTATIVE));
-		set(OpType::WIRE_XOR, Operator("", "", "^", "", Operator::COMMUTATIVE));
+		set(OpType::WIRE_OR, Operator("", "", "|", "", Operator::COMMUTATIVE, 7));
+		set(OpType::WIRE_AND, Operator("", "", "&", "", Operator::COMMUTATIVE, 9));
+		set(OpType::WIRE_XOR, Operator("", "", "^", "", Operator::COMMUTATIVE, 8));
 
 		set(OpType::TRUTHINESS, Operator("true(", "", "", ")"));
 		set(OpType::BOOLEAN_NOT, Operator("!", "", "", ""));
-		set(OpType::BOOLEAN_OR, Operator("", "", "||", "", Operator::COMMUTATIVE));
-		set(OpType::BOOLEAN_AND, Operator("", "", "&&", "", Operator::COMMUTATIVE));
-		set(OpType::BOOLEAN_XOR, Operator("", "", "^^", "", Operator::COMMUTATIVE));
-
-		set(OpType::EQUAL, Operator("", "", "==", ""));
-		set(OpType::NOT_EQUAL, Operator("", "", "~=", ""));
-		set(OpType::LESS, Operator("", "", "<", ""));
-		set(OpType::GREATER, Operator("", "", ">", ""));
-		set(OpType::LESS_EQUAL, Operator("", "", "<=", ""));
-		set(OpType::GREATER_EQUAL, Operator("", "", ">=", ""));
+		set(OpType::BOOLEAN_OR, Operator("", "", "||", "", Operator::COMMUTATIVE, 2));
+		set(OpType::BOOLEAN_AND, Operator("", "", "&&", "", Operator::COMMUTATIVE, 4));
+		set(OpType::BOOLEAN_XOR, Operator("", "", "^^", "", Operator::COMMUTATIVE, 3));
+
+		set(OpType::EQUAL, Operator("", "", "==", "", 0, 5));
+		set(OpType::NOT_EQUAL, Operator("", "", "~=", "", 0, 5));
+		set(OpType::LESS, Operator("", "", "<", "", 0, 6));
+		set(OpType::GREATER, Operator("", "", ">", "", 0, 6));
+		set(OpType::LESS_EQUAL, Operator("", "", "<=", "", 0, 6));
+		set(OpType::GREATER_EQUAL, Operator("", "", ">=", "", 0, 6));
 		set(OpType::NEGATIVE, Operator("ltz(", "", "", ")"));
-		set(OpType::TERNARY, Operator("", "?", ":", ""));
+		set(OpType::TERNARY, Operator("", "?", ":", "", 0, 1));
 
 		set(OpType::IDENTITY, Operator("+", "", "", "", Operator::REFLEXIVE));
 		set(OpType::NEGATION, Operator("-", "", "", ""));
 		set(OpType::INVERSE, Operator("inv(", "", "", ")"));
 
-		set(OpType::SHIFT_LEFT, Operator("", "", "<<", ""));
-		set(OpType::SHIFT_RIGHT, Operator("", "", ">>", ""));
-		set(OpType::ADD, Operator("", "", "+", "", Operator::COMMUTATIVE));
-		set(OpType::SUBTRACT, Operator("", "", "-", ""));
-		set(OpType::MULTIPLY, Operator("", "", "*", "", Operator::COMMUTATIVE));
-		set(OpType::DIVIDE, Operator("", "", "/", ""));
-		set(OpType::MOD, Operator("", "", "%", ""));
+		set(OpType::SHIFT_LEFT, Operator("", "", "<<", "", 0, 10));
+		set(OpType::SHIFT_RIGHT, Operator("", "", ">>", "", 0, 10));
+		set(OpType::ADD, Operator("", "", "+", "", Operator::COMMUTATIVE, 11));
+		set(OpType::SUBTRACT, Operator("", "", "-", "", 0, 11));
+		set(OpType::MULTIPLY, Operator("", "", "*", "", Operator::COMMUTATIVE, 12));
+		set(OpType::DIVIDE, Operator("", "", "/", "", 0, 12));
+		set(OpType::MOD, Operator("", "", "%", "", 0, 12));
 
 		set(OpType::CALL, Operator("", "(", ",", ")"));
 		set(OpType::CAST, Operator("(", ")", "", ""));
@@ -350,11 +356,13 @@ void Operation::loadOperators() {
 		set(OpType::STRUCT, Operator("", "{", ",", "}"));
 		set(OpType::MEMBER, Operator("", ".", "", ""));
 
+		set(OpType::EACH, Operator("each(", "", ",", ")"));
+
 		//printf("loaded %d operators\n", (int)Operation::operators.size());
 	} 
 }
 
-pair<Type, double> Operation::funcCost(int func, vector<Type> args) {
+pair<Type, double> Operation::funcCost(int func, vector<Type> args, Cost::Model model) {
 	// If I have two fixed-point inputs, then the offset determines the
 	// complexity of the operator because it can affect the overlap of the two
 	// inputs. Again, because encodings may not be base-2, the offset may not be
@@ -447,6 +455,12 @@ pair<Type, double> Operation::funcCost(int func, vector<Type> args) {
 		cost = args[0].width*args[1].width;
 		return {result, cost};
 	} else if (func == Operation::ADD or func == Operation::SUBTRACT) { // subtraction "-"
+		// The bit-level models keep track of the overlapping intervals in a dadda
+		// tree followed by a ripple carry or carry look-ahead final sum.
+		if (model != Cost::WORD) {
+			return addTree(args, model);
+		}
+
 		// TODO(edward.bingham) I should really keep track of overlapping intervals
 		// here and then the critical path is the total overlap at the bit with
 		// maximum overlap. If there are multiple bits with the same maximum
@@ -472,6 +486,11 @@ pair<Type, double> Operation::funcCost(int func, vector<Type> args) {
 		result.delay += (double)args.size() + result.width;
 		return {result, cost};
 	} else if (func == Operation::MULTIPLY) { // multiply "*"
+		// The bit-level models reduce partial products with multiplication trees
+		if (model != Cost::WORD) {
+			return multiplyTree(args, model);
+		}
+
 		// TODO(edward.bingham) This assumes a set of N sequental multiplications.
 		// Doing so completely ignores multiplication trees and bit-level
 		// parallelism. It's likely going to make iterative multiplication look
@@ -797,7 +816,7 @@ ValRef Operation::evaluate(int func, vector<ValRef> args, TypeSet types, Caller
 	return Value::X();
 }
 
-ValRef Operation::evaluate(State values, vector<ValRef> expressions, TypeSet types, Caller caller) const {
+ValRef Operation::evaluate(const State &values, const vector<ValRef> &expressions, TypeSet types, Caller caller) const {
 	vector<ValRef> args;
 	args.reserve(operands.size());
 	for (int i = 0; i < (int)operands.size(); i++) {
@@ -902,16 +921,50 @@ Operation &Operation::apply(const Mapping<Operand> &m) {
 
 Operation Operation::extract(vector<size_t> idx, size_t exprIndex) {
 	Operation result(func, {}, exprIndex);
+	result.operands.reserve(idx.size());
 	for (int i = (int)idx.size()-1; i >= 0; i--) {
 		result.operands.push_back(operands[idx[i]]);
-		if (i != 0) {
-			operands.erase(operands.begin()+idx[i]);
-		}
 	}
-	operands[idx[0]] = Operand::exprOf(exprIndex);
+	Operand op = Operand::exprOf(exprIndex);
+	splice(idx, &op, &op+1);
 	return result;
 }
 
+void Operation::splice(const vector<size_t> &remove, const Operand *first, const Operand *last) {
+	size_t n = last-first;
+	if (remove.empty()) {
+		operands.insert(operands.end(), first, last);
+		return;
+	}
+
+	size_t at = remove[0];
+	size_t m = remove.size();
+	if (remove.back()-at+1 != m) {
+		// Close up the gaps in a single pass so that the removed operands form
+		// one range at the end.
+		size_t w = at;
+		size_t k = 0;
+		for (size_t r = at; r < operands.size(); r++) {
+			if (k < m and remove[k] == r) {
+				k++;
+			} else {
+				operands[w++] = operands[r];
+			}
+		}
+		// the kept operands are now [at, w), shift them past the new ones
+		std::rotate(operands.begin()+at, operands.begin()+w, operands.end());
+	}
+
+	// [at, at+m) is now the range to replace. Overwrite what we can and only
+	// shift the rest of the operands if the sizes differ.
+	std::copy(first, first+std::min(n, m), operands.begin()+at);
+	if (n > m) {
+		operands.insert(operands.begin()+at+m, first+m, last);
+	} else if (n < m) {
+		operands.erase(operands.begin()+at+n, operands.begin()+at+m);
+	}
+}
+
 Operation &Operation::offsetExpr(int off) {
 	exprIndex += off;
 	for (int i = 0; i < (int)operands.size(); i++) {
@@ -976,6 +1029,19 @@ bool operator==(Operation o0, Operation o1) {
 	return true;
 }
 
+size_t hashOf(const Operation &o) {
+	size_t result = hashCombine((size_t)o.func, o.operands.size());
+	for (auto i = o.operands.begin(); i != o.operands.end(); i++) {
+		result = hashCombine(result, (size_t)i->type);
+		if (i->isConst()) {
+			result = hashCombine(result, hashOf(i->cnst));
+		} else if (not i->isUndef()) {
+			result = hashCombine(result, i->index);
+		}
+	}
+	return result;
+}
+
 bool operator!=(Operation o0, Operation o1) {
 	return not (o0 == o1);
 }
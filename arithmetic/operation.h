@@ -40,7 +40,7 @@ struct Operand {
 	bool isVar() const;
 	bool isType() const;
 
-	ValRef get(State values=State(), vector<ValRef> expressions=vector<ValRef>()) const;
+	ValRef get(const State &values=State(), const vector<ValRef> &expressions=vector<ValRef>()) const;
 	void set(State &values, vector<ValRef> &expressions, ValRef v) const;
 
 	// Undefined
@@ -78,7 +78,7 @@ bool operator<(Operand o0, Operand o1); // does not differentiate constants
 
 struct Operator {
 	Operator();
-	Operator(string prefix, string trigger, string infix, string postfix, uint8_t flags=0);
+	Operator(string prefix, string trigger, string infix, string postfix, uint8_t flags=0, int precedence=0);
 	~Operator();
 
 	enum Flags {
@@ -93,6 +93,9 @@ struct Operator {
 
 	bool commutative;
 	bool reflexive;
+	// How tightly an infix or ternary operator binds, higher is tighter. 0
+	// for every other operator.
+	int precedence;
 };
 
 struct Operation {
@@ -139,6 +142,10 @@ struct Operation {
 
 		STRUCT,
 		MEMBER,
+
+		// Only used by rewrite rules. each(v, f(v)) is the list f(x) for
+		// every operand x bound to v.
+		EACH,
 	};
 
 	Operation();
@@ -157,7 +164,7 @@ struct Operation {
 	// The expression index to map this operation to
 	size_t exprIndex;
 
-	static pair<Type, double> funcCost(int func, vector<Type> args);
+	static pair<Type, double> funcCost(int func, vector<Type> args, Cost::Model model=Cost::WORD);
 
 	void set(int func, vector<Operand> args);
 	bool isCommutative() const;
@@ -165,7 +172,7 @@ struct Operation {
 	bool isUndef() const;
 
 	static ValRef evaluate(int func, vector<ValRef> args, TypeSet types=TypeSet(), Caller caller=Caller());
-	ValRef evaluate(State values, vector<ValRef> expressions, TypeSet types=TypeSet(), Caller caller=Caller()) const;
+	ValRef evaluate(const State &values, const vector<ValRef> &expressions, TypeSet types=TypeSet(), Caller caller=Caller()) const;
 	void propagate(State &result, const State &global, vector<ValRef> &expressions, const vector<ValRef> gexpressions, Value v) const;
 	Operation &applyVars(const Mapping<size_t> &m);
 	Operation &applyVars(const Mapping<int> &m);
@@ -173,6 +180,10 @@ struct Operation {
 	Operation &applyExprs(const Mapping<int> &m);
 	Operation &apply(const Mapping<Operand> &m);
 	Operation extract(vector<size_t> idx, size_t exprIndex=0);
+	// Remove the operands at the indices in remove, which must be sorted, and
+	// put [first, last) where the first of them was. If remove is empty, the
+	// new operands are added to the end.
+	void splice(const vector<size_t> &remove, const Operand *first, const Operand *last);
 	Operation &offsetExpr(int off);
 
 	Operand op() const;
@@ -183,6 +194,10 @@ struct Operation {
 bool operator==(Operation o0, Operation o1);
 bool operator!=(Operation o0, Operation o1);
 
+// Hash of the function and operands, consistent with operator==. The
+// operands of other operations are hashed by their index.
+size_t hashOf(const Operation &o);
+
 ostream &operator<<(ostream &os, Operation o);
 
 }
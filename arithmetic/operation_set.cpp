@@ -20,7 +20,7 @@ vector<Operand> SimpleOperationSet::exprIndex() const {
 	return result;
 }
 
-const Operation *SimpleOperationSet::getExpr(size_t index) const {
+Operation *SimpleOperationSet::refExpr(size_t index) {
 	if (not elems.is_valid(index)) {
 		return nullptr;
 	}
@@ -7,9 +7,14 @@
 
 namespace arithmetic {
 
+// DESIGN(edward.bingham) refExpr() gives a mutable pointer into the set so
+// that an operation can be edited where it is instead of copying it out with
+// getExpr() and back in with setExpr(). The pointer is only valid until the
+// next pushExpr(), setExpr(), or eraseExpr() on the same set.
 _INTERFACE_ARG(OperationSet,
 	(vector<Operand>, exprIndex, () const, ()),
 	(const Operation *, getExpr, (size_t index) const, (index)),
+	(Operation *, refExpr, (size_t index), (index)),
 	(bool, setExpr, (Operation o), (o)),
 	(Operand, pushExpr, (Operation o), (o)),
 	(bool, eraseExpr, (size_t index), (index)));
@@ -25,7 +30,14 @@ struct SimpleOperationSet {
 	index_vector<Operation> elems;
 
 	vector<Operand> exprIndex() const;
-	const Operation *getExpr(size_t index) const;
+	// inline so that the kernels in kernel.h can see through it
+	const Operation *getExpr(size_t index) const {
+		if (not elems.is_valid(index)) {
+			return nullptr;
+		}
+		return &elems[index];
+	}
+	Operation *refExpr(size_t index);
 	bool setExpr(Operation o);
 	Operand pushExpr(Operation o);
 	bool eraseExpr(size_t index);
@@ -0,0 +1,526 @@
+#include "parser.h"
+#include "serialize.h"
+
+#include <cerrno>
+#include <cstring>
+
+namespace arithmetic {
+
+Parser::Parser() {
+	Operation::loadOperators();
+	for (int i = 0; i < (int)Operation::operators.size(); i++) {
+		const Operator &op = Operation::operators[i];
+		if (op.prefix.empty() and op.trigger.empty() and not op.infix.empty() and op.postfix.empty()) {
+			binary.push_back({op.infix, i});
+		} else if (not op.prefix.empty() and op.prefix.back() == '(' and op.trigger.empty() and not op.postfix.empty()) {
+			calls.push_back({op.prefix, i});
+		} else if (not op.prefix.empty() and op.trigger.empty() and op.infix.empty() and op.postfix.empty()) {
+			unary.push_back({op.prefix, i});
+		}
+	}
+
+	begin = nullptr;
+	curr = nullptr;
+	end = nullptr;
+	line = 1;
+	lines = false;
+	depth = 0;
+	newline = false;
+	skipped = nullptr;
+	result = nullptr;
+}
+
+Parser::~Parser() {
+}
+
+void Parser::reset(const char *str, size_t len) {
+	begin = str;
+	curr = str;
+	end = str+len;
+	line = 1;
+	depth = 0;
+	newline = false;
+	skipped = nullptr;
+	lets.clear();
+	error.clear();
+}
+
+bool Parser::parse(const char *str, size_t len, Expression &expr) {
+	reset(str, len);
+	lines = false;
+	result = &expr;
+	expr.clear();
+	expr.top = expression(0);
+	if (not done()) {
+		fail("unexpected '" + string(1, *curr) + "'");
+	}
+	result = nullptr;
+	return error.empty();
+}
+
+bool Parser::parseRules(const char *str, size_t len, RuleSet &rules) {
+	reset(str, len);
+	lines = true;
+
+	vector<Expression> lst;
+	while (not done()) {
+		if (accept(";")) {
+			continue;
+		}
+
+		size_t start = line;
+		Expression rule;
+		result = &rule;
+		rule.top = expression(0);
+		result = nullptr;
+		if (not error.empty()) {
+			return false;
+		}
+		if (not verifyRuleFormat(rule, rule.top, false)) {
+			line = start;
+			fail("expected a rule of the form 'from > to', 'to < from', or 'left == right'");
+			return false;
+		}
+		lst.push_back(rule);
+
+		if (not done() and not newline and not accept(";")) {
+			fail("unexpected '" + string(1, *curr) + "'");
+			return false;
+		}
+	}
+
+	rules += RuleSet(lst);
+	return true;
+}
+
+// Skip whitespace and comments, remembering whether that crossed a newline.
+// Calling this again without consuming anything leaves newline as is.
+void Parser::skip() {
+	if (curr == skipped) {
+		return;
+	}
+
+	newline = false;
+	while (curr < end) {
+		if (*curr == '\n') {
+			newline = true;
+			line++;
+			curr++;
+		} else if (isspace(*curr)) {
+			curr++;
+		} else if (*curr == '#' or (*curr == '/' and curr+1 < end and curr[1] == '/')) {
+			while (curr < end and *curr != '\n') {
+				curr++;
+			}
+		} else {
+			break;
+		}
+	}
+	skipped = curr;
+}
+
+bool Parser::done() {
+	skip();
+	return curr >= end;
+}
+
+bool Parser::peek(const char *tok) {
+	skip();
+	size_t len = strlen(tok);
+	return (size_t)(end-curr) >= len and strncmp(curr, tok, len) == 0;
+}
+
+bool Parser::accept(const char *tok) {
+	if (peek(tok)) {
+		curr += strlen(tok);
+		return true;
+	}
+	return false;
+}
+
+bool Parser::expect(const char *tok) {
+	if (accept(tok)) {
+		return true;
+	}
+	fail(string("expected '") + tok + "'");
+	return false;
+}
+
+string Parser::identifier() {
+	skip();
+	const char *from = curr;
+	if (curr < end and (isalpha(*curr) or *curr == '_')) {
+		curr++;
+		while (curr < end and (isalnum(*curr) or *curr == '_')) {
+			curr++;
+		}
+	}
+	return string(from, curr);
+}
+
+// Integers are stored as INT and anything with a decimal point or exponent
+// as REAL.
+Operand Parser::number() {
+	skip();
+	const char *from = curr;
+	bool real = false;
+	while (curr < end and isdigit(*curr)) {
+		curr++;
+	}
+	if (curr+1 < end and *curr == '.' and isdigit(curr[1])) {
+		real = true;
+		curr++;
+		while (curr < end and isdigit(*curr)) {
+			curr++;
+		}
+	}
+	if (curr < end and (*curr == 'e' or *curr == 'E')) {
+		const char *exp = curr+1;
+		if (exp < end and (*exp == '+' or *exp == '-')) {
+			exp++;
+		}
+		if (exp < end and isdigit(*exp)) {
+			real = true;
+			curr = exp;
+			while (curr < end and isdigit(*curr)) {
+				curr++;
+			}
+		}
+	}
+
+	// The input isn't necessarily null terminated
+	string text(from, curr);
+	char *stop = nullptr;
+	errno = 0;
+	if (real) {
+		double value = strtod(text.c_str(), &stop);
+		if (errno == ERANGE or stop != text.c_str()+text.size()) {
+			fail("number '" + text + "' is out of range");
+			return Operand::undef();
+		}
+		return Operand::realOf(value);
+	}
+	long long value = strtoll(text.c_str(), &stop, 10);
+	if (errno == ERANGE or stop != text.c_str()+text.size()) {
+		fail("number '" + text + "' is out of range");
+		return Operand::undef();
+	}
+	return Operand::intOf(value);
+}
+
+void Parser::fail(string msg) {
+	if (error.empty()) {
+		error = "line " + std::to_string(line) + ": " + msg;
+	}
+	curr = end;
+	skipped = nullptr;
+}
+
+int Parser::match(const vector<pair<string, int> > &ops, size_t *len) {
+	skip();
+	int func = Operation::UNDEF;
+	*len = 0;
+	for (auto i = ops.begin(); i != ops.end(); i++) {
+		if (i->first.size() > *len
+			and (size_t)(end-curr) >= i->first.size()
+			and strncmp(curr, i->first.c_str(), i->first.size()) == 0) {
+			func = i->second;
+			*len = i->first.size();
+		}
+	}
+	return func;
+}
+
+int Parser::find(string prefix, string trigger) {
+	for (int i = 0; i < (int)Operation::operators.size(); i++) {
+		if (Operation::operators[i].prefix == prefix and Operation::operators[i].trigger == trigger) {
+			return i;
+		}
+	}
+	return Operation::UNDEF;
+}
+
+// Prefix, postfix and call operators bind tighter than any infix operator
+int Parser::precedence(int func) {
+	if (func >= 0 and Operation::operators.is_valid(func) and Operation::operators[func].precedence > 0) {
+		return Operation::operators[func].precedence;
+	}
+	return std::numeric_limits<int>::max();
+}
+
+Operand Parser::push(int func, vector<Operand> args) {
+	if (not error.empty()) {
+		return Operand::undef();
+	}
+	return result->pushExpr(Operation(func, args));
+}
+
+// Parse operations that bind at least as tightly as bind. Binary operators
+// are left associative and the ternary operator is right associative.
+Operand Parser::expression(int bind) {
+	Operand left = primary();
+	while (error.empty() and not done()) {
+		if (lines and depth == 0 and newline) {
+			break;
+		}
+
+		int prec = precedence(Operation::TERNARY);
+		if (prec >= bind and peek(Operation::operators[Operation::TERNARY].trigger.c_str())) {
+			accept(Operation::operators[Operation::TERNARY].trigger.c_str());
+			depth++;
+			Operand then = expression(0);
+			expect(Operation::operators[Operation::TERNARY].infix.c_str());
+			depth--;
+			Operand otherwise = expression(prec);
+			left = push(Operation::TERNARY, {left, then, otherwise});
+			continue;
+		}
+
+		size_t len = 0;
+		int func = match(binary, &len);
+		if (func == Operation::UNDEF or (prec = precedence(func)) < bind) {
+			break;
+		}
+		curr += len;
+
+		Operand right = expression(prec+1);
+		left = push(func, {left, right});
+	}
+	return left;
+}
+
+Operand Parser::primary() {
+	if (done()) {
+		fail("unexpected end of input");
+		return Operand::undef();
+	}
+
+	static const int CAST = find("(", ")");
+	static const int ARRAY = find("[", "");
+
+	size_t len = 0;
+	int func = Operation::UNDEF;
+	Operand result;
+	if (accept("(")) {
+		depth++;
+		result = expression(0);
+		expect(")");
+		depth--;
+
+		// ("type")value is a cast
+		skip();
+		if (result.isConst() and result.cnst.type == Value::STRING and error.empty()
+			and not done() and not (lines and depth == 0 and newline)
+			and (isalnum(*curr) or *curr == '_' or *curr == '"' or *curr == '(' or *curr == '[' or match(unary, &len) != Operation::UNDEF)
+			and match(binary, &len) == Operation::UNDEF) {
+			Operand value = expression(precedence(CAST));
+			return push(CAST, {result, value});
+		}
+	} else if (peek(Operation::operators[ARRAY].prefix.c_str())) {
+		curr += Operation::operators[ARRAY].prefix.size();
+		vector<Operand> args;
+		arguments(args, Operation::operators[ARRAY].infix.c_str(), Operation::operators[ARRAY].postfix.c_str());
+		result = push(ARRAY, args);
+	} else if (accept("{")) {
+		// a constant structure
+		vector<Operand> args;
+		arguments(args, ",", "}");
+		vector<Value> members;
+		for (auto i = args.begin(); i != args.end(); i++) {
+			if (not i->isConst()) {
+				fail("structure literals may only contain constants");
+				return Operand::undef();
+			}
+			members.push_back(i->cnst);
+		}
+		result = Operand::structOf("", members);
+	} else if (*curr == '"') {
+		const char *from = ++curr;
+		while (curr < end and *curr != '"' and *curr != '\n') {
+			curr++;
+		}
+		if (curr >= end or *curr != '"') {
+			fail("unterminated string");
+			return Operand::undef();
+		}
+		result = Operand::stringOf(string(from, curr++));
+	} else if (*curr == '?') {
+		curr++;
+		result = Operand(Value::undef());
+	} else if (isdigit(*curr)) {
+		result = number();
+	} else if (*curr == '-' and curr+1 < end and isdigit(curr[1])) {
+		// negative constants are printed without parentheses
+		curr++;
+		result = number();
+		if (result.cnst.type == Value::INT) {
+			result.cnst.ival = -result.cnst.ival;
+		} else {
+			result.cnst.rval = -result.cnst.rval;
+		}
+	} else if ((func = match(calls, &len)) != Operation::UNDEF) {
+		curr += len;
+		const Operator &op = Operation::operators[func];
+		vector<Operand> args;
+		arguments(args, op.infix.empty() ? "," : op.infix.c_str(), op.postfix.c_str());
+		result = push(func, args);
+	} else if ((func = match(unary, &len)) != Operation::UNDEF) {
+		curr += len;
+		Operand arg = expression(precedence(func));
+		return push(func, {arg});
+	} else if (isalpha(*curr) or *curr == '_') {
+		string name = identifier();
+		auto let = lets.find(name);
+		if (let != lets.end()) {
+			result = let->second;
+		} else if (name == "let") {
+			// let name = value, ... in body
+			do {
+				skip();
+				string bind = identifier();
+				if (bind.empty()) {
+					fail("expected a name to bind");
+					return Operand::undef();
+				}
+				expect("=");
+				depth++;
+				Operand value = expression(0);
+				depth--;
+				lets[bind] = value;
+			} while (error.empty() and accept(","));
+			skip();
+			if (error.empty() and identifier() != "in") {
+				fail("expected 'in'");
+				return Operand::undef();
+			}
+			return expression(0);
+		} else if (name == "true") {
+			result = Operand::boolOf(true);
+		} else if (name == "false") {
+			result = Operand::boolOf(false);
+		} else if (name == "gnd") {
+			result = Operand::gnd();
+		} else if (name == "vdd") {
+			result = Operand::vdd();
+		} else if (name == "X") {
+			result = Operand::X();
+		} else if (name == "U") {
+			result = Operand::U();
+		} else if (curr < end and *curr == '(') {
+			// name(args) is a call
+			result = Operand::stringOf(name);
+		} else if (name.size() > 1u and name[0] == 'v' and name.find_first_not_of("0123456789", 1) == string::npos) {
+			size_t index = 0;
+			for (auto c = name.begin()+1; c != name.end(); c++) {
+				size_t digit = (size_t)(*c - '0');
+				if (index > (std::numeric_limits<size_t>::max() - digit)/10u) {
+					fail("variable index in '" + name + "' is too large");
+					return Operand::undef();
+				}
+				index = index*10u + digit;
+			}
+			result = Operand::varOf(index);
+		} else {
+			auto pos = vars.insert({name, vars.size()});
+			result = Operand::varOf(pos.first->second);
+		}
+	} else {
+		fail("unexpected '" + string(1, *curr) + "'");
+		return Operand::undef();
+	}
+
+	return postfix(result);
+}
+
+Operand Parser::postfix(Operand left) {
+	static const int CALL = find("", "(");
+	static const int INDEX = find("", "[");
+	static const int STRUCT = find("", "{");
+	static const int MEMBER = find("", ".");
+
+	while (error.empty() and not done()) {
+		if (lines and depth == 0 and newline) {
+			break;
+		}
+
+		bool name = left.isConst() and left.cnst.type == Value::STRING;
+		if (accept(Operation::operators[INDEX].trigger.c_str())) {
+			vector<Operand> args({left});
+			arguments(args, Operation::operators[INDEX].infix.c_str(), Operation::operators[INDEX].postfix.c_str());
+			left = push(INDEX, args);
+		} else if (name and accept(Operation::operators[CALL].trigger.c_str())) {
+			vector<Operand> args({left});
+			arguments(args, Operation::operators[CALL].infix.c_str(), Operation::operators[CALL].postfix.c_str());
+			left = push(CALL, args);
+		} else if (name and accept(Operation::operators[STRUCT].trigger.c_str())) {
+			vector<Operand> args({left});
+			arguments(args, Operation::operators[STRUCT].infix.c_str(), Operation::operators[STRUCT].postfix.c_str());
+			left = push(STRUCT, args);
+		} else if (curr+1 < end and not isdigit(curr[1]) and accept(Operation::operators[MEMBER].trigger.c_str())) {
+			skip();
+			Operand member;
+			if (curr < end and *curr == '"') {
+				member = primary();
+			} else {
+				string id = identifier();
+				if (id.empty()) {
+					fail("expected a member name");
+					return Operand::undef();
+				}
+				member = Operand::stringOf(id);
+			}
+			left = push(MEMBER, {left, member});
+		} else {
+			break;
+		}
+	}
+	return left;
+}
+
+// Parse a list of expressions separated by sep up to and including close
+void Parser::arguments(vector<Operand> &args, const char *sep, const char *close) {
+	depth++;
+	if (not accept(close)) {
+		do {
+			args.push_back(expression(0));
+		} while (error.empty() and accept(sep));
+		expect(close);
+	}
+	depth--;
+}
+
+Expression parseExpression(string str) {
+	Parser parser;
+	Expression result;
+	if (not parser.parse(str.c_str(), str.size(), result)) {
+		printf("error: %s\n", parser.error.c_str());
+		return Expression::undef();
+	}
+	return result;
+}
+
+RuleSet parseRules(string str) {
+	Parser parser;
+	RuleSet result;
+	if (not parser.parseRules(str.c_str(), str.size(), result)) {
+		printf("error: %s\n", parser.error.c_str());
+	}
+	return result;
+}
+
+bool loadRules(string path, RuleSet &rules) {
+	MappedFile file(path);
+	if (not file.isOpen()) {
+		printf("error: unable to open '%s'\n", path.c_str());
+		return false;
+	}
+
+	Parser parser;
+	if (not parser.parseRules(file.data, file.size, rules)) {
+		printf("error: %s:%s\n", path.c_str(), parser.error.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
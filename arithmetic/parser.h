@@ -0,0 +1,101 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include "expression.h"
+#include "rewrite.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) This is a Pratt parser driven by the operator table
+// in Operation::operators, so anything to_string() prints can be read back
+// in. The input is scanned in place without building a token list, and each
+// operation is pushed straight into the result without deduplication.
+// tidy() handles that afterward if needed.
+//
+// Binding from loosest to tightest, as set by Operator::precedence:
+//   ?:
+//   || then ^^ then &&
+//   == ~=
+//   < > <= >=
+//   | then ^ then &
+//   << >>
+//   + -
+//   * / %
+//   prefix operators
+//   x[i], x.member, name(...), name{...}
+//
+// The comparisons bind more loosely than the wire operators, so the rule
+// a & ~a > gnd reads as (a & ~a) > gnd. Variables are either written vN, or
+// as a name, which is numbered in order of first appearance. Don't mix the
+// two in one input. The shared form printed by print() is also accepted:
+//   let e0 = (v0+v1), e2 = (e0*e0) in (e2-e0)
+//
+// A rule file has one rule per line, or rules separated by ';'. A rule may
+// only continue onto the next line inside of parentheses or brackets. '#'
+// and '//' start a comment that runs to the end of the line.
+struct Parser {
+	Parser();
+	~Parser();
+
+	// named variables and the index assigned to each
+	map<string, size_t> vars;
+	// names bound by let and the operation each refers to
+	map<string, Operand> lets;
+
+	// The operators from Operation::operators by how they are written. Each
+	// entry is the token and the function.
+	vector<pair<string, int> > binary;
+	vector<pair<string, int> > unary;
+	vector<pair<string, int> > calls;
+
+	const char *begin;
+	const char *curr;
+	const char *end;
+	size_t line;
+
+	// Whether a newline ends the current expression, how deeply nested in
+	// brackets the parser is, and whether skip() crossed a newline to get to
+	// curr.
+	bool lines;
+	int depth;
+	bool newline;
+	const char *skipped;
+
+	// the first error encountered, empty if none
+	string error;
+
+	Expression *result;
+
+	void reset(const char *str, size_t len);
+	bool parse(const char *str, size_t len, Expression &expr);
+	bool parseRules(const char *str, size_t len, RuleSet &rules);
+
+	// scanning
+	void skip();
+	bool done();
+	bool peek(const char *tok);
+	bool accept(const char *tok);
+	bool expect(const char *tok);
+	string identifier();
+	Operand number();
+	void fail(string msg);
+
+	// The operator from ops whose token is the longest match at the current
+	// position, or UNDEF
+	int match(const vector<pair<string, int> > &ops, size_t *len);
+	static int find(string prefix, string trigger);
+	static int precedence(int func);
+
+	Operand push(int func, vector<Operand> args);
+	Operand expression(int bind);
+	Operand primary();
+	Operand postfix(Operand left);
+	void arguments(vector<Operand> &args, const char *sep, const char *close);
+};
+
+Expression parseExpression(string str);
+RuleSet parseRules(string str);
+bool loadRules(string path, RuleSet &rules);
+
+}
@@ -0,0 +1,213 @@
+#include "pool.h"
+#include "algorithm.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace arithmetic {
+
+ExpressionPool::ExpressionPool() {
+}
+
+ExpressionPool::~ExpressionPool() {
+}
+
+vector<Operand> ExpressionPool::exprIndex() const {
+	return sub.exprIndex();
+}
+
+const Operation *ExpressionPool::getExpr(size_t index) const {
+	return sub.getExpr(index);
+}
+
+size_t ExpressionPool::size() const {
+	return sub.size();
+}
+
+Operand ExpressionPool::intern(Operation o) {
+	if (o.isCommutative()) {
+		// operator< doesn't order constants, so order them by their hash. Equal
+		// constants hash the same, so only a hash collision can keep two
+		// orderings of the same operands apart.
+		std::stable_sort(o.operands.begin(), o.operands.end(), [](const Operand &a, const Operand &b) {
+			if (a < b or b < a) {
+				return a < b;
+			}
+			return a.isConst() and b.isConst() and hashOf(a.cnst) < hashOf(b.cnst);
+		});
+	}
+
+	size_t h = hashOf(o);
+	auto range = table.equal_range(h);
+	for (auto i = range.first; i != range.second; i++) {
+		const Operation *existing = sub.getExpr(i->second);
+		if (existing != nullptr and *existing == o) {
+			return Operand::exprOf(i->second);
+		}
+	}
+
+	for (auto i = o.operands.begin(); i != o.operands.end(); i++) {
+		acquire(*i);
+	}
+
+	Operand result = sub.pushExpr(o);
+	if (result.index >= refs.size()) {
+		refs.resize(result.index+1, 0u);
+		hashes.resize(result.index+1, 0u);
+	}
+	refs[result.index] = 0u;
+	hashes[result.index] = h;
+	table.insert({h, result.index});
+	return result;
+}
+
+Operand ExpressionPool::insert(const Expression &e) {
+	if (not e.top.isExpr()) {
+		return e.top;
+	}
+
+	// from exprIndex in e to the operand in the pool
+	vector<Operand> m;
+	for (ConstUpIterator i(e, {e.top}); not i.done(); ++i) {
+		Operation o = *i;
+		for (auto j = o.operands.begin(); j != o.operands.end(); j++) {
+			if (j->isExpr()) {
+				*j = m[j->index];
+			}
+		}
+		if (i->exprIndex >= m.size()) {
+			m.resize(i->exprIndex+1, Operand::undef());
+		}
+		m[i->exprIndex] = intern(o);
+	}
+	return m[e.top.index];
+}
+
+void ExpressionPool::acquire(Operand op) {
+	if (op.isExpr()) {
+		refs[op.index]++;
+	}
+}
+
+void ExpressionPool::release(Operand op) {
+	if (op.isExpr()) {
+		if (refs[op.index] == 0u) {
+			printf("internal:%s:%d: released an operation with no references\n", __FILE__, __LINE__);
+			return;
+		}
+		refs[op.index]--;
+	}
+}
+
+Operand ExpressionPool::set(string name, const Expression &e) {
+	Operand top = insert(e);
+	acquire(top);
+
+	auto pos = roots.find(name);
+	if (pos != roots.end()) {
+		release(pos->second);
+		pos->second = top;
+	} else {
+		roots.insert({name, top});
+	}
+	return top;
+}
+
+bool ExpressionPool::erase(string name) {
+	auto pos = roots.find(name);
+	if (pos == roots.end()) {
+		return false;
+	}
+	release(pos->second);
+	roots.erase(pos);
+	return true;
+}
+
+Operand ExpressionPool::at(string name) const {
+	auto pos = roots.find(name);
+	if (pos == roots.end()) {
+		return Operand::undef();
+	}
+	return pos->second;
+}
+
+Expression ExpressionPool::get(string name) const {
+	Expression result;
+	result.top = at(name);
+	if (not result.top.isExpr()) {
+		return result;
+	}
+
+	Mapping<size_t> m(std::numeric_limits<size_t>::max(), false);
+	for (ConstUpIterator i(*this, {result.top}); not i.done(); ++i) {
+		m.set(i->op().index, result.pushExpr(Operation(*i).applyExprs(m)).index);
+	}
+	result.top.applyExprs(m);
+	return result;
+}
+
+size_t ExpressionPool::collect() {
+	vector<size_t> dead;
+	vector<Operand> index = sub.exprIndex();
+	for (auto i = index.begin(); i != index.end(); i++) {
+		if (refs[i->index] == 0u) {
+			dead.push_back(i->index);
+		}
+	}
+
+	size_t count = 0;
+	while (not dead.empty()) {
+		size_t curr = dead.back();
+		dead.pop_back();
+
+		auto range = table.equal_range(hashes[curr]);
+		for (auto i = range.first; i != range.second; i++) {
+			if (i->second == curr) {
+				table.erase(i);
+				break;
+			}
+		}
+
+		vector<Operand> operands = sub.getExpr(curr)->operands;
+		sub.eraseExpr(curr);
+		count++;
+		for (auto i = operands.begin(); i != operands.end(); i++) {
+			if (i->isExpr() and --refs[i->index] == 0u) {
+				dead.push_back(i->index);
+			}
+		}
+	}
+	return count;
+}
+
+map<string, ValRef> ExpressionPool::evaluate(const State &values, TypeSet types) const {
+	TraceScope trace("ExpressionPool::evaluate");
+
+	vector<Operand> tops;
+	tops.reserve(roots.size());
+	for (auto i = roots.begin(); i != roots.end(); i++) {
+		if (i->second.isExpr()) {
+			tops.push_back(i->second);
+		}
+	}
+
+	vector<ValRef> exprs;
+	for (ConstUpIterator i(*this, tops); not i.done(); ++i) {
+		if (i->exprIndex >= exprs.size()) {
+			exprs.resize(i->exprIndex+1, Value::X());
+		}
+		exprs[i->exprIndex] = i->evaluate(values, exprs, types);
+	}
+
+	map<string, ValRef> result;
+	for (auto i = roots.begin(); i != roots.end(); i++) {
+		if (i->second.isExpr()) {
+			result.insert({i->first, exprs[i->second.index]});
+		} else {
+			result.insert({i->first, i->second.get(values)});
+		}
+	}
+	return result;
+}
+
+}
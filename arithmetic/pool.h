@@ -0,0 +1,73 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include <unordered_map>
+
+#include "expression.h"
+#include "state.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) An ExpressionPool holds many expressions in a single
+// operation set so that they can share their common subexpressions. Every
+// operation is hash-consed as it is added, which means that an operation is
+// only ever stored once: adding an operation that is already in the pool
+// returns the existing one. Operands of commutative operations are put into a
+// canonical order first so that (a+b) and (b+a) are the same operation.
+//
+// Each operation counts the number of references to it from other operations
+// and from the roots. Releasing a root only drops its count. The operations
+// that nothing references anymore stay in the pool, where they can still be
+// reused by the next insert, until collect() removes them.
+struct ExpressionPool {
+	ExpressionPool();
+	~ExpressionPool();
+
+	SimpleOperationSet sub;
+	// references to each operation by exprIndex
+	vector<size_t> refs;
+	// structural hash of each operation by exprIndex
+	vector<size_t> hashes;
+	// from structural hash to exprIndex
+	std::unordered_multimap<size_t, size_t> table;
+
+	// the named roots
+	map<string, Operand> roots;
+
+	// ConstOperationSet
+	vector<Operand> exprIndex() const;
+	const Operation *getExpr(size_t index) const;
+
+	// The number of operations in the pool
+	size_t size() const;
+
+	// Add a single operation whose operands are already in the pool. Returns
+	// the operation that is structurally identical to o.
+	Operand intern(Operation o);
+	// Add a whole expression. The result is not referenced by anything until
+	// it is set as a root or acquired.
+	Operand insert(const Expression &e);
+
+	void acquire(Operand op);
+	void release(Operand op);
+
+	// Set the root called name to e, replacing what was there before
+	Operand set(string name, const Expression &e);
+	// Returns false if there was no root called name
+	bool erase(string name);
+	// Returns undef if there is no root called name
+	Operand at(string name) const;
+	// Copy the root called name out of the pool
+	Expression get(string name) const;
+
+	// Remove every operation that is no longer referenced. Returns the number
+	// of operations removed.
+	size_t collect();
+
+	// Evaluate every root against one state. Each operation is evaluated once
+	// no matter how many roots share it.
+	map<string, ValRef> evaluate(const State &values, TypeSet types=TypeSet()) const;
+};
+
+}
@@ -21,7 +21,10 @@ Rule::~Rule() {
 RuleSet::RuleSet() {
 }
 
-RuleSet::RuleSet(std::initializer_list<Expression> lst) {
+RuleSet::RuleSet(std::initializer_list<Expression> lst) : RuleSet(vector<Expression>(lst)) {
+}
+
+RuleSet::RuleSet(const vector<Expression> &lst) {
 	for (auto e = lst.begin(); e != lst.end(); e++) {
 		if (not verifyRuleFormat(*e, e->top, true)) {
 			continue;
@@ -42,6 +45,7 @@ RuleSet::RuleSet(std::initializer_list<Expression> lst) {
 		i->left = m.map(i->left);
 		i->right = m.map(i->right);
 	}
+	automaton.compile(sub, rules);
 }
 
 RuleSet::~RuleSet() {
@@ -75,6 +79,7 @@ RuleSet &RuleSet::operator+=(const RuleSet &r1) {
 		r.right.applyExprs(m);
 		rules.push_back(r);
 	}
+	automaton.compile(sub, rules);
 	return *this;
 }
 
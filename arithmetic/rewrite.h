@@ -1,6 +1,7 @@
 #pragma once
 
 #include "operation_set.h"
+#include "automaton.h"
 
 namespace arithmetic {
 
@@ -19,11 +20,14 @@ struct Rule {
 struct RuleSet {
 	RuleSet();
 	RuleSet(std::initializer_list<Expression> lst);
+	RuleSet(const vector<Expression> &lst);
 	~RuleSet();
 
 	// All rewrites on only constants handled explicitly (without rewrite rules, using value)
 	SimpleOperationSet sub;
 	vector<Rule> rules;
+	// compiled from sub and rules to find where each rule may match
+	Automaton automaton;
 
 	bool empty() const;
 	vector<Operand> top() const;
@@ -0,0 +1,568 @@
+#include "serialize.h"
+
+#include <cstring>
+#include <fstream>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace arithmetic {
+
+const char Serial::magic[4] = {'A', 'R', 'T', 'H'};
+const uint32_t Serial::version = 1;
+
+Encoder::Encoder() {
+}
+
+Encoder::~Encoder() {
+}
+
+void Encoder::header(Serial::Kind kind) {
+	data.append(Serial::magic, 4);
+	u32(Serial::version);
+	u32(kind);
+}
+
+void Encoder::u8(uint8_t v) {
+	data.push_back((char)v);
+}
+
+void Encoder::u32(uint32_t v) {
+	for (int i = 0; i < 4; i++) {
+		data.push_back((char)((v >> (8*i)) & 0xFF));
+	}
+}
+
+void Encoder::u64(uint64_t v) {
+	for (int i = 0; i < 8; i++) {
+		data.push_back((char)((v >> (8*i)) & 0xFF));
+	}
+}
+
+void Encoder::i64(int64_t v) {
+	u64((uint64_t)v);
+}
+
+void Encoder::f64(double v) {
+	uint64_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	u64(bits);
+}
+
+void Encoder::str(const string &v) {
+	u32((uint32_t)v.size());
+	data.append(v);
+}
+
+Decoder::Decoder(const char *data, size_t size) {
+	this->data = data;
+	this->size = size;
+	this->pos = 0;
+	this->valid = true;
+	this->maxHoles = 65536;
+	this->maxDepth = 64;
+	this->depth = 0;
+}
+
+Decoder::~Decoder() {
+}
+
+bool Decoder::has(size_t bytes) {
+	if (not valid or bytes > size-pos) {
+		valid = false;
+	}
+	return valid;
+}
+
+bool Decoder::header(Serial::Kind kind) {
+	if (not has(4) or memcmp(data+pos, Serial::magic, 4) != 0) {
+		printf("error: not an arithmetic binary file\n");
+		valid = false;
+		return false;
+	}
+	pos += 4;
+
+	uint32_t v = u32();
+	if (valid and v != Serial::version) {
+		printf("error: unsupported binary format version %u, expected %u\n", v, Serial::version);
+		valid = false;
+		return false;
+	}
+
+	uint32_t k = u32();
+	if (valid and k != (uint32_t)kind) {
+		printf("error: binary file holds kind %u, expected %u\n", k, (uint32_t)kind);
+		valid = false;
+		return false;
+	}
+	return valid;
+}
+
+uint8_t Decoder::u8() {
+	if (not has(1)) {
+		return 0;
+	}
+	return (uint8_t)data[pos++];
+}
+
+uint32_t Decoder::u32() {
+	if (not has(4)) {
+		return 0;
+	}
+	uint32_t v = 0;
+	for (int i = 0; i < 4; i++) {
+		v |= ((uint32_t)(uint8_t)data[pos++]) << (8*i);
+	}
+	return v;
+}
+
+uint64_t Decoder::u64() {
+	if (not has(8)) {
+		return 0;
+	}
+	uint64_t v = 0;
+	for (int i = 0; i < 8; i++) {
+		v |= ((uint64_t)(uint8_t)data[pos++]) << (8*i);
+	}
+	return v;
+}
+
+int64_t Decoder::i64() {
+	return (int64_t)u64();
+}
+
+double Decoder::f64() {
+	uint64_t bits = u64();
+	double v;
+	memcpy(&v, &bits, sizeof(v));
+	return v;
+}
+
+string Decoder::str() {
+	uint32_t n = u32();
+	if (not has(n)) {
+		return string();
+	}
+	string v(data+pos, n);
+	pos += n;
+	return v;
+}
+
+void encode(Encoder &enc, const Value &v) {
+	enc.u32((uint32_t)v.type);
+	enc.u8((uint8_t)v.state);
+	if (v.type == Value::BOOL) {
+		enc.u8(v.bval);
+	} else if (v.type == Value::INT) {
+		enc.i64(v.ival);
+	} else if (v.type == Value::REAL) {
+		enc.f64(v.rval);
+	}
+
+	if (v.type == Value::STRING or v.type >= Value::STRUCT) {
+		enc.str(v.sval);
+	}
+
+	if (v.type == Value::ARRAY or v.type >= Value::STRUCT) {
+		enc.u32((uint32_t)v.arr.size());
+		for (auto i = v.arr.begin(); i != v.arr.end(); i++) {
+			encode(enc, *i);
+		}
+	}
+}
+
+void encode(Encoder &enc, const State &s) {
+	enc.u32((uint32_t)s.values.size());
+	for (auto i = s.values.begin(); i != s.values.end(); i++) {
+		encode(enc, *i);
+	}
+}
+
+void encode(Encoder &enc, const Region &r) {
+	enc.u32((uint32_t)r.states.size());
+	for (auto i = r.states.begin(); i != r.states.end(); i++) {
+		encode(enc, *i);
+	}
+}
+
+void encode(Encoder &enc, const Operand &o) {
+	enc.u8((uint8_t)(int8_t)o.type);
+	if (o.isConst()) {
+		encode(enc, o.cnst);
+	} else if (not o.isUndef()) {
+		enc.u64(o.index);
+	}
+}
+
+void encode(Encoder &enc, const Operation &o) {
+	enc.u64(o.exprIndex);
+	enc.u32((uint32_t)o.func);
+	enc.u32((uint32_t)o.operands.size());
+	for (auto i = o.operands.begin(); i != o.operands.end(); i++) {
+		encode(enc, *i);
+	}
+}
+
+void encode(Encoder &enc, const SimpleOperationSet &ops) {
+	enc.u32((uint32_t)ops.elems.count());
+	for (auto i = ops.elems.begin(); i != ops.elems.end(); i++) {
+		encode(enc, *i);
+	}
+}
+
+void encode(Encoder &enc, const Expression &e) {
+	encode(enc, e.sub);
+	encode(enc, e.top);
+}
+
+void encode(Encoder &enc, const RuleSet &r) {
+	encode(enc, r.sub);
+	enc.u32((uint32_t)r.rules.size());
+	for (auto i = r.rules.begin(); i != r.rules.end(); i++) {
+		encode(enc, i->left);
+		encode(enc, i->right);
+		enc.u8(i->directed);
+	}
+}
+
+bool decode(Decoder &dec, Value &v) {
+	v = Value();
+	int32_t type = (int32_t)dec.u32();
+	int8_t state = (int8_t)dec.u8();
+	if (not dec.valid) {
+		return false;
+	} else if (type < Value::UNDEF) {
+		printf("error: invalid value type %d\n", type);
+		dec.valid = false;
+		return false;
+	} else if (state < Value::UNSTABLE or state > Value::UNKNOWN) {
+		printf("error: invalid value state %d\n", state);
+		dec.valid = false;
+		return false;
+	}
+	v.type = (Value::ValType)type;
+	v.state = (Value::StateType)state;
+
+	if (v.type == Value::BOOL) {
+		v.bval = dec.u8() != 0;
+	} else if (v.type == Value::INT) {
+		v.ival = dec.i64();
+	} else if (v.type == Value::REAL) {
+		v.rval = dec.f64();
+	}
+
+	if (v.type == Value::STRING or v.type >= Value::STRUCT) {
+		v.sval = dec.str();
+	}
+
+	if (v.type == Value::ARRAY or v.type >= Value::STRUCT) {
+		if (dec.depth >= dec.maxDepth) {
+			printf("error: values nested deeper than %lu\n", dec.maxDepth);
+			dec.valid = false;
+			return false;
+		}
+		dec.depth++;
+		uint32_t n = dec.u32();
+		for (uint32_t i = 0; i < n and dec.valid; i++) {
+			v.arr.push_back(Value());
+			decode(dec, v.arr.back());
+		}
+		dec.depth--;
+	}
+	return dec.valid;
+}
+
+bool decode(Decoder &dec, State &s) {
+	s.values.clear();
+	uint32_t n = dec.u32();
+	for (uint32_t i = 0; i < n and dec.valid; i++) {
+		s.values.push_back(Value());
+		decode(dec, s.values.back());
+	}
+	return dec.valid;
+}
+
+bool decode(Decoder &dec, Region &r) {
+	r.states.clear();
+	uint32_t n = dec.u32();
+	for (uint32_t i = 0; i < n and dec.valid; i++) {
+		r.states.push_back(State());
+		decode(dec, r.states.back());
+	}
+	return dec.valid;
+}
+
+bool decode(Decoder &dec, Operand &o) {
+	o = Operand();
+	int8_t type = (int8_t)dec.u8();
+	if (not dec.valid) {
+		return false;
+	} else if (type < Operand::UNDEF or type > Operand::TYPE) {
+		printf("error: invalid operand type %d\n", type);
+		dec.valid = false;
+		return false;
+	}
+	o.type = (Operand::Type)type;
+
+	if (o.isConst()) {
+		decode(dec, o.cnst);
+	} else if (not o.isUndef()) {
+		o.index = dec.u64();
+	}
+	return dec.valid;
+}
+
+bool decode(Decoder &dec, Operation &o) {
+	Operation::loadOperators();
+
+	o.exprIndex = dec.u64();
+	int32_t func = (int32_t)dec.u32();
+	if (not dec.valid) {
+		return false;
+	} else if (func != Operation::UNDEF and (func < 0 or not Operation::operators.is_valid(func))) {
+		printf("error: invalid operator %d\n", func);
+		dec.valid = false;
+		return false;
+	}
+	o.func = (Operation::OpType)func;
+
+	o.operands.clear();
+	uint32_t n = dec.u32();
+	for (uint32_t i = 0; i < n and dec.valid; i++) {
+		o.operands.push_back(Operand());
+		decode(dec, o.operands.back());
+	}
+	return dec.valid;
+}
+
+// Make sure that an operand only refers to operations that were decoded
+static bool verify(Decoder &dec, const SimpleOperationSet &ops, const Operand &o) {
+	if (dec.valid and o.isExpr() and ops.getExpr(o.index) == nullptr) {
+		printf("error: operand refers to missing operation %lu\n", o.index);
+		dec.valid = false;
+	}
+	return dec.valid;
+}
+
+bool decode(Decoder &dec, SimpleOperationSet &ops) {
+	ops.clear();
+	uint32_t n = dec.u32();
+	// every operation takes at least 16 bytes
+	if (dec.valid and n > (dec.size-dec.pos)/16) {
+		printf("error: %u operations don't fit in the data\n", n);
+		dec.valid = false;
+		return false;
+	}
+
+	Operation o;
+	for (uint32_t i = 0; i < n and dec.valid; i++) {
+		if (not decode(dec, o)) {
+			break;
+		} else if (o.exprIndex >= (size_t)n + dec.maxHoles) {
+			printf("error: operation index %lu is out of range\n", o.exprIndex);
+			dec.valid = false;
+			break;
+		}
+		ops.setExpr(o);
+	}
+
+	for (auto i = ops.elems.begin(); i != ops.elems.end() and dec.valid; i++) {
+		for (auto j = i->operands.begin(); j != i->operands.end() and dec.valid; j++) {
+			verify(dec, ops, *j);
+		}
+	}
+	return dec.valid;
+}
+
+bool decode(Decoder &dec, Expression &e) {
+	decode(dec, e.sub);
+	decode(dec, e.top);
+	verify(dec, e.sub, e.top);
+	return dec.valid;
+}
+
+bool decode(Decoder &dec, RuleSet &r) {
+	decode(dec, r.sub);
+	r.rules.clear();
+	uint32_t n = dec.u32();
+	for (uint32_t i = 0; i < n and dec.valid; i++) {
+		Rule rule;
+		decode(dec, rule.left);
+		decode(dec, rule.right);
+		rule.directed = dec.u8() != 0;
+		verify(dec, r.sub, rule.left);
+		verify(dec, r.sub, rule.right);
+		r.rules.push_back(rule);
+	}
+	if (not dec.valid) {
+		r.rules.clear();
+	}
+	r.automaton.compile(r.sub, r.rules);
+	return dec.valid;
+}
+
+MappedFile::MappedFile(string path) {
+	data = nullptr;
+	size = 0;
+
+#ifdef WIN32
+	std::ifstream fin(path.c_str(), std::ios::binary);
+	if (not fin.is_open()) {
+		return;
+	}
+	contents.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+	if (fin.bad() or contents.empty()) {
+		contents.clear();
+		return;
+	}
+	data = contents.data();
+	size = contents.size();
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 and info.st_size > 0) {
+		void *ptr = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED) {
+			data = (const char*)ptr;
+			size = (size_t)info.st_size;
+		}
+	}
+	close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef WIN32
+	if (data != nullptr) {
+		munmap((void*)data, size);
+	}
+#endif
+}
+
+bool MappedFile::isOpen() const {
+	return data != nullptr;
+}
+
+string serialize(const State &s) {
+	Encoder enc;
+	enc.header(Serial::STATE);
+	encode(enc, s);
+	return enc.data;
+}
+
+string serialize(const Region &r) {
+	Encoder enc;
+	enc.header(Serial::REGION);
+	encode(enc, r);
+	return enc.data;
+}
+
+string serialize(const SimpleOperationSet &ops) {
+	Encoder enc;
+	enc.header(Serial::OPERATION_SET);
+	encode(enc, ops);
+	return enc.data;
+}
+
+string serialize(const Expression &e) {
+	Encoder enc;
+	enc.header(Serial::EXPRESSION);
+	encode(enc, e);
+	return enc.data;
+}
+
+string serialize(const RuleSet &r) {
+	Encoder enc;
+	enc.header(Serial::RULE_SET);
+	encode(enc, r);
+	return enc.data;
+}
+
+bool deserialize(const char *data, size_t size, State &s) {
+	Decoder dec(data, size);
+	return dec.header(Serial::STATE) and decode(dec, s);
+}
+
+bool deserialize(const char *data, size_t size, Region &r) {
+	Decoder dec(data, size);
+	return dec.header(Serial::REGION) and decode(dec, r);
+}
+
+bool deserialize(const char *data, size_t size, SimpleOperationSet &ops) {
+	Decoder dec(data, size);
+	return dec.header(Serial::OPERATION_SET) and decode(dec, ops);
+}
+
+bool deserialize(const char *data, size_t size, Expression &e) {
+	Decoder dec(data, size);
+	return dec.header(Serial::EXPRESSION) and decode(dec, e);
+}
+
+bool deserialize(const char *data, size_t size, RuleSet &r) {
+	Decoder dec(data, size);
+	return dec.header(Serial::RULE_SET) and decode(dec, r);
+}
+
+bool writeFile(string path, const string &data) {
+	std::ofstream fout(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (not fout.is_open()) {
+		printf("error: unable to open '%s' for writing\n", path.c_str());
+		return false;
+	}
+	fout.write(data.data(), data.size());
+	return fout.good();
+}
+
+bool save(string path, const State &s) {
+	return writeFile(path, serialize(s));
+}
+
+bool save(string path, const Region &r) {
+	return writeFile(path, serialize(r));
+}
+
+bool save(string path, const SimpleOperationSet &ops) {
+	return writeFile(path, serialize(ops));
+}
+
+bool save(string path, const Expression &e) {
+	return writeFile(path, serialize(e));
+}
+
+bool save(string path, const RuleSet &r) {
+	return writeFile(path, serialize(r));
+}
+
+bool load(string path, State &s) {
+	MappedFile file(path);
+	return file.isOpen() and deserialize(file.data, file.size, s);
+}
+
+bool load(string path, Region &r) {
+	MappedFile file(path);
+	return file.isOpen() and deserialize(file.data, file.size, r);
+}
+
+bool load(string path, SimpleOperationSet &ops) {
+	MappedFile file(path);
+	return file.isOpen() and deserialize(file.data, file.size, ops);
+}
+
+bool load(string path, Expression &e) {
+	MappedFile file(path);
+	return file.isOpen() and deserialize(file.data, file.size, e);
+}
+
+bool load(string path, RuleSet &r) {
+	MappedFile file(path);
+	return file.isOpen() and deserialize(file.data, file.size, r);
+}
+
+}
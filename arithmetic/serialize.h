@@ -0,0 +1,146 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include "value.h"
+#include "state.h"
+#include "operation_set.h"
+#include "rewrite.h"
+#include "expression.h"
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) The binary format is a small header followed by a
+// payload. The header is the magic "ARTH", a format version, and the kind of
+// object stored. Integers and doubles are stored in little-endian byte order.
+// Strings and lists are stored as a 32-bit length followed by their contents.
+// Expressions are stored by their exprIndex so that indices are preserved,
+// and rule sets are stored after tidy() so loading them doesn't need to redo
+// any of that work.
+struct Serial {
+	enum Kind : uint32_t {
+		VALUE = 0,
+		STATE = 1,
+		REGION = 2,
+		OPERATION_SET = 3,
+		EXPRESSION = 4,
+		RULE_SET = 5,
+	};
+
+	static const char magic[4];
+	static const uint32_t version;
+};
+
+struct Encoder {
+	Encoder();
+	~Encoder();
+
+	string data;
+
+	void header(Serial::Kind kind);
+
+	void u8(uint8_t v);
+	void u32(uint32_t v);
+	void u64(uint64_t v);
+	void i64(int64_t v);
+	void f64(double v);
+	void str(const string &v);
+};
+
+struct Decoder {
+	Decoder(const char *data, size_t size);
+	~Decoder();
+
+	const char *data;
+	size_t size;
+	size_t pos;
+
+	// false once anything fails to decode, every read after that returns 0
+	bool valid;
+
+	// Limits on what the data may ask for, so that corrupt or hostile input
+	// is rejected instead of allocating without bound. An operation set with
+	// n operations may only use exprIndex values below n+maxHoles, and
+	// maxDepth bounds the nesting of arrays and structures.
+	size_t maxHoles;
+	size_t maxDepth;
+	size_t depth;
+
+	bool header(Serial::Kind kind);
+
+	uint8_t u8();
+	uint32_t u32();
+	uint64_t u64();
+	int64_t i64();
+	double f64();
+	string str();
+
+	bool has(size_t bytes);
+};
+
+void encode(Encoder &enc, const Value &v);
+void encode(Encoder &enc, const State &s);
+void encode(Encoder &enc, const Region &r);
+void encode(Encoder &enc, const Operand &o);
+void encode(Encoder &enc, const Operation &o);
+void encode(Encoder &enc, const SimpleOperationSet &ops);
+void encode(Encoder &enc, const Expression &e);
+void encode(Encoder &enc, const RuleSet &r);
+
+bool decode(Decoder &dec, Value &v);
+bool decode(Decoder &dec, State &s);
+bool decode(Decoder &dec, Region &r);
+bool decode(Decoder &dec, Operand &o);
+bool decode(Decoder &dec, Operation &o);
+bool decode(Decoder &dec, SimpleOperationSet &ops);
+bool decode(Decoder &dec, Expression &e);
+bool decode(Decoder &dec, RuleSet &r);
+
+// A read-only memory map of a file. Loading decodes straight out of the
+// mapped pages without reading the file into a buffer first. On Windows, the
+// file is read into contents instead.
+struct MappedFile {
+	MappedFile(string path);
+	~MappedFile();
+
+	// the mapping, or the buffer that data points into, belongs to this
+	// object alone
+	MappedFile(const MappedFile&) = delete;
+	MappedFile &operator=(const MappedFile&) = delete;
+
+	const char *data;
+	size_t size;
+	string contents;
+
+	bool isOpen() const;
+};
+
+bool writeFile(string path, const string &data);
+
+// Serialize to and from memory, including the header
+string serialize(const State &s);
+string serialize(const Region &r);
+string serialize(const SimpleOperationSet &ops);
+string serialize(const Expression &e);
+string serialize(const RuleSet &r);
+
+bool deserialize(const char *data, size_t size, State &s);
+bool deserialize(const char *data, size_t size, Region &r);
+bool deserialize(const char *data, size_t size, SimpleOperationSet &ops);
+bool deserialize(const char *data, size_t size, Expression &e);
+bool deserialize(const char *data, size_t size, RuleSet &r);
+
+// Serialize to and from files
+bool save(string path, const State &s);
+bool save(string path, const Region &r);
+bool save(string path, const SimpleOperationSet &ops);
+bool save(string path, const Expression &e);
+bool save(string path, const RuleSet &r);
+
+bool load(string path, State &s);
+bool load(string path, Region &r);
+bool load(string path, SimpleOperationSet &ops);
+bool load(string path, Expression &e);
+bool load(string path, RuleSet &r);
+
+}
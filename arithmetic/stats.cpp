@@ -0,0 +1,123 @@
+#include "stats.h"
+#include "rewrite.h"
+#include "algorithm.h"
+
+#include <algorithm>
+
+namespace arithmetic {
+
+RuleStats::RuleStats() {
+	attempts = 0;
+	matches = 0;
+	seconds = 0.0;
+}
+
+RuleStats::~RuleStats() {
+}
+
+RuleStats &RuleStats::operator+=(const RuleStats &r) {
+	attempts += r.attempts;
+	matches += r.matches;
+	seconds += r.seconds;
+	return *this;
+}
+
+RewriteStats::RewriteStats() {
+	clear();
+}
+
+RewriteStats::~RewriteStats() {
+}
+
+bool RewriteStats::enabled() {
+#ifdef ARITHMETIC_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+RuleStats &RewriteStats::rule(size_t index) {
+	if (index >= rules.size()) {
+		rules.resize(index+1);
+	}
+	return rules[index];
+}
+
+void RewriteStats::clear() {
+	rules.clear();
+	searches = 0;
+	seeds = 0;
+	peakDepth = 0;
+	peakLeaves = 0;
+	replaces = 0;
+	tidies = 0;
+	nodesBefore = 0;
+	nodesAfter = 0;
+	seconds = 0.0;
+}
+
+RewriteStats &RewriteStats::operator+=(const RewriteStats &s) {
+	for (size_t i = 0; i < s.rules.size(); i++) {
+		rule(i) += s.rules[i];
+	}
+	searches += s.searches;
+	seeds += s.seeds;
+	peakDepth = std::max(peakDepth, s.peakDepth);
+	peakLeaves = std::max(peakLeaves, s.peakLeaves);
+	replaces += s.replaces;
+	tidies += s.tidies;
+	nodesBefore += s.nodesBefore;
+	nodesAfter += s.nodesAfter;
+	seconds += s.seconds;
+	return *this;
+}
+
+void RewriteStats::print(ostream &os, const RuleSet &rules) const {
+	if (not enabled()) {
+		os << "rewrite statistics are disabled, rebuild with STATS=1" << endl;
+		return;
+	}
+
+	vector<size_t> order;
+	for (size_t i = 0; i < this->rules.size(); i++) {
+		if (this->rules[i].attempts > 0) {
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return this->rules[a].seconds > this->rules[b].seconds;
+	});
+
+	char line[256];
+	snprintf(line, sizeof(line), "%6s %-48s %10s %10s %12s", "rule", "", "attempts", "matches", "time (ms)");
+	os << line << endl;
+	for (auto i = order.begin(); i != order.end(); i++) {
+		string name;
+		if (*i < rules.rules.size()) {
+			const Rule &r = rules.rules[*i];
+			name = to_string(rules.sub, r.left, false) + (r.directed ? " > " : " = ") + to_string(rules.sub, r.right, false);
+		}
+		if (name.size() > 48u) {
+			name = name.substr(0, 45) + "...";
+		}
+		const RuleStats &s = this->rules[*i];
+		snprintf(line, sizeof(line), "%6zu %-48s %10zu %10zu %12.3f", *i, name.c_str(), s.attempts, s.matches, s.seconds*1e3);
+		os << line << endl;
+	}
+	os << *this;
+}
+
+ostream &operator<<(ostream &os, const RewriteStats &s) {
+	os << "searches: " << s.searches << " seeds: " << s.seeds << " peak depth: " << s.peakDepth << " peak leaves: " << s.peakLeaves << endl;
+	os << "replaces: " << s.replaces << " tidies: " << s.tidies << endl;
+	os << "nodes: " << s.nodesBefore << " -> " << s.nodesAfter << endl;
+	os << "time: " << s.seconds*1e3 << "ms" << endl;
+	return os;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point t) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include <chrono>
+#include <ostream>
+
+namespace arithmetic {
+
+struct RuleSet;
+
+// DESIGN(edward.bingham) The rewrite engine is instrumented with
+// REWRITE_STATS(...), which expands to its arguments only when the library is
+// built with ARITHMETIC_STATS defined (make STATS=1). Otherwise it expands to
+// nothing, so the hot paths in the matcher carry no counters, no clock reads,
+// and no branches. RewriteStats itself is always available so that callers
+// don't need to change depending on the build, it just stays empty.
+#ifdef ARITHMETIC_STATS
+#define REWRITE_STATS(...) __VA_ARGS__
+#else
+#define REWRITE_STATS(...)
+#endif
+
+struct RuleStats {
+	RuleStats();
+	~RuleStats();
+
+	// The number of times the automaton accepted the rule at a seed and its
+	// top matched
+	size_t attempts;
+	// The number of matches found
+	size_t matches;
+	// Time spent searching for matches of this rule in seconds
+	double seconds;
+
+	RuleStats &operator+=(const RuleStats &r);
+};
+
+struct RewriteStats {
+	RewriteStats();
+	~RewriteStats();
+
+	// indexed by rule in the RuleSet, both directions are counted together
+	vector<RuleStats> rules;
+
+	// calls to search() and searchAt()
+	size_t searches;
+	// the number of seeds the matcher was started from
+	size_t seeds;
+	// the deepest the matcher's depth first search went
+	size_t peakDepth;
+	// the most rule leaves pending on the matcher's stack at once
+	size_t peakLeaves;
+
+	// calls to replace() and tidy()
+	size_t replaces;
+	size_t tidies;
+
+	// operations in the expression before and after minimize()
+	size_t nodesBefore;
+	size_t nodesAfter;
+
+	// total wall time in minimize() in seconds
+	double seconds;
+
+	static bool enabled();
+
+	RuleStats &rule(size_t index);
+	void clear();
+
+	RewriteStats &operator+=(const RewriteStats &s);
+
+	// Print a table of the rules sorted by the time spent on them, followed by
+	// the totals. Rules that were never attempted are left out.
+	void print(ostream &os, const RuleSet &rules) const;
+};
+
+ostream &operator<<(ostream &os, const RewriteStats &s);
+
+// Seconds since t
+double secondsSince(std::chrono::steady_clock::time_point t);
+
+}
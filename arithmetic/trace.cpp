@@ -0,0 +1,240 @@
+#include "trace.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace arithmetic {
+
+std::atomic<bool> traceEnabled(false);
+
+namespace {
+
+int64_t clockNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct TraceRegistry {
+	std::mutex lock;
+	vector<std::unique_ptr<TraceBuffer> > buffers;
+	// buffers whose thread has exited, ready to be handed to the next thread
+	vector<TraceBuffer*> free;
+	string path;
+	size_t capacity = 65536;
+	bool registered = false;
+	// steady clock nanoseconds at the last traceStart()
+	std::atomic<int64_t> epoch;
+	std::atomic<uint64_t> generation;
+
+	TraceRegistry() : epoch(clockNow()), generation(0) {}
+};
+
+// DESIGN(edward.bingham) The registry is never destroyed so that it is
+// still there for the exit handler and for threads that outlive main().
+TraceRegistry &registry() {
+	static TraceRegistry *r = new TraceRegistry();
+	return *r;
+}
+
+// DESIGN(edward.bingham) search() and minimizeAll() start new threads on
+// every call, so a buffer can't belong to a thread forever. When a thread
+// exits, its buffer goes back on the free list with its events intact, and
+// the next new thread picks it up and continues the ring. The number of
+// buffers is bounded by the number of threads that are tracing at the same
+// time, and a tid in the output is a buffer rather than an OS thread.
+struct LocalBuffer {
+	LocalBuffer() {
+		buffer = nullptr;
+	}
+
+	~LocalBuffer() {
+		if (buffer != nullptr) {
+			TraceRegistry &r = registry();
+			std::lock_guard<std::mutex> guard(r.lock);
+			r.free.push_back(buffer);
+		}
+	}
+
+	TraceBuffer *buffer;
+};
+
+thread_local LocalBuffer localBuffer;
+
+TraceBuffer *threadBuffer() {
+	if (localBuffer.buffer == nullptr) {
+		TraceRegistry &r = registry();
+		std::lock_guard<std::mutex> guard(r.lock);
+		if (not r.free.empty()) {
+			localBuffer.buffer = r.free.back();
+			r.free.pop_back();
+			// the capacity only changes in traceStart(), so a buffer of the wrong
+			// size only holds events from an earlier trace
+			localBuffer.buffer->reset(r.capacity);
+		} else {
+			r.buffers.push_back(std::unique_ptr<TraceBuffer>(new TraceBuffer(r.buffers.size(), r.capacity)));
+			localBuffer.buffer = r.buffers.back().get();
+		}
+	}
+	return localBuffer.buffer;
+}
+
+void traceAtExit() {
+	if (tracing()) {
+		traceStop();
+	}
+}
+
+struct TraceFromEnvironment {
+	TraceFromEnvironment() {
+		const char *path = getenv("ARITHMETIC_TRACE");
+		if (path != nullptr and path[0] != '\0') {
+			traceStart(path);
+		}
+	}
+} traceFromEnvironment;
+
+}
+
+TraceBuffer::TraceBuffer(size_t tid, size_t capacity) : tid(tid), events(std::max(capacity, (size_t)1)), written(0) {
+}
+
+TraceBuffer::~TraceBuffer() {
+}
+
+TraceSlot::TraceSlot() : seq(0), name(nullptr), begin(0), duration(0), generation(0) {
+}
+
+TraceSlot::~TraceSlot() {
+}
+
+// The buffer isn't owned by any thread while it is being reset
+void TraceBuffer::reset(size_t capacity) {
+	capacity = std::max(capacity, (size_t)1);
+	if (capacity != events.size()) {
+		events = vector<TraceSlot>(capacity);
+		written.store(0, std::memory_order_relaxed);
+	}
+}
+
+void TraceBuffer::push(TraceEvent event) {
+	uint64_t n = written.load(std::memory_order_relaxed);
+	TraceSlot &slot = events[n%events.size()];
+	slot.seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name.store(event.name, std::memory_order_relaxed);
+	slot.begin.store(event.begin, std::memory_order_relaxed);
+	slot.duration.store(event.duration, std::memory_order_relaxed);
+	slot.generation.store(event.generation, std::memory_order_relaxed);
+	slot.seq.store(n+1, std::memory_order_release);
+	written.store(n+1, std::memory_order_release);
+}
+
+void TraceBuffer::write(ostream &os, bool &first, uint64_t generation) const {
+	uint64_t n = written.load(std::memory_order_acquire);
+	uint64_t from = n > events.size() ? n-events.size() : 0;
+	char line[256];
+	for (uint64_t i = from; i < n; i++) {
+		const TraceSlot &slot = events[i%events.size()];
+		if (slot.seq.load(std::memory_order_acquire) != i+1) {
+			continue;
+		}
+		TraceEvent e;
+		e.name = slot.name.load(std::memory_order_relaxed);
+		e.begin = slot.begin.load(std::memory_order_relaxed);
+		e.duration = slot.duration.load(std::memory_order_relaxed);
+		e.generation = slot.generation.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		// the owning thread overwrote the slot while it was being read
+		if (slot.seq.load(std::memory_order_relaxed) != i+1 or e.generation != generation) {
+			continue;
+		}
+
+		snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"arithmetic\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%zu}",
+			e.name, (double)e.begin*1e-3, (double)e.duration*1e-3, tid);
+		os << (first ? "" : ",\n") << line;
+		first = false;
+	}
+}
+
+void traceStart(string path, size_t capacity) {
+	TraceRegistry &r = registry();
+	{
+		std::lock_guard<std::mutex> guard(r.lock);
+		r.path = path;
+		// buffers already handed out keep their size
+		r.capacity = capacity;
+		// events from earlier traces are left where they are and skipped
+		r.generation.fetch_add(1);
+		r.epoch.store(clockNow());
+		if (not r.registered) {
+			atexit(traceAtExit);
+			r.registered = true;
+		}
+	}
+	traceEnabled.store(true);
+}
+
+bool traceStop() {
+	traceEnabled.store(false);
+	TraceRegistry &r = registry();
+	string path;
+	{
+		std::lock_guard<std::mutex> guard(r.lock);
+		path = r.path;
+	}
+	std::ofstream fout(path.c_str());
+	if (not fout.is_open()) {
+		printf("error: unable to open trace file '%s'\n", path.c_str());
+		return false;
+	}
+	traceWrite(fout);
+	return true;
+}
+
+void traceWrite(ostream &os) {
+	TraceRegistry &r = registry();
+	std::lock_guard<std::mutex> guard(r.lock);
+	os << "{\"traceEvents\":[" << endl;
+	bool first = true;
+	uint64_t generation = r.generation.load();
+	for (auto i = r.buffers.begin(); i != r.buffers.end(); i++) {
+		(*i)->write(os, first, generation);
+	}
+	os << endl << "],\"displayTimeUnit\":\"ns\"}" << endl;
+}
+
+size_t traceBuffers() {
+	TraceRegistry &r = registry();
+	std::lock_guard<std::mutex> guard(r.lock);
+	return r.buffers.size();
+}
+
+uint64_t traceGeneration() {
+	return registry().generation.load(std::memory_order_relaxed);
+}
+
+int64_t traceNow() {
+	return clockNow() - registry().epoch.load(std::memory_order_relaxed);
+}
+
+TraceScope::TraceScope(const char *name) {
+	if (tracing()) {
+		this->name = name;
+		this->generation = traceGeneration();
+		this->begin = traceNow();
+	} else {
+		this->name = nullptr;
+		this->generation = 0;
+		this->begin = 0;
+	}
+}
+
+TraceScope::~TraceScope() {
+	if (name != nullptr) {
+		threadBuffer()->push({name, begin, traceNow()-begin, generation});
+	}
+}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include <atomic>
+#include <ostream>
+
+namespace arithmetic {
+
+// DESIGN(edward.bingham) Tracing records a complete event for each
+// TraceScope, in the Chrome trace event format so that a run can be opened
+// in chrome://tracing or ui.perfetto.dev. Each thread appends to its own
+// fixed size ring buffer, so recording takes no locks and never allocates
+// after the first event on a thread. When a buffer wraps, the oldest events
+// are overwritten. Buffers are only read when the trace is written out by
+// traceStop() or at exit. When tracing is off, a TraceScope costs one
+// relaxed atomic load.
+//
+// Writing the trace doesn't wait for the other threads. Every slot in a ring
+// carries the sequence number of the event in it, and the reader skips any
+// slot that changes while it is being read, so a trace written while scopes
+// are still running is missing those events rather than corrupt. Each event
+// also records the trace it belongs to, so traceStart() never has to touch
+// another thread's buffer to forget the events of an earlier trace.
+//
+// Tracing is started either by calling traceStart() or by setting the
+// ARITHMETIC_TRACE environment variable to the output path.
+
+struct TraceEvent {
+	// must be a string literal or otherwise outlive the trace
+	const char *name;
+	// nanoseconds since the trace was started
+	int64_t begin;
+	int64_t duration;
+	// the traceStart() that this event belongs to
+	uint64_t generation;
+};
+
+// One event in a ring. Every field is atomic so that the reader never races
+// with the owning thread.
+struct TraceSlot {
+	TraceSlot();
+	~TraceSlot();
+
+	// 0 while the slot is being written, otherwise one more than the index of
+	// the event in it
+	std::atomic<uint64_t> seq;
+	std::atomic<const char*> name;
+	std::atomic<int64_t> begin;
+	std::atomic<int64_t> duration;
+	std::atomic<uint64_t> generation;
+};
+
+struct TraceBuffer {
+	TraceBuffer(size_t tid, size_t capacity);
+	~TraceBuffer();
+
+	size_t tid;
+	vector<TraceSlot> events;
+	// the total number of events pushed, only written by the owning thread
+	std::atomic<uint64_t> written;
+
+	// Called when the buffer is handed to a new thread. Drops the events if
+	// the capacity changed.
+	void reset(size_t capacity);
+	void push(TraceEvent event);
+	// Write the events that belong to generation
+	void write(ostream &os, bool &first, uint64_t generation) const;
+};
+
+extern std::atomic<bool> traceEnabled;
+
+inline bool tracing() {
+	return traceEnabled.load(std::memory_order_relaxed);
+}
+
+// Start recording. capacity is the number of events kept for each thread.
+void traceStart(string path, size_t capacity=65536);
+// Stop recording and write the events to the path given to traceStart().
+// Returns false if the file could not be written.
+bool traceStop();
+// Write the events recorded so far in the current trace. This may be called
+// while other threads are recording, it just leaves out the events that are
+// written at the same time.
+void traceWrite(ostream &os);
+
+// The number of thread buffers allocated so far
+size_t traceBuffers();
+
+// nanoseconds since the trace was started
+int64_t traceNow();
+
+// The current trace, incremented by every traceStart()
+uint64_t traceGeneration();
+
+struct TraceScope {
+	TraceScope(const char *name);
+	~TraceScope();
+
+	const char *name;
+	int64_t begin;
+	uint64_t generation;
+};
+
+}
@@ -1,6 +1,7 @@
 #include "type.h"
 
 #include <cmath>
+#include <algorithm>
 
 using namespace std;
 
@@ -51,4 +52,231 @@ Cost operator+(Cost c0, Cost c1) {
 	return (c0 += c1);
 }
 
+int lsbOf(Type t) {
+	if (t.coeff <= 0.0) {
+		return 0;
+	}
+	return (int)floor(log2(t.coeff));
+}
+
+int digitsOf(Type t) {
+	return max(0, (int)ceil(t.width));
+}
+
+// The number of digits needed to hold the sum of all bits in these columns
+int digitsOf(vector<int> height) {
+	int result = 0;
+	long carry = 0;
+	for (size_t c = 0; c < height.size() or carry > 0; c++) {
+		long n = carry + (c < height.size() ? height[c] : 0);
+		if (n > 0) {
+			result = (int)c+1;
+		}
+		carry = n/2;
+	}
+	return result;
+}
+
+array<double, 2> compress(vector<int> &height) {
+	int tallest = 0;
+	for (auto h = height.begin(); h != height.end(); h++) {
+		tallest = max(tallest, *h);
+	}
+
+	// Dadda's sequence of maximum column heights, 2, 3, 4, 6, 9, 13, 19, ...
+	vector<int> limit({2});
+	while (limit.back() < tallest) {
+		limit.push_back(limit.back()*3/2);
+	}
+
+	double complexity = 0.0;
+	double stages = 0.0;
+	for (int j = (int)limit.size()-2; j >= 0; j--) {
+		stages += 1.0;
+		// Carries from column c land in column c+1 during the same stage and
+		// count toward that column's height.
+		int carry = 0;
+		for (size_t c = 0; c < height.size() or carry > 0; c++) {
+			if (c >= height.size()) {
+				height.push_back(0);
+			}
+			int n = height[c] + carry;
+			carry = 0;
+			if (n > limit[j]) {
+				// A full adder removes two bits from the column, a half adder removes one
+				int full = (n-limit[j])/2;
+				int half = (n-limit[j])%2;
+				complexity += (double)full + 0.5*(double)half;
+				carry = full + half;
+				n = limit[j];
+			}
+			height[c] = n;
+		}
+	}
+	return {complexity, stages};
+}
+
+array<double, 2> carryPropagate(const vector<int> &height, Cost::Model model) {
+	// The carry chain starts at the first column that still has two bits and
+	// runs through the most significant digit of the result.
+	int from = -1;
+	int to = 0;
+	for (int c = 0; c < (int)height.size(); c++) {
+		if (from < 0 and height[c] >= 2) {
+			from = c;
+		}
+		if (height[c] > 0) {
+			to = c+1;
+		}
+	}
+	if (from < 0) {
+		return {0.0, 0.0};
+	}
+
+	double span = (double)(to - from);
+	if (model == Cost::LOOKAHEAD) {
+		// parallel-prefix (Kogge-Stone) adder, one row of propagate/generate
+		// cells, log2(span) rows of prefix cells, and one row of sum cells.
+		double levels = ceil(log2(span));
+		return {span + span*levels, levels + 2.0};
+	}
+	return {span, span};
+}
+
+pair<Type, double> addTree(vector<Type> args, Cost::Model model) {
+	// Constants are folded into the adders' inputs and don't occupy a row in
+	// the compression tree.
+	vector<Type> rows;
+	double coeff = 0.0;
+	double arrival = 0.0;
+	for (auto i = args.begin(); i != args.end(); i++) {
+		if (i == args.begin() or i->coeff < coeff) {
+			coeff = i->coeff;
+		}
+		arrival = max(arrival, i->delay);
+		if (digitsOf(*i) > 0) {
+			rows.push_back(*i);
+		}
+	}
+
+	if (rows.size() <= 1u) {
+		Type result = rows.empty() ? Type(coeff, 0.0, 0.0) : rows[0];
+		result.delay = arrival;
+		return {result, 0.0};
+	}
+
+	int lsb = lsbOf(rows[0]);
+	for (auto i = rows.begin(); i != rows.end(); i++) {
+		lsb = min(lsb, lsbOf(*i));
+	}
+
+	vector<int> height;
+	for (auto i = rows.begin(); i != rows.end(); i++) {
+		int from = lsbOf(*i)-lsb;
+		int to = from + digitsOf(*i);
+		if (to > (int)height.size()) {
+			height.resize(to, 0);
+		}
+		for (int c = from; c < to; c++) {
+			height[c]++;
+		}
+	}
+
+	Type result(pow(2.0, (double)lsb), (double)digitsOf(height), arrival);
+	array<double, 2> tree = compress(height);
+	array<double, 2> adder = carryPropagate(height, model);
+	result.delay += tree[1] + adder[1];
+	return {result, tree[0] + adder[0]};
+}
+
+pair<Type, double> productTree(vector<Type> rows, Cost::Model model) {
+	// Every partial product is the AND of one digit from each row, and lands
+	// in the column that is the sum of those digits' columns.
+	vector<int> height({1});
+	double coeff = 1.0;
+	double arrival = 0.0;
+	for (auto i = rows.begin(); i != rows.end(); i++) {
+		vector<int> next(height.size()+digitsOf(*i)-1, 0);
+		for (int c = 0; c < (int)height.size(); c++) {
+			for (int d = 0; d < digitsOf(*i); d++) {
+				next[c+d] += height[c];
+			}
+		}
+		height = next;
+		coeff *= i->coeff;
+		arrival = max(arrival, i->delay);
+	}
+
+	double products = 0.0;
+	for (auto h = height.begin(); h != height.end(); h++) {
+		products += (double)*h;
+	}
+
+	Type result(coeff, (double)digitsOf(height), arrival);
+	double complexity = products*(double)(rows.size()-1);
+	result.delay += ceil(log2((double)rows.size()));
+
+	array<double, 2> tree = compress(height);
+	array<double, 2> adder = carryPropagate(height, model);
+	result.delay += tree[1] + adder[1];
+	return {result, complexity + tree[0] + adder[0]};
+}
+
+pair<Type, double> multiplyTree(vector<Type> args, Cost::Model model) {
+	// Constants only scale the result
+	vector<Type> rows;
+	double coeff = 1.0;
+	double arrival = 0.0;
+	for (auto i = args.begin(); i != args.end(); i++) {
+		arrival = max(arrival, i->delay);
+		if (digitsOf(*i) > 0) {
+			rows.push_back(*i);
+		} else {
+			coeff *= i->coeff;
+		}
+	}
+
+	if (rows.size() <= 1u) {
+		Type result = rows.empty() ? Type(1.0, 0.0, 0.0) : rows[0];
+		result.coeff *= coeff;
+		result.delay = arrival;
+		return {result, 0.0};
+	}
+
+	// Option 1: a chain of two-input multipliers, always combining the two
+	// narrowest operands first.
+	vector<Type> chain = rows;
+	double complexity = 0.0;
+	while (chain.size() > 1u) {
+		sort(chain.begin(), chain.end(), [](const Type &a, const Type &b) {
+			return a.width > b.width;
+		});
+		pair<Type, double> step = productTree({chain[chain.size()-2], chain[chain.size()-1]}, model);
+		chain.pop_back();
+		chain.back() = step.first;
+		complexity += step.second;
+	}
+	pair<Type, double> result(chain[0], complexity);
+
+	// Option 2: share a single compression tree across the partial products
+	// of every operand. This avoids the intermediate carry-propagate adders,
+	// but the number of partial products grows with the product of the
+	// widths, so don't bother enumerating them for wide operands.
+	double products = 1.0;
+	for (auto i = rows.begin(); i != rows.end(); i++) {
+		products *= (double)digitsOf(*i);
+	}
+	if (rows.size() > 2u and products <= 65536.0) {
+		// pick the option with the smaller area-delay product
+		pair<Type, double> shared = productTree(rows, model);
+		if (shared.second*shared.first.delay < result.second*result.first.delay) {
+			result = shared;
+		}
+	}
+
+	result.first.coeff *= coeff;
+	result.first.delay = max(result.first.delay, arrival);
+	return result;
+}
+
 }
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <array>
+#include <utility>
 
 namespace arithmetic {
 
@@ -48,6 +49,17 @@ std::array<double, 2> overlap(Type t0, Type t1);
 // Used to represent accumulated cost of an arithmetic expression for
 // optimization, trading off area and energy vs operator latency
 struct Cost {
+	// Selects the backend used to estimate the cost of each operator
+	enum Model {
+		// word-level model, N-ary operators are a chain of binary operators
+		WORD = 0,
+		// bit-level model, N-ary ADD and MULTIPLY reduce every partial product
+		// in a single dadda tree followed by a ripple-carry adder
+		RIPPLE = 1,
+		// same as RIPPLE, but with a parallel-prefix carry look-ahead adder
+		LOOKAHEAD = 2,
+	};
+
 	Cost();
 	Cost(double complexity, double critical);
 	~Cost();
@@ -62,5 +74,27 @@ struct Cost {
 
 Cost operator+(Cost c0, Cost c1);
 
+// The bit-level models place every digit of every argument into a column
+// of a compression tree. Columns are indexed from the least significant
+// digit of the least significant argument.
+int lsbOf(Type t);
+int digitsOf(Type t);
+int digitsOf(std::vector<int> height);
+
+// Reduce the columns down to at most two rows using Dadda's method,
+// returning {complexity, stages}. The column heights are updated in place.
+std::array<double, 2> compress(std::vector<int> &height);
+
+// Merge the final two rows with a carry-propagate adder, returning
+// {complexity, delay}
+std::array<double, 2> carryPropagate(const std::vector<int> &height, Cost::Model model);
+
+// Bit-level estimates for N-ary addition and multiplication
+std::pair<Type, double> addTree(std::vector<Type> args, Cost::Model model);
+std::pair<Type, double> multiplyTree(std::vector<Type> args, Cost::Model model);
+
+// A single compression tree over every partial product of the arguments
+std::pair<Type, double> productTree(std::vector<Type> rows, Cost::Model model);
+
 }
 
@@ -449,6 +449,33 @@ bool areSame(Value v0, Value v1) {
 	return false;
 }
 
+size_t hashOf(Value v) {
+	size_t result = hashCombine((size_t)v.state, 0);
+	if (not v.isValid()) {
+		return result;
+	}
+
+	result = hashCombine(result, (size_t)v.type);
+	if (v.type == Value::BOOL) {
+		result = hashCombine(result, (size_t)v.bval);
+	} else if (v.type == Value::INT) {
+		result = hashCombine(result, std::hash<int64_t>()(v.ival));
+	} else if (v.type == Value::REAL) {
+		result = hashCombine(result, std::hash<double>()(v.rval));
+	} else if (v.type == Value::STRING) {
+		result = hashCombine(result, std::hash<string>()(v.sval));
+	} else if (v.type == Value::ARRAY or v.type == Value::STRUCT) {
+		for (auto i = v.arr.begin(); i != v.arr.end(); i++) {
+			result = hashCombine(result, hashOf(*i));
+		}
+	}
+	return result;
+}
+
+size_t hashCombine(size_t seed, size_t value) {
+	return seed ^ (value + 0x9e3779b97f4a7c15ul + (seed << 6) + (seed >> 2));
+}
+
 int order(Value v0, Value v1) {
 	if (v0.type < v1.type) {
 		return -1;
@@ -140,6 +140,10 @@ _INTERFACE_ARG(Caller,
 bool areSame(Value v0, Value v1);
 int order(Value v0, Value v1);
 
+// hash consistent with areSame()
+size_t hashOf(Value v);
+size_t hashCombine(size_t seed, size_t value);
+
 ostream &operator<<(ostream &os, Value v);
 
 Value isTrue(Value v); // return a wire which is "valid" when the value is "true" and "neutral" otherwise
@@ -0,0 +1,130 @@
+#include "bench.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+Bench::Bench() {
+	minTime = 0.1;
+}
+
+Bench::~Bench() {
+}
+
+void Bench::run(string name, size_t size, std::function<void()> body, size_t bytes) {
+	if (not filter.empty() and name.find(filter) == string::npos) {
+		return;
+	}
+
+	// warm the caches and any lazily built state
+	body();
+
+	size_t iterations = 1;
+	double elapsed = 0.0;
+	while (true) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			body();
+		}
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (elapsed >= minTime or iterations >= ((size_t)1 << 40)) {
+			break;
+		}
+		iterations *= 2;
+	}
+
+	results.push_back({name, size, iterations, elapsed*1e9/(double)iterations, bytes});
+	if (bytes != 0) {
+		fprintf(stderr, "%-40s %10zu %14.1f ns/op %10.1f MB/s\n", name.c_str(), size, results.back().nsPerOp, (double)bytes*1e3/results.back().nsPerOp);
+	} else {
+		fprintf(stderr, "%-40s %10zu %14.1f ns/op\n", name.c_str(), size, results.back().nsPerOp);
+	}
+}
+
+void Bench::write(ostream &os) const {
+	os << "{" << endl;
+	os << "\t\"context\": {" << endl;
+	os << "\t\t\"compiler\": \"" << __VERSION__ << "\"," << endl;
+	os << "\t\t\"min_time\": " << minTime << endl;
+	os << "\t}," << endl;
+	os << "\t\"benchmarks\": [" << endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		os << "\t\t{\"name\": \"" << results[i].name << "\", "
+		   << "\"size\": " << results[i].size << ", "
+		   << "\"iterations\": " << results[i].iterations << ", "
+		   << "\"ns_per_op\": " << results[i].nsPerOp;
+		if (results[i].bytes != 0) {
+			os << ", \"bytes_per_op\": " << results[i].bytes
+			   << ", \"mb_per_s\": " << (double)results[i].bytes*1e3/results[i].nsPerOp;
+		}
+		os << "}"
+		   << (i+1 < results.size() ? "," : "") << endl;
+	}
+	os << "\t]" << endl;
+	os << "}" << endl;
+}
+
+BenchRegister::BenchRegister(const char *name, BenchGroup group) {
+	benchGroups().push_back({name, group});
+}
+
+BenchRegister::~BenchRegister() {
+}
+
+vector<pair<const char*, BenchGroup> > &benchGroups() {
+	static vector<pair<const char*, BenchGroup> > groups;
+	return groups;
+}
+
+void printHelp() {
+	printf("Usage: benchmark [options]\n");
+	printf("Measure the library and print the results as JSON.\n");
+	printf("\nOptions:\n");
+	printf(" -h,--help         Display this information\n");
+	printf(" -o <file>         Write the results to file instead of stdout\n");
+	printf(" -f <name>         Only run benchmarks whose name contains name\n");
+	printf(" -t <seconds>      Minimum time for each measurement (default 0.1)\n");
+	printf(" -l,--list         List the groups\n");
+}
+
+int main(int argc, char **argv) {
+	Bench b;
+	string out;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-h") == 0 or strcmp(argv[i], "--help") == 0) {
+			printHelp();
+			return 0;
+		} else if (strcmp(argv[i], "-l") == 0 or strcmp(argv[i], "--list") == 0) {
+			for (auto g = benchGroups().begin(); g != benchGroups().end(); g++) {
+				printf("%s\n", g->first);
+			}
+			return 0;
+		} else if (strcmp(argv[i], "-o") == 0 and i+1 < argc) {
+			out = argv[++i];
+		} else if (strcmp(argv[i], "-f") == 0 and i+1 < argc) {
+			b.filter = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 and i+1 < argc) {
+			b.minTime = atof(argv[++i]);
+		} else {
+			printf("error: unrecognized option '%s'\n", argv[i]);
+			printHelp();
+			return 1;
+		}
+	}
+
+	for (auto g = benchGroups().begin(); g != benchGroups().end(); g++) {
+		g->second(b);
+	}
+
+	if (out.empty()) {
+		b.write(cout);
+	} else {
+		std::ofstream fout(out.c_str());
+		if (not fout.is_open()) {
+			printf("error: unable to open '%s'\n", out.c_str());
+			return 1;
+		}
+		b.write(fout);
+	}
+	return 0;
+}
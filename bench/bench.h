@@ -0,0 +1,56 @@
+#pragma once
+
+#include <common/standard.h>
+
+#include <functional>
+
+// DESIGN(edward.bingham) A small harness rather than a dependency on google
+// benchmark, since the tests already tie us to one googletest checkout. Each
+// group registers a function that builds its inputs and then calls
+// Bench::run() for every measurement. run() doubles the iteration count
+// until one batch takes at least minTime so that cheap operations are not
+// dominated by the clock. Results are written as JSON for tracking between
+// releases.
+struct Bench {
+	Bench();
+	~Bench();
+
+	struct Result {
+		string name;
+		// the size of the input, 0 if there is no natural size
+		size_t size;
+		size_t iterations;
+		double nsPerOp;
+		// bytes of input consumed by each op, 0 if throughput isn't measured
+		size_t bytes;
+	};
+
+	double minTime;
+	string filter;
+	vector<Result> results;
+
+	// If bytes is given, the throughput is reported in MB/s as well
+	void run(string name, size_t size, std::function<void()> body, size_t bytes=0);
+	void write(ostream &os) const;
+};
+
+typedef void (*BenchGroup)(Bench &b);
+
+// Register a group of benchmarks at static initialization
+struct BenchRegister {
+	BenchRegister(const char *name, BenchGroup group);
+	~BenchRegister();
+};
+
+vector<pair<const char*, BenchGroup> > &benchGroups();
+
+// Keep the compiler from removing a computation whose result is unused
+template <typename T>
+void keep(const T &value) {
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+#define BENCH(name) \
+	static void bench_##name(Bench &b); \
+	static BenchRegister register_##name(#name, bench_##name); \
+	static void bench_##name(Bench &b)
@@ -0,0 +1,161 @@
+#include "bench.h"
+
+#include <arithmetic/expression.h>
+#include <arithmetic/algorithm.h>
+#include <arithmetic/generate.h>
+#include <arithmetic/pool.h>
+#include <arithmetic/builder.h>
+
+using namespace arithmetic;
+
+// n arithmetic operations where half of the operands are shared
+static Expression arithmeticDag(size_t n) {
+	Generator g(n);
+	g.size = n;
+	g.sharing = 0.5;
+	return g.expression();
+}
+
+// a sum of n products of wires
+static Expression wireGuard(size_t n) {
+	Generator g(n);
+	g.useWires();
+	g.vars = 16;
+	g.constants = 0.0;
+
+	vector<Expression> terms;
+	for (size_t i = 0; i < n; i++) {
+		terms.push_back(g.wide(Operation::WIRE_AND, 2));
+	}
+	return wireOr(terms);
+}
+
+BENCH(expression) {
+	Generator g;
+	State ints = g.state();
+	for (size_t n : {16, 128, 1024}) {
+		Expression e = arithmeticDag(n);
+		b.run("evaluate/dag", n, [&]() { keep(evaluate(e, e.top, ints)); });
+		// the same through the type-erased entry point
+		ConstOperationSet erased(e);
+		b.run("evaluate/erased", n, [&]() { keep(evaluate(erased, e.top, ints)); });
+		b.run("iterate/kernel", n, [&]() {
+			size_t count = 0;
+			for (ConstUpIteratorOn<Expression> i(e, {e.top}); not i.done(); ++i) {
+				count += i->operands.size();
+			}
+			keep(count);
+		});
+		b.run("iterate/erased", n, [&]() {
+			size_t count = 0;
+			for (ConstUpIterator i(erased, {e.top}); not i.done(); ++i) {
+				count += i->operands.size();
+			}
+			keep(count);
+		});
+	}
+
+	g.useWires();
+	g.vars = 16;
+	State wires = g.state();
+	for (size_t n : {4, 32, 256}) {
+		Expression guard = wireGuard(n);
+		b.run("evaluate/guard", n, [&]() { keep(evaluate(guard, guard.top, wires)); });
+		b.run("passesGuard", n, [&]() {
+			State total;
+			keep(passesGuard(wires, wires, guard, &total));
+		});
+	}
+
+	// many guards over the same few variables, separately and in a pool
+	for (size_t n : {16, 256}) {
+		Generator h(n);
+		h.useWires();
+		h.vars = 4;
+		h.size = 16;
+		vector<Expression> guards;
+		ExpressionPool pool;
+		for (size_t i = 0; i < n; i++) {
+			guards.push_back(h.expression());
+			pool.set(::to_string(i), guards.back());
+		}
+		State s = h.state();
+		b.run("evaluate/each", n, [&]() {
+			for (auto i = guards.begin(); i != guards.end(); i++) {
+				keep(evaluate(*i, i->top, s));
+			}
+		});
+		b.run("evaluate/pool", n, [&]() { keep(pool.evaluate(s)); });
+	}
+
+	// building a guard one term at a time
+	for (size_t n : {64, 512}) {
+		Generator h(n);
+		h.useWires();
+		h.vars = 16;
+		vector<Expression> terms;
+		for (size_t i = 0; i < n; i++) {
+			terms.push_back(h.wide(Operation::WIRE_OR, 2));
+		}
+		b.run("build/operators", n, [&]() {
+			Expression result = Expression::vdd();
+			for (auto i = terms.begin(); i != terms.end(); i++) {
+				result = result & *i;
+			}
+			keep(result);
+		});
+		b.run("build/builder", n, [&]() {
+			Builder bld;
+			Handle result = bld.of(Expression::vdd());
+			for (auto i = terms.begin(); i != terms.end(); i++) {
+				result = result & bld.of(*i);
+			}
+			keep(bld.take(result));
+		});
+	}
+
+	for (size_t n : {16, 128, 1024}) {
+		Expression e = arithmeticDag(n);
+		// tidy an untouched copy every iteration, the copy is part of the cost
+		b.run("tidy/dag", n, [&]() {
+			Expression f = e;
+			f.tidy();
+			keep(f);
+		});
+	}
+}
+
+// Larger inputs to find where the iterators and tidy() stop scaling
+BENCH(scale) {
+	b.run("generate/dag", 1000000, [&]() { keep(arithmeticDag(1000000)); });
+
+	for (size_t n : {1024, 8192, 65536}) {
+		Expression e = arithmeticDag(n);
+		b.run("iterate/up", n, [&]() {
+			size_t count = 0;
+			for (ConstUpIterator i(e, {e.top}); not i.done(); ++i) {
+				count++;
+			}
+			keep(count);
+		});
+	}
+
+	// a chain of additions is flattened one operation at a time, so keep
+	// these small
+	Generator g;
+	for (size_t n : {64, 128, 256}) {
+		Expression w = g.wide(Operation::ADD, n);
+		b.run("tidy/wide", n, [&]() {
+			Expression f = w;
+			f.tidy();
+			keep(f);
+		});
+
+		Expression c = g.chain(Operation::ADD, n);
+		b.run("tidy/chain", n, [&]() {
+			Expression f = c;
+			f.tidy();
+			keep(f);
+		});
+	}
+}
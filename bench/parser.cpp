@@ -0,0 +1,71 @@
+#include "bench.h"
+
+#include <arithmetic/expression.h>
+#include <arithmetic/generate.h>
+#include <arithmetic/parser.h>
+
+using namespace arithmetic;
+
+// One guard with n terms, printed on a single line
+static string guardText(size_t n) {
+	Generator g(n);
+	g.useWires();
+	g.vars = 16;
+	g.constants = 0.0;
+
+	vector<Expression> terms;
+	for (size_t i = 0; i < n; i++) {
+		terms.push_back(g.wide(Operation::WIRE_AND, 3));
+	}
+	return wireOr(terms).to_string();
+}
+
+// n generated rules, one per line. parseRules() also tidies the rule set
+// and compiles its automaton, which is most of the cost.
+static string rulesText(size_t n) {
+	Generator g(n);
+	g.size = 4;
+	g.vars = 4;
+
+	string result;
+	for (size_t i = 0; i < n; i++) {
+		result += g.expression().to_string() + " > " + g.expression().to_string() + "\n";
+	}
+	return result;
+}
+
+BENCH(parser) {
+	for (size_t n : {16, 256}) {
+		string text = guardText(n);
+		Parser check;
+		Expression e;
+		if (not check.parse(text.c_str(), text.size(), e)) {
+			printf("error: generated guard doesn't parse: %s\n", check.error.c_str());
+			continue;
+		}
+
+		b.run("parse/guard", n, [&]() {
+			Parser parser;
+			Expression result;
+			keep(parser.parse(text.c_str(), text.size(), result));
+			keep(result);
+		}, text.size());
+	}
+
+	for (size_t n : {16, 64}) {
+		string text = rulesText(n);
+		Parser check;
+		RuleSet r;
+		if (not check.parseRules(text.c_str(), text.size(), r)) {
+			printf("error: generated rules don't parse: %s\n", check.error.c_str());
+			continue;
+		}
+
+		b.run("parse/rules", n, [&]() {
+			Parser parser;
+			RuleSet result;
+			keep(parser.parseRules(text.c_str(), text.size(), result));
+			keep(result);
+		}, text.size());
+	}
+}
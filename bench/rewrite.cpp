@@ -0,0 +1,58 @@
+#include "bench.h"
+
+#include <arithmetic/expression.h>
+#include <arithmetic/algorithm.h>
+#include <arithmetic/rewrite.h>
+#include <arithmetic/generate.h>
+
+using namespace arithmetic;
+
+// Expressions with something for the default rules to do
+static Expression reducible(size_t n) {
+	Expression a = Expression::varOf(0);
+	Expression result = a;
+	for (size_t i = 0; i < n; i++) {
+		Expression v = Expression::varOf(i%6+1);
+		switch (i%4) {
+		case 0: result = result + v*Expression::intOf(0); break;
+		case 1: result = (result | (v & ~v)) & (v | ~v); break;
+		case 2: result = result*Expression::intOf(1) + (v - v); break;
+		default: result = result + v;
+		}
+	}
+	return result;
+}
+
+BENCH(rewrite) {
+	RuleSet rules = rewriteCanonical() + rewriteSimple();
+	for (size_t n : {4, 16, 64}) {
+		Expression e = reducible(n);
+		b.run("search/default", n, [&]() { keep(arithmetic::search(e, {e.top}, rules)); });
+		b.run("search/first", n, [&]() { keep(arithmetic::search(e, {e.top}, rules, 1)); });
+	}
+
+	for (size_t n : {4, 16, 64}) {
+		Expression e = reducible(n);
+		b.run("minimize/default", n, [&]() {
+			Expression f = e;
+			f.minimize();
+			keep(f);
+		});
+	}
+
+	// many small independent jobs, as from a synthesis flow
+	Generator g(1);
+	g.size = 24;
+	vector<Expression> batch;
+	for (int i = 0; i < 256; i++) {
+		batch.push_back(g.expression());
+	}
+	b.run("minimizeAll/1", batch.size(), [&]() {
+		vector<Expression> f = batch;
+		keep(minimizeAll(f, RuleSet(), MinimizeOptions(), 1));
+	});
+	b.run("minimizeAll/cores", batch.size(), [&]() {
+		vector<Expression> f = batch;
+		keep(minimizeAll(f, RuleSet(), MinimizeOptions(), 0));
+	});
+}
@@ -0,0 +1,40 @@
+#include "bench.h"
+
+#include <arithmetic/state.h>
+#include <arithmetic/action.h>
+#include <arithmetic/generate.h>
+
+using namespace arithmetic;
+
+static State lattice(size_t vars, size_t seed) {
+	State result;
+	for (size_t i = 0; i < vars; i++) {
+		switch ((i*31+seed)%4) {
+		case 0: result.push_back(Value::gnd()); break;
+		case 1: result.push_back(Value::vdd()); break;
+		case 2: result.push_back(Value::U()); break;
+		default: result.push_back(Value::intOf((int64_t)i));
+		}
+	}
+	return result;
+}
+
+BENCH(state) {
+	for (size_t n : {8, 64, 512}) {
+		State s0 = lattice(n, 0), s1 = lattice(n, 1);
+		b.run("state/intersect", n, [&]() { keep(s0 & s1); });
+		b.run("state/union", n, [&]() { keep(s0 | s1); });
+		b.run("state/subset", n, [&]() { keep(s0.isSubsetOf(s1)); });
+		b.run("state/interfering", n, [&]() { keep(areInterfering(s0, s1)); });
+	}
+
+	Generator g;
+	g.vars = 16;
+	g.size = 8;
+	State curr = g.state();
+	for (size_t n : {2, 8, 32}) {
+		// n parallel branches that each assign four variables
+		Choice c = g.choice(n, 4);
+		b.run("choice/evaluate", n, [&]() { keep(c.evaluate(curr)); });
+	}
+}
@@ -0,0 +1,31 @@
+#include "bench.h"
+
+#include <arithmetic/value.h>
+
+using namespace arithmetic;
+
+BENCH(value) {
+	Value i0 = Value::intOf(12345), i1 = Value::intOf(678);
+	Value r0 = Value::realOf(3.25), r1 = Value::realOf(1.5);
+	Value w0 = Value::vdd(), w1 = Value::gnd();
+	Value b0 = Value::boolOf(true), b1 = Value::boolOf(false);
+
+	b.run("value/int_add", 0, [&]() { keep(i0 + i1); });
+	b.run("value/int_mul", 0, [&]() { keep(i0 * i1); });
+	b.run("value/int_div", 0, [&]() { keep(i0 / i1); });
+	b.run("value/int_less", 0, [&]() { keep(i0 < i1); });
+	b.run("value/real_add", 0, [&]() { keep(r0 + r1); });
+	b.run("value/real_mul", 0, [&]() { keep(r0 * r1); });
+	b.run("value/wire_and", 0, [&]() { keep(w0 & w1); });
+	b.run("value/wire_or", 0, [&]() { keep(w0 | w1); });
+	b.run("value/wire_not", 0, [&]() { keep(~w0); });
+	b.run("value/bool_and", 0, [&]() { keep(b0 && b1); });
+	b.run("value/bool_or", 0, [&]() { keep(b0 || b1); });
+	b.run("value/intersect", 0, [&]() { keep(intersect(w0, Value::X())); });
+	b.run("value/union", 0, [&]() { keep(unionOf(w0, w1)); });
+
+	Value a0 = Value::arrOf({i0, i1, i0, i1, i0, i1, i0, i1});
+	Value a1 = Value::arrOf({i1, i0, i1, i0, i1, i0, i1, i0});
+	b.run("value/array_same", 8, [&]() { keep(areSame(a0, a1)); });
+	b.run("value/array_hash", 8, [&]() { keep(hashOf(a0)); });
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/algorithm.h>
+#include <arithmetic/expression.h>
+#include <arithmetic/aig.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+// Simulate the bit-blasted expression for one assignment of the variables
+static int64_t simulate(BitBlaster &blaster, const vector<Aig::Literal> &bits, vector<int64_t> assign) {
+	vector<uint64_t> values(blaster.aig.inputs.size(), 0);
+	for (auto v = blaster.vars.begin(); v != blaster.vars.end(); v++) {
+		for (size_t i = 0; i < v->second.size(); i++) {
+			uint32_t node = Aig::nodeOf(v->second[i]);
+			for (size_t j = 0; j < blaster.aig.inputs.size(); j++) {
+				if (blaster.aig.inputs[j] == node) {
+					values[j] = ((assign[v->first] >> i) & 1) ? ~(uint64_t)0 : 0;
+				}
+			}
+		}
+	}
+
+	vector<uint64_t> result = blaster.aig.simulate(values);
+	int64_t value = 0;
+	for (size_t i = 0; i < 64; i++) {
+		Aig::Literal bit = i < bits.size() ? bits[i] : bits.back();
+		if (Aig::valueOf(result, bit) & 1u) {
+			value |= ((int64_t)1) << i;
+		}
+	}
+	return value;
+}
+
+TEST(Aig, StructuralHashing) {
+	Aig aig;
+	Aig::Literal a = aig.input();
+	Aig::Literal b = aig.input();
+
+	EXPECT_EQ(aig.andOf(a, b), aig.andOf(b, a));
+	EXPECT_EQ(aig.andOf(a, Aig::complement(a)), Aig::ZERO);
+	EXPECT_EQ(aig.andOf(a, Aig::ONE), a);
+	EXPECT_EQ(aig.andOf(a, a), a);
+	EXPECT_EQ(aig.xorOf(a, b), aig.xorOf(a, b));
+	EXPECT_EQ(aig.gates(), 4u);
+}
+
+TEST(Aig, BitBlast) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	vector<Type> vars({Type(1.0, 4.0, 0.0), Type(1.0, 3.0, 0.0)});
+
+	vector<Expression> tests({
+		a + b,
+		a - b*3,
+		-a * (b - 5),
+		a / (b - 3),
+		a % (b - 3),
+		(a << b) >> Expression::intOf(2),
+		(a - 8) >> b,
+		(a < b) || (b >= a - 4),
+		(a != b) && !(a > 12),
+		// every valid integer is vdd to a wire operator, even zero
+		~a,
+		a & ~b,
+		(a < b) | ~(b - 3),
+		(a == b) ^ a,
+	});
+
+	for (auto e = tests.begin(); e != tests.end(); e++) {
+		BitBlaster blaster;
+		vector<Aig::Literal> bits = blaster.blast(*e, e->top, vars);
+		ASSERT_FALSE(bits.empty()) << e->to_string();
+
+		for (int64_t x = 0; x < 16; x++) {
+			for (int64_t y = 0; y < 8; y++) {
+				if (y == 3 and (e - tests.begin() == 3 or e - tests.begin() == 4)) {
+					continue;
+				}
+
+				State s;
+				s.push_back(x);
+				s.push_back(y);
+				Value expect = evaluate(*e, e->top, s).val;
+				int64_t value = simulate(blaster, bits, {x, y});
+				if (expect.type == Value::WIRE) {
+					EXPECT_EQ(value, (int64_t)expect.isValid()) << e->to_string() << " at " << x << ", " << y;
+				} else if (expect.type == Value::BOOL) {
+					EXPECT_EQ(value, (int64_t)expect.bval) << e->to_string() << " at " << x << ", " << y;
+				} else {
+					EXPECT_EQ(value, expect.ival) << e->to_string() << " at " << x << ", " << y;
+				}
+			}
+		}
+	}
+}
+
+TEST(Aig, Ternary) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	vector<Type> vars({Type(1.0, 4.0, 0.0), Type(1.0, 3.0, 0.0)});
+
+	Expression e(Operation::TERNARY, vector<Expression>({a > b, a - b, b - a}));
+	BitBlaster blaster;
+	vector<Aig::Literal> bits = blaster.blast(e, e.top, vars);
+	ASSERT_FALSE(bits.empty());
+	for (int64_t x = 0; x < 16; x++) {
+		for (int64_t y = 0; y < 8; y++) {
+			EXPECT_EQ(simulate(blaster, bits, {x, y}), x > y ? x - y : y - x);
+		}
+	}
+}
+
+TEST(Aig, Equivalent) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+	vector<Type> narrow({Type(1.0, 6.0, 0.0), Type(1.0, 6.0, 0.0), Type(1.0, 6.0, 0.0)});
+	vector<Type> wide({Type(1.0, 16.0, 0.0), Type(1.0, 16.0, 0.0), Type(1.0, 16.0, 0.0)});
+
+	Expression e0 = (a + b) * c;
+	Expression e1 = a*c + b*c;
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, narrow), Equivalence::EQUAL);
+	// the BDD of a wide multiplier is too large, so this can't be proven
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, wide, 1u<<16), Equivalence::UNKNOWN);
+
+	// too wide to simulate exhaustively, but the BDD decides these
+	e0 = (a - b) + b;
+	e1 = a;
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, wide), Equivalence::EQUAL);
+	e0 = (a + b) + c;
+	e1 = a + (b + c);
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, wide), Equivalence::EQUAL);
+	e0 = (a + b) < c;
+	e1 = a < c - b;
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, wide), Equivalence::EQUAL);
+
+	// wire operators on integers
+	e0 = ~a;
+	e1 = Expression::gnd();
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, narrow), Equivalence::EQUAL);
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, wide), Equivalence::EQUAL);
+	e0 = a | (b < c);
+	e1 = Expression::vdd();
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, wide), Equivalence::EQUAL);
+
+	e0 = a << Expression::intOf(1);
+	e1 = a + a;
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, narrow), Equivalence::EQUAL);
+
+	e0 = a - b;
+	e1 = b - a;
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, narrow), Equivalence::DIFFERENT);
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, wide), Equivalence::DIFFERENT);
+
+	// differ only when a is 63
+	e0 = (a + 1) > a;
+	e1 = a < 63;
+	EXPECT_EQ(equivalent(e0, e0.top, e1, e1.top, narrow), Equivalence::DIFFERENT);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/builder.h>
+#include <arithmetic/action.h>
+#include <arithmetic/algorithm.h>
+#include <arithmetic/generate.h>
+
+#include <chrono>
+#include <sstream>
+
+using namespace arithmetic;
+using namespace std;
+
+static string structure(const Expression &e) {
+	stringstream out;
+	e.print(out, true);
+	return out.str();
+}
+
+TEST(Builder, Same) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+	Expression expect = ((a+b)*(a+b) - c) < (a+b);
+
+	Builder bld;
+	Handle x = bld.varOf(0);
+	Handle y = bld.varOf(1);
+	Handle z = bld.of(c);
+	Handle sum = x+y;
+	Handle dut = ((sum)*(x+y) - z) < sum;
+	// the second x+y is the same operation
+	EXPECT_EQ(bld.expr.size(), 4u);
+	EXPECT_EQ(structure(bld.get(dut)), "let e0 = (v0+v1) in (((e0*e0)-v2)<e0)");
+	EXPECT_EQ(bld.get(dut).to_string(), expect.to_string());
+
+	Expression whole = bld.take(dut);
+	EXPECT_EQ(whole.to_string(), expect.to_string());
+	EXPECT_EQ(bld.expr.size(), 0u);
+}
+
+TEST(Builder, Guard) {
+	// Parallel::guard() must build the same guard as the Expression operators
+	Generator g(29);
+	g.useWires();
+	g.size = 6;
+	Parallel p = g.parallel(20);
+	Expression expect = Expression::vdd();
+	for (auto a = p.actions.begin(); a != p.actions.end(); a++) {
+		if (not a->rvalue.isConstant()) {
+			expect = expect & a->rvalue;
+		}
+	}
+	EXPECT_EQ(structure(p.guard()), structure(expect));
+
+	Choice c = g.choice(5, 3);
+	expect = Expression::gnd();
+	for (auto t = c.terms.begin(); t != c.terms.end(); t++) {
+		expect = expect | t->guard();
+	}
+	EXPECT_EQ(structure(c.guard()), structure(expect));
+}
+
+TEST(Builder, Linear) {
+	Generator g(31);
+	g.useWires();
+	g.vars = 64;
+
+	auto start = std::chrono::steady_clock::now();
+	Builder bld;
+	Handle result = bld.of(Value::vdd());
+	for (int i = 0; i < 100000; i++) {
+		result = result & (bld.of(g.leaf()) | bld.of(g.leaf()));
+	}
+	Expression e = bld.take(result);
+	EXPECT_GE(e.size(), 100000u);
+	EXPECT_LT(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 10.0);
+}
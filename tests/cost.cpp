@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/algorithm.h>
+#include <arithmetic/expression.h>
+#include <common/mapping.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+TEST(Cost, RippleAdd) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	vector<Type> vars({Type(1.0, 16.0, 0.0), Type(1.0, 16.0, 0.0)});
+
+	Expression dut = a+b;
+	Cost cost = arithmetic::cost(dut, dut.top, vars, Cost::RIPPLE);
+	EXPECT_EQ(cost.complexity, 16.0);
+	EXPECT_EQ(cost.critical, 16.0);
+
+	pair<Type, double> result = addTree(vars, Cost::RIPPLE);
+	EXPECT_EQ(result.first.width, 17.0);
+}
+
+TEST(Cost, AdderTree) {
+	vector<Expression> terms;
+	vector<Type> vars;
+	for (int i = 0; i < 8; i++) {
+		terms.push_back(Expression::varOf(i));
+		vars.push_back(Type(1.0, 16.0, 0.0));
+	}
+	Expression dut = add(terms);
+
+	Cost word = arithmetic::cost(dut, dut.top, vars, Cost::WORD);
+	Cost ripple = arithmetic::cost(dut, dut.top, vars, Cost::RIPPLE);
+	Cost lookahead = arithmetic::cost(dut, dut.top, vars, Cost::LOOKAHEAD);
+	cout << "word: " << word.complexity << " " << word.critical << endl;
+	cout << "ripple: " << ripple.complexity << " " << ripple.critical << endl;
+	cout << "lookahead: " << lookahead.complexity << " " << lookahead.critical << endl;
+
+	EXPECT_LT(ripple.critical, word.critical);
+	EXPECT_LT(lookahead.critical, ripple.critical);
+	EXPECT_GT(lookahead.complexity, ripple.complexity);
+	EXPECT_EQ(addTree(vars, Cost::RIPPLE).first.width, 19.0);
+}
+
+TEST(Cost, MultiplierTree) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+	vector<Type> vars({Type(1.0, 16.0, 0.0), Type(1.0, 16.0, 0.0), Type(1.0, 16.0, 0.0)});
+
+	Expression dut = a*b;
+	Cost ripple = arithmetic::cost(dut, dut.top, vars, Cost::RIPPLE);
+	Cost lookahead = arithmetic::cost(dut, dut.top, vars, Cost::LOOKAHEAD);
+	EXPECT_GT(ripple.complexity, 256.0);
+	EXPECT_LT(lookahead.critical, ripple.critical);
+	EXPECT_EQ(multiplyTree({vars[0], vars[1]}, Cost::RIPPLE).first.width, 32.0);
+
+	// Wide operands are cheaper as a chain of two-input multipliers than as a
+	// single tree over every partial product
+	dut = a*b*c;
+	dut.tidy();
+	ripple = arithmetic::cost(dut, dut.top, vars, Cost::RIPPLE);
+	lookahead = arithmetic::cost(dut, dut.top, vars, Cost::LOOKAHEAD);
+	cout << "ripple: " << ripple.complexity << " " << ripple.critical << endl;
+	cout << "lookahead: " << lookahead.complexity << " " << lookahead.critical << endl;
+	EXPECT_LT(lookahead.critical, ripple.critical);
+	EXPECT_LT(ripple.complexity, productTree(vars, Cost::RIPPLE).second);
+	EXPECT_EQ(multiplyTree(vars, Cost::RIPPLE).first.width, 48.0);
+
+	// Narrow operands share a single tree
+	vector<Type> narrow({Type(1.0, 2.0, 0.0), Type(1.0, 2.0, 0.0), Type(1.0, 2.0, 0.0)});
+	EXPECT_EQ(multiplyTree(narrow, Cost::RIPPLE).second, productTree(narrow, Cost::RIPPLE).second);
+
+	// Constants only scale the result
+	pair<Type, double> scaled = multiplyTree({Type(3.0, 0.0, 0.0), vars[0]}, Cost::RIPPLE);
+	EXPECT_EQ(scaled.second, 0.0);
+	EXPECT_EQ(scaled.first.coeff, 3.0);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/expression.h>
+#include <arithmetic/cube.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+TEST(Cube, State) {
+	State s;
+	s.push_back(Value::vdd());
+	s.push_back(Value::gnd());
+	s.push_back(Value::U());
+	s.push_back(Value::X());
+
+	Cube c = cubeOf(s);
+	EXPECT_EQ(c.get(0), Cube::VALID);
+	EXPECT_EQ(c.get(1), Cube::NEUTRAL);
+	EXPECT_EQ(c.get(2), Cube::ANY);
+	EXPECT_EQ(c.get(3), Cube::EMPTY);
+	EXPECT_EQ(::to_string(stateOf(c, 4)), ::to_string(s));
+}
+
+TEST(Cube, Lattice) {
+	// the cube operations agree with the value lattice
+	vector<Value> values({Value::X(), Value::gnd(), Value::vdd(), Value::U()});
+	for (auto v0 = values.begin(); v0 != values.end(); v0++) {
+		for (auto v1 = values.begin(); v1 != values.end(); v1++) {
+			State s0(0, *v0), s1(0, *v1);
+			Cube c0 = cubeOf(s0), c1 = cubeOf(s1);
+			EXPECT_EQ(::to_string(stateOf(c0 & c1, 1)), ::to_string(s0 & s1)) << *v0 << " " << *v1;
+			// isSubsetOf() and unionOf() don't treat a wire value as the
+			// same as itself, so only compare different values.
+			if (c0 != c1) {
+				EXPECT_EQ(c1.contains(c0), s0.isSubsetOf(s1)) << *v0 << " " << *v1;
+				EXPECT_EQ(::to_string(stateOf(c0 | c1, 1)), ::to_string(s0 | s1)) << *v0 << " " << *v1;
+			}
+		}
+	}
+}
+
+TEST(Cube, Region) {
+	State s0, s1;
+	s0.push_back(Value::vdd());
+	s1.push_back(Value::gnd());
+	s1.push_back(Value::vdd());
+
+	Region r;
+	r.states.push_back(s0);
+	r.states.push_back(s1);
+
+	Cover c = coverOf(r);
+	EXPECT_EQ(c.vars, 2);
+	ASSERT_EQ(c.cubes.size(), 2u);
+	EXPECT_EQ(c.cubes[0].get(1), Cube::ANY);
+
+	Region result = regionOf(c);
+	ASSERT_EQ(result.states.size(), 2u);
+	EXPECT_EQ(::to_string(result.states[1]), ::to_string(s1));
+	EXPECT_EQ(result.states[0].values[0].state, Value::VALID);
+	EXPECT_TRUE(result.states[0].values[1].isUnknown());
+}
+
+TEST(Cube, Expression) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	Cover f = coverOf((a & ~b) | c);
+	EXPECT_EQ(f.vars, 3);
+	EXPECT_EQ(f.cubes.size(), 2u);
+	EXPECT_EQ(f.literals(), 3);
+
+	// xor and the complement of a sum
+	EXPECT_EQ(coverOf(~(a | b)).cubes.size(), 1u);
+	EXPECT_EQ(coverOf(a ^ b).cubes.size(), 2u);
+	EXPECT_TRUE(coverOf(a | ~a).isTautology());
+	EXPECT_TRUE(coverOf(a & ~a).isEmpty());
+
+	Expression g = exprOf(f);
+	EXPECT_TRUE(implies(g, (a & ~b) | c));
+	EXPECT_TRUE(implies((a & ~b) | c, g));
+	EXPECT_TRUE(areSame(exprOf(Cover(3)), Expression::gnd()));
+
+	// a comparison is a cube variable of its own
+	vector<Operand> leaves;
+	Cover h = coverOf((a < b) & c, leaves);
+	ASSERT_EQ(h.vars, 4);
+	EXPECT_EQ(h.cubes.size(), 1u);
+	EXPECT_EQ(h.literals(), 2);
+	EXPECT_TRUE(leaves[3].isExpr());
+	EXPECT_TRUE(coverOf((a < b) | ~(a < b)).isTautology());
+	Expression k = exprOf(h, (a < b) & c, leaves);
+	EXPECT_TRUE(implies(k, (a < b) & c));
+	EXPECT_TRUE(implies((a < b) & c, k));
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/expression.h>
+#include <arithmetic/espresso.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+static Cube cubeOf(int vars, string lits) {
+	Cube result(vars);
+	for (int v = 0; v < (int)lits.size(); v++) {
+		if (lits[v] == '0') {
+			result.set(v, Cube::NEUTRAL);
+		} else if (lits[v] == '1') {
+			result.set(v, Cube::VALID);
+		}
+	}
+	return result;
+}
+
+TEST(Espresso, Cube) {
+	Cube a = cubeOf(3, "1--");
+	Cube ab = cubeOf(3, "11-");
+	Cube nb = cubeOf(3, "-0-");
+
+	EXPECT_TRUE(a.contains(ab));
+	EXPECT_FALSE(ab.contains(a));
+	EXPECT_EQ(ab.literals(), 2);
+	EXPECT_EQ(ab.distance(nb), 1);
+	EXPECT_TRUE((ab & nb).isEmpty());
+	EXPECT_EQ(a & nb, cubeOf(3, "10-"));
+	EXPECT_TRUE(Cube(40).isUniverse());
+	EXPECT_EQ(Cube(40).literals(), 0);
+}
+
+TEST(Espresso, Complement) {
+	uint32_t seed = 1;
+	for (int trial = 0; trial < 20; trial++) {
+		Cover f(6);
+		for (int i = 0; i < 5; i++) {
+			Cube c(6);
+			for (int v = 0; v < 6; v++) {
+				seed = seed*1103515245u + 12345u;
+				c.set(v, (seed>>16)%3 + 1);
+			}
+			f.push_back(c);
+		}
+
+		Cover r = f.complement();
+		EXPECT_TRUE((f & r).isEmpty());
+		EXPECT_TRUE((f | r).isTautology());
+		EXPECT_EQ(f.complementSupercube(), r.supercube());
+	}
+}
+
+TEST(Espresso, Cover) {
+	Cover f(2);
+	f.push_back(cubeOf(2, "11"));
+	f.push_back(cubeOf(2, "10"));
+	f.push_back(cubeOf(2, "01"));
+
+	Cover g = espresso(f);
+	EXPECT_EQ(g.cubes.size(), 2u);
+	EXPECT_EQ(g.literals(), 2);
+	EXPECT_TRUE(g.contains(cubeOf(2, "1-")));
+	EXPECT_TRUE(g.contains(cubeOf(2, "-1")));
+	EXPECT_FALSE(g.contains(cubeOf(2, "00")));
+
+	// don't cares let the cube grow
+	Cover h(2);
+	h.push_back(cubeOf(2, "11"));
+	Cover d(2);
+	d.push_back(cubeOf(2, "10"));
+	EXPECT_EQ(espresso(h, d).literals(), 1);
+}
+
+TEST(Espresso, Expression) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	Expression e = (a & b) | (a & ~b) | (~a & b);
+	Expression m = espresso(e);
+	EXPECT_TRUE(implies(e, m));
+	EXPECT_TRUE(implies(m, e));
+	EXPECT_EQ(m.size(), 1u);
+
+	// consensus term is redundant
+	e = (a & b) | (~a & c) | (b & c);
+	m = espresso(e);
+	EXPECT_TRUE(implies(e, m));
+	EXPECT_TRUE(implies(m, e));
+	EXPECT_LT(m.size(), e.size());
+
+	EXPECT_TRUE(espresso(a & ~a).isNeutral());
+	EXPECT_TRUE(espresso(a | ~a).isValid());
+
+	// unstable guards are left alone
+	e = a | Expression::X();
+	EXPECT_TRUE(areSame(espresso(e), e));
+}
+
+TEST(Espresso, Large) {
+	vector<Expression> v;
+	for (int i = 0; i < 24; i++) {
+		v.push_back(Expression::varOf(i));
+	}
+
+	// a chain of overlapping products, each covered twice
+	Expression e = Expression::gnd();
+	for (int i = 0; i+2 < 24; i++) {
+		e = e | (v[i] & v[i+1] & v[i+2]) | (v[i] & v[i+1] & ~v[i+2]);
+	}
+
+	Expression m = espresso(e);
+	EXPECT_TRUE(implies(e, m));
+	EXPECT_TRUE(implies(m, e));
+	EXPECT_LT(m.size(), e.size());
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/generate.h>
+#include <arithmetic/algorithm.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+static size_t depthOf(const Expression &e) {
+	map<size_t, size_t> height;
+	size_t result = 0;
+	for (ConstUpIterator i(e, {e.top}); not i.done(); ++i) {
+		size_t h = 0;
+		for (auto j = i->operands.begin(); j != i->operands.end(); j++) {
+			if (j->isExpr()) {
+				h = max(h, height[j->index]);
+			}
+		}
+		height[i->exprIndex] = h+1;
+		result = max(result, h+1);
+	}
+	return result;
+}
+
+TEST(Generate, Reproducible) {
+	Generator g0(42), g1(42), g2(43);
+	Expression e0 = g0.expression();
+	Expression e1 = g1.expression();
+	Expression e2 = g2.expression();
+	EXPECT_EQ(::to_string(e0), ::to_string(e1));
+	EXPECT_NE(::to_string(e0), ::to_string(e2));
+	EXPECT_EQ(::to_string(g0.state()), ::to_string(g1.state()));
+}
+
+TEST(Generate, Shape) {
+	Generator g(7);
+	g.size = 500;
+	g.vars = 4;
+	Expression e = g.expression();
+	EXPECT_GE(e.size(), 500u);
+
+	// every operation is reachable from the top
+	size_t reachable = 0;
+	for (ConstUpIterator i(e, {e.top}); not i.done(); ++i) {
+		reachable++;
+	}
+	EXPECT_EQ(reachable, e.size());
+
+	State s = g.state();
+	EXPECT_EQ(s.size(), 4u);
+	EXPECT_TRUE(evaluate(e, e.top, s).val.isValid());
+
+	g.depth = 6;
+	e = g.expression();
+	// joining the unused operations adds a few levels
+	EXPECT_LE(depthOf(e), 6u + 10u);
+
+	g.depth = 0;
+	g.sharing = 0.0;
+	e = g.expression();
+	// without sharing, the expression is a tree
+	map<size_t, int> fanout;
+	for (ConstUpIterator i(e, {e.top}); not i.done(); ++i) {
+		for (auto j = i->operands.begin(); j != i->operands.end(); j++) {
+			if (j->isExpr()) {
+				EXPECT_EQ(++fanout[j->index], 1);
+			}
+		}
+	}
+}
+
+TEST(Generate, Patterns) {
+	Generator g(3);
+	g.useWires();
+
+	Expression w = g.wide(Operation::WIRE_AND, 100);
+	EXPECT_EQ(w.size(), 1u);
+	EXPECT_EQ(w.getExpr(w.top.index)->operands.size(), 100u);
+
+	Expression c = g.chain(Operation::WIRE_OR, 100);
+	EXPECT_EQ(c.size(), 100u);
+	EXPECT_EQ(depthOf(c), 100u);
+
+	g.size = 8;
+	Choice ch = g.choice(3, 2);
+	EXPECT_EQ(ch.terms.size(), 3u);
+	EXPECT_EQ(ch.terms[0].actions.size(), 2u);
+}
+
+TEST(Generate, Large) {
+	Generator g(1);
+	g.size = 1000000;
+	Expression e = g.expression();
+	EXPECT_GE(e.size(), 1000000u);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/algorithm.h>
+#include <arithmetic/expression.h>
+#include <arithmetic/action.h>
+#include <arithmetic/bdd.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+TEST(Guard, Canonical) {
+	Bdd bdd;
+	Bdd::Node a = bdd.variable(0);
+	Bdd::Node b = bdd.variable(1);
+	Bdd::Node c = bdd.variable(2);
+
+	// distribution and de morgan give the same node
+	EXPECT_EQ(bdd.andOf(a, bdd.orOf(b, c)), bdd.orOf(bdd.andOf(a, b), bdd.andOf(a, c)));
+	EXPECT_EQ(bdd.notOf(bdd.andOf(a, b)), bdd.orOf(bdd.notOf(a), bdd.notOf(b)));
+	EXPECT_EQ(bdd.xorOf(a, a), Bdd::ZERO);
+	EXPECT_EQ(bdd.orOf(a, bdd.notOf(a)), Bdd::ONE);
+}
+
+TEST(Guard, Constant) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+
+	EXPECT_TRUE((a | ~a).isValid());
+	EXPECT_TRUE((a | ~a).isConstant());
+	EXPECT_TRUE((a & ~a).isNeutral());
+	EXPECT_TRUE(((a & b) | (a & ~b) | ~a).isValid());
+	EXPECT_FALSE((a & b).isConstant());
+	EXPECT_FALSE((a & b).isNeutral());
+
+	EXPECT_TRUE(Expression::X().isNull());
+	EXPECT_FALSE((a | Expression::X()).isNull());
+	EXPECT_TRUE(((a | ~a) & Expression::X()).isNull());
+	EXPECT_FALSE(((a | ~a) & Expression::X()).isConstant());
+	EXPECT_TRUE(((a & ~a) & Expression::X()).isNeutral());
+
+	// constants are still folded
+	EXPECT_TRUE((Expression::intOf(3) + Expression::intOf(4)).isConstant());
+	EXPECT_FALSE((a + Expression::intOf(1)).isConstant());
+	// the same comparison is the same atom
+	EXPECT_TRUE(((a < b) | ~(a < b)).isValid());
+}
+
+TEST(Guard, Mutex) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	EXPECT_TRUE(areMutex(a & b, ~a & c));
+	EXPECT_FALSE(areMutex(a & b, b & c));
+	EXPECT_TRUE(implies(a & b, a | c));
+	EXPECT_FALSE(implies(a | c, a & b));
+
+	Choice mutex({Parallel(a & b), Parallel(~a & c), Parallel(a & ~b)});
+	EXPECT_TRUE(mutex.isMutex());
+	Choice overlap({Parallel(a & b), Parallel(b & c)});
+	EXPECT_FALSE(overlap.isMutex());
+}
+
+TEST(Guard, Values) {
+	Expression a = Expression::varOf(0);
+	Expression c = Expression::varOf(2);
+
+	// every valid integer isn't the same value, so this depends on c
+	Expression pick(Operation::TERNARY, {c, Expression::intOf(3), Expression::intOf(5)});
+	EXPECT_FALSE(pick.isConstant());
+	EXPECT_FALSE(pick.isValid());
+	EXPECT_FALSE(pick.isNeutral());
+	// the same ternary over wires is still decided
+	EXPECT_TRUE(Expression(Operation::TERNARY, {c, a | ~a, Expression::vdd()}).isValid());
+
+	// a guard that can never pass stays that way
+	Parallel never({Action(a & ~a)});
+	EXPECT_TRUE(never.guard().isNeutral());
+	Choice choice({never, Parallel(a), Parallel(~a | c)});
+	EXPECT_FALSE(choice.isMutex());
+	Choice exclusive({never, Parallel(a)});
+	EXPECT_TRUE(exclusive.isMutex());
+}
+
+TEST(Guard, WeakestGuard) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	// only ~b is needed to stay exclusive with b
+	Expression dut = weakestGuard(a & ~b & c, b);
+	EXPECT_EQ(dut.to_string(), (~b).to_string());
+	EXPECT_TRUE(areMutex(dut, b));
+
+	// both terms are needed
+	dut = weakestGuard(a & b & c, ~a | ~b);
+	EXPECT_TRUE(areMutex(dut, ~a | ~b));
+	EXPECT_TRUE(implies(dut, a & b));
+	EXPECT_TRUE(implies(a & b, dut));
+
+	// already overlapping, so it can't be weakened
+	dut = weakestGuard(a & b, a);
+	EXPECT_EQ(dut.to_string(), (a & b).to_string());
+}
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/kernel.h>
+#include <arithmetic/algorithm.h>
+#include <arithmetic/generate.h>
+
+#include <cmath>
+
+using namespace arithmetic;
+using namespace std;
+
+// some generated operators have no meaningful delay and give nan
+static bool same(double a, double b) {
+	return a == b or (std::isnan(a) and std::isnan(b));
+}
+
+// The kernels must give the same answer no matter which set they run on
+TEST(Kernel, Same) {
+	Generator g(31);
+	g.size = 40;
+	g.vars = 4;
+	g.sharing = 0.5;
+
+	vector<Type> vars(g.vars, Type(1.0, 16.0, 0.0));
+	for (int i = 0; i < 100; i++) {
+		Expression e = g.expression();
+		ConstOperationSet erased(e);
+
+		vector<size_t> order;
+		for (ConstUpIterator j(erased, {e.top}); not j.done(); ++j) {
+			order.push_back(j->exprIndex);
+		}
+		vector<size_t> inlined;
+		for (ConstUpIteratorOn<Expression> j(e, {e.top}); not j.done(); ++j) {
+			inlined.push_back(j->exprIndex);
+		}
+		EXPECT_EQ(order, inlined) << i;
+
+		State s = g.state();
+		Value expect = evaluate(erased, e.top, s).val;
+		EXPECT_TRUE(areSame(evaluate(e, e.top, s).val, expect)) << i;
+		EXPECT_TRUE(areSame(evaluate(e.sub, e.top, s).val, expect)) << i;
+
+		Cost c0 = cost(erased, e.top, vars);
+		Cost c1 = cost(e, e.top, vars);
+		Cost c2 = cost(e.sub, e.top, vars);
+		EXPECT_TRUE(same(c0.complexity, c1.complexity)) << i;
+		EXPECT_TRUE(same(c0.critical, c1.critical)) << i;
+		EXPECT_TRUE(same(c0.complexity, c2.complexity)) << i;
+		EXPECT_TRUE(same(c0.critical, c2.critical)) << i;
+	}
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/algorithm.h>
+#include <arithmetic/expression.h>
+#include <arithmetic/rewrite.h>
+#include <arithmetic/parser.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+TEST(Parser, RoundTrip) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	vector<Expression> tests({
+		(a + 3) * (b | ~c) - Expression::realOf(2.5),
+		(a & ~a) | (b ^ c),
+		!(a && b) || booleanXor(a, c),
+		(a < b) == (b >= c),
+		isValid(a) & isTrue(b) & isNegative(c) & inv(a),
+		(a << 2) >> (b % Expression::intOf(-4)),
+		cast("int", a + b) / -c,
+		call("max", {a, b, c}),
+		arithmetic::array({a, b, c})(b, c),
+		construct("point", {a, b}),
+		each(a, a & b),
+		(a == Expression::gnd()) | (b != Expression::vdd()) | Expression::X() | Expression::U(),
+	});
+
+	for (auto i = tests.begin(); i != tests.end(); i++) {
+		Expression dut = parseExpression(i->to_string());
+		EXPECT_EQ(dut.to_string(), i->to_string());
+	}
+}
+
+TEST(Parser, Precedence) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	EXPECT_EQ(parseExpression("a + b * c").to_string(), (a + (b * c)).to_string());
+	EXPECT_EQ(parseExpression("a - b - c").to_string(), ((a - b) - c).to_string());
+	EXPECT_EQ(parseExpression("a & ~b > gnd").to_string(), ((a & ~b) > Expression::gnd()).to_string());
+	EXPECT_EQ(parseExpression("a | b & c").to_string(), (a | (b & c)).to_string());
+	EXPECT_EQ(parseExpression("a || b && c").to_string(), (a || (b && c)).to_string());
+	EXPECT_EQ(parseExpression("-a * b").to_string(), ((-a) * b).to_string());
+	EXPECT_EQ(parseExpression("v2 + v0").to_string(), (c + a).to_string());
+}
+
+TEST(Parser, Rules) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+
+	RuleSet expect({
+		(~(~a)) > (isValid(a)),
+		(a & ~a) > Expression::gnd(),
+		(a | ~a) > Expression::vdd(),
+		(a + b) == (b + a),
+	});
+
+	RuleSet dut = parseRules(
+		"# wire identities\n"
+		"~~a > valid(a)\n"
+		"a & ~a > gnd; a | ~a > vdd\n"
+		"// spread over two lines\n"
+		"(a +\n"
+		"  b) == b + a\n");
+	ASSERT_EQ(dut.rules.size(), expect.rules.size());
+	for (size_t i = 0; i < dut.rules.size(); i++) {
+		EXPECT_EQ(dut.rules[i].directed, expect.rules[i].directed);
+		EXPECT_EQ(to_string(dut.sub, dut.rules[i].left, false), to_string(expect.sub, expect.rules[i].left, false));
+		EXPECT_EQ(to_string(dut.sub, dut.rules[i].right, false), to_string(expect.sub, expect.rules[i].right, false));
+	}
+
+	Expression test = (b & ~b) | (a | ~a);
+	EXPECT_EQ(test.minimized(dut).to_string(), test.minimized(expect).to_string());
+}
+
+TEST(Parser, Errors) {
+	Parser parser;
+	Expression dut;
+	EXPECT_FALSE(parser.parse("a +", 3, dut));
+	EXPECT_FALSE(parser.parse("(a", 2, dut));
+	EXPECT_FALSE(parser.parse("a b", 3, dut));
+	EXPECT_TRUE(parser.error.find("line 1") != string::npos);
+	string big = "v99999999999999999999999 + 1";
+	EXPECT_FALSE(parser.parse(big.c_str(), big.size(), dut));
+	EXPECT_TRUE(parser.error.find("too large") != string::npos);
+	big = "99999999999999999999 + 1";
+	EXPECT_FALSE(parser.parse(big.c_str(), big.size(), dut));
+	EXPECT_TRUE(parser.error.find("out of range") != string::npos);
+	big = "1e999";
+	EXPECT_FALSE(parser.parse(big.c_str(), big.size(), dut));
+	EXPECT_TRUE(parser.error.find("out of range") != string::npos);
+
+	// long literals aren't truncated
+	string tiny = "0." + string(70, '0') + "1";
+	ASSERT_TRUE(parser.parse(tiny.c_str(), tiny.size(), dut));
+	ASSERT_TRUE(dut.top.isConst());
+	EXPECT_GT(dut.top.cnst.rval, 0.0);
+
+	RuleSet rules;
+	string text = "a > b\na + b\n";
+	EXPECT_FALSE(parser.parseRules(text.c_str(), text.size(), rules));
+	EXPECT_TRUE(parser.error.find("line 2") != string::npos);
+	EXPECT_TRUE(rules.empty());
+}
+
+TEST(Parser, Shared) {
+	Expression dut;
+	Operand top = Operand::varOf(0);
+	for (int i = 0; i < 10; i++) {
+		top = dut.pushExpr(Operation(Operation::ADD, {top, Operand::varOf(1)}));
+		top = dut.pushExpr(Operation(Operation::MULTIPLY, {top, top}));
+	}
+	dut.top = top;
+
+	std::ostringstream shared;
+	dut.print(shared, true);
+	// only the operands of the multiplies are used twice
+	EXPECT_EQ(shared.str().find("let e0 = (v0+v1), e2 = ((e0*e0)+v1), "), 0u);
+	EXPECT_EQ(parseExpression(shared.str()).to_string(), dut.to_string());
+
+	// without sharing, the text doubles with every level
+	for (int i = 0; i < 40; i++) {
+		top = dut.pushExpr(Operation(Operation::ADD, {top, Operand::varOf(1)}));
+		top = dut.pushExpr(Operation(Operation::MULTIPLY, {top, top}));
+	}
+	dut.top = top;
+
+	shared.str("");
+	dut.print(shared, true);
+	EXPECT_LT(shared.str().size(), 50u*dut.size());
+}
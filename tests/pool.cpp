@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/pool.h>
+#include <arithmetic/algorithm.h>
+#include <arithmetic/generate.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+TEST(Pool, Share) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	ExpressionPool pool;
+	Operand x = pool.set("x", (a+b)*c);
+	Operand y = pool.set("y", c*(b+a));
+	EXPECT_EQ(x, y);
+	EXPECT_EQ(pool.size(), 2u);
+
+	Operand z = pool.set("z", (a+b)-c);
+	EXPECT_NE(x, z);
+	EXPECT_EQ(pool.size(), 3u);
+	EXPECT_EQ(pool.at("w"), Operand::undef());
+
+	// a+b is used by two operations, x and y are the same root
+	Operand sum = pool.getExpr(z.index)->operands[0];
+	EXPECT_EQ(pool.refs[sum.index], 2u);
+	EXPECT_EQ(pool.refs[x.index], 2u);
+}
+
+TEST(Pool, Constants) {
+	// commutative operands are ordered before hashing, constants included
+	ExpressionPool pool;
+	Operand x = pool.intern(Operation(Operation::ADD, {Operand::intOf(1), Operand::intOf(2), Operand::varOf(0)}));
+	Operand y = pool.intern(Operation(Operation::ADD, {Operand::intOf(2), Operand::varOf(0), Operand::intOf(1)}));
+	EXPECT_EQ(x, y);
+	EXPECT_EQ(pool.size(), 1u);
+
+	Operand z = pool.intern(Operation(Operation::ADD, {Operand::intOf(3), Operand::intOf(2), Operand::varOf(0)}));
+	EXPECT_NE(x, z);
+	EXPECT_EQ(pool.size(), 2u);
+}
+
+TEST(Pool, Collect) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	ExpressionPool pool;
+	pool.set("x", (a+b)*c);
+	pool.set("y", (a+b)-c);
+	EXPECT_EQ(pool.collect(), 0u);
+
+	EXPECT_TRUE(pool.erase("x"));
+	EXPECT_FALSE(pool.erase("x"));
+	// the product is unreferenced but stays until it is collected
+	EXPECT_EQ(pool.size(), 3u);
+	EXPECT_EQ(pool.collect(), 1u);
+	EXPECT_EQ(pool.size(), 2u);
+
+	// replacing a root releases the old one
+	pool.set("y", c);
+	EXPECT_EQ(pool.collect(), 2u);
+	EXPECT_EQ(pool.size(), 0u);
+	EXPECT_TRUE(pool.table.empty());
+
+	// the pool is still usable after everything is removed
+	pool.set("x", (a+b)*c);
+	EXPECT_EQ(pool.size(), 2u);
+}
+
+TEST(Pool, Evaluate) {
+	Generator g(23);
+	g.size = 30;
+	g.vars = 4;
+
+	ExpressionPool pool;
+	vector<Expression> exprs;
+	size_t total = 0;
+	for (int i = 0; i < 200; i++) {
+		exprs.push_back(g.expression());
+		total += exprs.back().size();
+		pool.set(::to_string(i), exprs.back());
+	}
+	// few distinct variables means there is a lot to share
+	EXPECT_LT(pool.size(), total);
+
+	for (int k = 0; k < 4; k++) {
+		State s = g.state();
+		map<string, ValRef> values = pool.evaluate(s);
+		ASSERT_EQ(values.size(), exprs.size());
+		for (int i = 0; i < (int)exprs.size(); i++) {
+			Value expect = evaluate(exprs[i], exprs[i].top, s).val;
+			EXPECT_TRUE(areSame(values[::to_string(i)].val, expect)) << i;
+			EXPECT_TRUE(areSame(evaluate(pool.get(::to_string(i)), pool.get(::to_string(i)).top, s).val, expect)) << i;
+		}
+	}
+}
@@ -3,6 +3,8 @@
 #include <arithmetic/algorithm.h>
 #include <arithmetic/expression.h>
 #include <arithmetic/rewrite.h>
+#include <arithmetic/builtin.h>
+#include <arithmetic/generate.h>
 #include <common/mapping.h>
 #include <common/text.h>
 
@@ -73,3 +75,422 @@ TEST(Rewrite, Commutative) {
 }
 
 
+
+TEST(Rewrite, Hash) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	Expression e0 = (a+b)*c;
+	Expression e1 = c*(b+a);
+	e0.tidy();
+	e1.tidy();
+	EXPECT_EQ(hashOf(e0, e0.top), hashOf(e1, e1.top));
+
+	Expression e2 = (a-b)*c;
+	e2.tidy();
+	EXPECT_NE(hashOf(e0, e0.top), hashOf(e2, e2.top));
+}
+
+TEST(Rewrite, Optimize) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	vector<Type> vars({Type(1.0, 16.0, 0.0), Type(1.0, 16.0, 0.0)});
+
+	// negating the product is more expensive than negating an input
+	Expression dut = -(a*b);
+	Cost before = cost(dut, dut.top, vars);
+
+	OptimizeOptions options;
+	options.depth = 4;
+	Expression opt = optimize(dut, vars, RuleSet(), RuleSet(), options);
+	Cost after = cost(opt, opt.top, vars);
+	cout << dut << " -> " << opt << endl;
+	EXPECT_LT(options.score(after), options.score(before));
+
+	State s;
+	s.push_back(Value::intOf(7));
+	s.push_back(Value::intOf(-3));
+	EXPECT_TRUE(areSame(evaluate(dut, dut.top, s).val, evaluate(opt, opt.top, s).val));
+
+	// the timeout also bounds the search and minimize inside of each step
+	Generator g(5);
+	g.size = 300;
+	g.vars = 4;
+	dut = g.expression();
+	vars.assign(g.vars, Type(1.0, 16.0, 0.0));
+	options.depth = 100;
+	options.beamWidth = 0;
+	options.timeout = 0.01;
+	auto start = std::chrono::steady_clock::now();
+	opt = optimize(dut, vars, RuleSet(), RuleSet(), options);
+	EXPECT_LT(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1.0);
+	for (int i = 0; i < 4; i++) {
+		s = g.state();
+		EXPECT_TRUE(areSame(evaluate(dut, dut.top, s).val, evaluate(opt, opt.top, s).val));
+	}
+}
+
+TEST(Rewrite, ParallelSearch) {
+	vector<Expression> terms;
+	for (int i = 0; i < 16; i++) {
+		Expression v = Expression::varOf(i);
+		terms.push_back((v+0) & (v | v));
+	}
+	Expression dut = wireOr(terms);
+
+	RuleSet rules = rewriteCanonical() + rewriteSimple();
+	SearchOptions options;
+	options.threads = 4;
+	for (size_t count = 0; count < 4; count++) {
+		options.count = count;
+		vector<Match> seq = search(dut, {dut.top}, rules, count);
+		vector<Match> par = search(dut, {dut.top}, rules, options);
+		EXPECT_GT(seq.size(), 0u);
+		ASSERT_EQ(seq.size(), par.size());
+		for (size_t i = 0; i < seq.size(); i++) {
+			EXPECT_EQ(seq[i].expr, par[i].expr);
+			EXPECT_EQ(seq[i].replace, par[i].replace);
+			EXPECT_EQ(seq[i].top, par[i].top);
+		}
+	}
+}
+
+// Stopping at a small count is where a worker could skip a seed it already
+// claimed, so repeat it to give the scheduler a chance to interleave
+TEST(Rewrite, ParallelSearchCount) {
+	vector<Expression> terms;
+	for (int i = 0; i < 32; i++) {
+		Expression v = Expression::varOf(i);
+		terms.push_back((v+0) & (v | v));
+	}
+	Expression dut = wireOr(terms);
+
+	RuleSet rules = rewriteCanonical() + rewriteSimple();
+	SearchOptions options;
+	options.threads = 8;
+	for (size_t count = 1; count < 4; count++) {
+		options.count = count;
+		vector<Match> seq = search(dut, {dut.top}, rules, count);
+		ASSERT_EQ(seq.size(), count);
+		for (int run = 0; run < 100; run++) {
+			vector<Match> par = search(dut, {dut.top}, rules, options);
+			ASSERT_EQ(seq.size(), par.size()) << "run " << run;
+			for (size_t i = 0; i < seq.size(); i++) {
+				EXPECT_EQ(seq[i].expr, par[i].expr) << "run " << run;
+				EXPECT_EQ(seq[i].replace, par[i].replace) << "run " << run;
+				EXPECT_EQ(seq[i].top, par[i].top) << "run " << run;
+			}
+		}
+	}
+}
+
+TEST(Rewrite, WideCommutative) {
+	Expression a = Expression::varOf(0);
+	Expression gnd = Expression::gnd();
+	auto rules = RuleSet({
+		(a & ~a) > (gnd),
+	});
+
+	// The same operand appearing several times in a flattened node should only
+	// be matched once.
+	Expression dut = Expression::varOf(7);
+	for (int i = 0; i < 24; i++) {
+		dut = dut & Expression::varOf(i);
+	}
+	dut = dut & Expression::varOf(7) & ~Expression::varOf(7);
+	dut.tidy();
+	ASSERT_GT(dut.getExpr(dut.top.index)->operands.size(), 24u);
+
+	vector<Match> found = search(dut, {dut.top}, rules, 0);
+	ASSERT_EQ(found.size(), 1u);
+	EXPECT_EQ(found[0].top.size(), 2u);
+}
+
+TEST(Rewrite, Automaton) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	RuleSet rules = rewriteCanonical() + rewriteSimple();
+
+	Expression x = a & ~a;
+	Expression y = b & ~b;
+	Expression dut = (x | y) + c;
+	Labeling labels = label(rules, dut, {dut.top});
+
+	// structurally identical subexpressions land in the same state
+	const Operation *wor = dut.sub.getExpr(dut.sub.getExpr(dut.top.index)->operands[0].index);
+	size_t ex = wor->operands[0].index;
+	size_t ey = wor->operands[1].index;
+	EXPECT_EQ(labels.label[ex], labels.label[ey]);
+	EXPECT_FALSE(labels.at(ex).empty());
+
+	// the automaton only keeps a few of the rules at each expression
+	vector<Operand> idx = dut.exprIndex();
+	for (auto i = idx.begin(); i != idx.end(); i++) {
+		EXPECT_LT(labels.at(i->index).size(), rules.rules.size()/4);
+	}
+
+	// The automaton is only a filter, so it must never drop a match. Search
+	// every expression of some generated ones again with a labeling that
+	// accepts every rule start everywhere.
+	vector<size_t> every;
+	for (size_t j = 0; j < rules.rules.size(); j++) {
+		every.push_back(j*2);
+		if (not rules.rules[j].directed) {
+			every.push_back(j*2+1);
+		}
+	}
+
+	size_t total = 0;
+	for (uint64_t seed = 1; seed <= 8; seed++) {
+		Generator g(seed);
+		if (seed%2 == 0) {
+			g.useWires();
+		}
+		g.size = 24;
+		g.vars = 3;
+		Expression e = g.expression();
+		e.tidy();
+
+		Labeling filtered = label(rules, e, {e.top});
+		Labeling all;
+		size_t state = all.stateOf(vector<size_t>(), every);
+		idx = e.exprIndex();
+		for (auto i = idx.begin(); i != idx.end(); i++) {
+			if (i->index >= all.label.size()) {
+				all.label.resize(i->index+1, std::numeric_limits<size_t>::max());
+			}
+			all.label[i->index] = state;
+		}
+
+		for (auto i = idx.begin(); i != idx.end(); i++) {
+			vector<string> expect, actual;
+			vector<Match> found = searchAt(e, *i, {e.top}, rules, all);
+			for (auto m = found.begin(); m != found.end(); m++) {
+				expect.push_back(::to_string(*m));
+			}
+			found = searchAt(e, *i, {e.top}, rules, filtered);
+			for (auto m = found.begin(); m != found.end(); m++) {
+				actual.push_back(::to_string(*m));
+			}
+			sort(expect.begin(), expect.end());
+			sort(actual.begin(), actual.end());
+			EXPECT_EQ(actual, expect) << e.to_string() << " at " << i->index;
+			total += expect.size();
+		}
+	}
+	EXPECT_GT(total, 0u);
+}
+
+TEST(Rewrite, Comprehension) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+
+	Expression w = Expression::varOf(0);
+	Expression x = Expression::varOf(1);
+	Expression y = Expression::varOf(2);
+	Expression z = Expression::varOf(3);
+
+	// distribute over a wide or in a single rewrite
+	auto distribute = RuleSet({
+		(a & wireOr(b)) > wireOr(each(b, a & b)),
+	});
+
+	Expression dut = w & (x | y | z);
+	dut.minimize(distribute);
+	Expression exp = (w & x) | (w & y) | (w & z);
+	exp.tidy();
+	EXPECT_EQ(dut.to_string(), exp.to_string());
+
+	// factor out of only the operands that match
+	auto factor = RuleSet({
+		wireOr(each(b, a & b)) > (a & wireOr(b)),
+	});
+
+	dut = (w & x) | (w & y) | z;
+	dut.minimize(factor);
+	exp = (w & (x | y)) | z;
+	exp.tidy();
+	EXPECT_EQ(dut.to_string(), exp.to_string());
+
+	// a & b can't match a conjunct with three operands, that would drop one
+	Expression v = Expression::varOf(4);
+	Expression orig = (w & v & x) | (w & y);
+	dut = orig;
+	dut.minimize(factor);
+	for (int i = 0; i < 32; i++) {
+		State s;
+		for (int j = 0; j < 5; j++) {
+			s.push_back(((i>>j)&1) ? Value::vdd() : Value::gnd());
+		}
+		EXPECT_TRUE(areSame(evaluate(dut, dut.top, s).val, evaluate(orig, orig.top, s).val));
+	}
+}
+
+TEST(Rewrite, Builtin) {
+	for (int i = 0; i < Builtin::COUNT; i++) {
+		// the tables are generated at build time
+		EXPECT_GT(Builtin::size[i], 0u) << Builtin::name(i);
+		EXPECT_EQ(::to_string(Builtin::get(i)), ::to_string(Builtin::build(i))) << Builtin::name(i);
+	}
+
+	// an unknown index reports an error and yields no rules
+	EXPECT_TRUE(Builtin::get(-1).empty());
+	EXPECT_TRUE(Builtin::get(Builtin::COUNT).empty());
+}
+
+TEST(Rewrite, Budget) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression x = Expression::varOf(0);
+	Expression y = Expression::varOf(1);
+
+	// these never stop on their own
+	auto cycle = RuleSet({
+		(a*b) > (b+a),
+		(a+b) > (b*a),
+	});
+	auto grow = RuleSet({
+		(-a) > (-(-(-a))),
+	});
+
+	MinimizeOptions options;
+	options.maxRewrites = 10;
+	Expression dut = x*y;
+	EXPECT_EQ(dut.minimize(cycle, options), MinimizeResult::REWRITES);
+
+	MinimizeResult result = minimize(dut, {dut.top}, cycle, options);
+	EXPECT_EQ(result.status, MinimizeResult::REWRITES);
+	EXPECT_EQ(result.rewrites, 10u);
+
+	// the expression is still usable
+	dut.top = result.mapping.map(dut.top);
+	State s;
+	s.set(0, Value::intOf(3));
+	s.set(1, Value::intOf(4));
+	Value v = evaluate(dut, dut.top, s).val;
+	EXPECT_TRUE(areSame(v, Value::intOf(7)) or areSame(v, Value::intOf(12)));
+
+	options = MinimizeOptions();
+	options.maxGrowth = 4.0;
+	dut = -x;
+	EXPECT_EQ(dut.minimize(grow, options), MinimizeResult::GROWTH);
+	EXPECT_LE(dut.size(), 6u);
+
+	options = MinimizeOptions();
+	options.timeout = 0.05;
+	dut = x*y;
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(dut.minimize(cycle, options), MinimizeResult::TIMEOUT);
+	EXPECT_LT(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 5.0);
+
+	CancelToken cancel;
+	cancel.cancel();
+	options = MinimizeOptions();
+	options.cancel = &cancel;
+	dut = x*y;
+	result = minimize(dut, {dut.top}, cycle, options);
+	EXPECT_EQ(result.status, MinimizeResult::CANCELLED);
+	EXPECT_EQ(result.rewrites, 0u);
+
+	// nothing is lost when the rules finish within the budget
+	options = MinimizeOptions();
+	options.maxRewrites = 100;
+	options.timeout = 10.0;
+	dut = (x+y)-(x+y);
+	EXPECT_EQ(dut.minimize(RuleSet(), options), MinimizeResult::DONE);
+	Expression exp = (x+y)-(x+y);
+	exp.minimize();
+	EXPECT_EQ(dut.to_string(), exp.to_string());
+}
+
+TEST(Rewrite, MinimizeAll) {
+	Generator g(17);
+	g.size = 40;
+	g.constants = 0.3;
+	vector<Expression> exprs;
+	for (int i = 0; i < 64; i++) {
+		g.size = 10 + i;
+		exprs.push_back(g.expression());
+	}
+
+	vector<Expression> expect = exprs;
+	RewriteStats one;
+	for (auto i = expect.begin(); i != expect.end(); i++) {
+		i->minimize(RuleSet(), &one);
+	}
+
+	RewriteStats all;
+	MinimizeOptions options;
+	options.stats = &all;
+	vector<int> status = minimizeAll(exprs, RuleSet(), options, 4);
+	ASSERT_EQ(status.size(), exprs.size());
+	for (size_t i = 0; i < exprs.size(); i++) {
+		EXPECT_EQ(status[i], MinimizeResult::DONE);
+		EXPECT_EQ(exprs[i].to_string(), expect[i].to_string()) << i;
+	}
+	EXPECT_EQ(all.replaces, one.replaces);
+	EXPECT_EQ(all.tidies, one.tidies);
+	EXPECT_EQ(all.nodesAfter, one.nodesAfter);
+
+	// the budget is per expression
+	exprs = vector<Expression>(8, Expression::varOf(0)*Expression::varOf(1));
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	options = MinimizeOptions();
+	options.maxRewrites = 5;
+	status = minimizeAll(exprs, RuleSet({(a*b) > (b+a), (a+b) > (b*a)}), options, 3);
+	for (auto i = status.begin(); i != status.end(); i++) {
+		EXPECT_EQ(*i, MinimizeResult::REWRITES);
+	}
+	for (auto i = exprs.begin(); i != exprs.end(); i++) {
+		EXPECT_EQ(i->to_string(), exprs[0].to_string());
+	}
+}
+
+TEST(Rewrite, Splice) {
+	auto ops = [](vector<int> idx) {
+		vector<Operand> result;
+		for (auto i = idx.begin(); i != idx.end(); i++) {
+			result.push_back(Operand::varOf(*i));
+		}
+		return result;
+	};
+
+	vector<Operand> with = ops({10, 11});
+	Operation o(Operation::ADD, ops({0, 1, 2, 3, 4, 5}));
+
+	// contiguous, same size
+	Operation dut = o;
+	dut.splice({1, 2}, with.data(), with.data()+2);
+	EXPECT_EQ(dut.operands, ops({0, 10, 11, 3, 4, 5}));
+
+	// contiguous, growing and shrinking
+	dut = o;
+	dut.splice({4}, with.data(), with.data()+2);
+	EXPECT_EQ(dut.operands, ops({0, 1, 2, 3, 10, 11, 5}));
+	dut = o;
+	dut.splice({0, 1, 2}, with.data(), with.data()+1);
+	EXPECT_EQ(dut.operands, ops({10, 3, 4, 5}));
+
+	// gaps between the removed operands
+	dut = o;
+	dut.splice({1, 3, 5}, with.data(), with.data()+2);
+	EXPECT_EQ(dut.operands, ops({0, 10, 11, 2, 4}));
+	dut = o;
+	dut.splice({0, 5}, with.data(), with.data());
+	EXPECT_EQ(dut.operands, ops({1, 2, 3, 4}));
+
+	// nothing removed
+	dut = o;
+	dut.splice({}, with.data(), with.data()+2);
+	EXPECT_EQ(dut.operands, ops({0, 1, 2, 3, 4, 5, 10, 11}));
+
+	// extract keeps the others in place
+	dut = o;
+	Operation part = dut.extract({1, 4}, 7);
+	EXPECT_EQ(dut.operands, vector<Operand>({Operand::varOf(0), Operand::exprOf(7), Operand::varOf(2), Operand::varOf(3), Operand::varOf(5)}));
+	EXPECT_EQ(part.operands, ops({4, 1}));
+}
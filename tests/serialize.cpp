@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/algorithm.h>
+#include <arithmetic/expression.h>
+#include <arithmetic/rewrite.h>
+#include <arithmetic/serialize.h>
+#include <common/text.h>
+
+using namespace arithmetic;
+using namespace std;
+
+TEST(Serialize, Expression) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression c = Expression::varOf(2);
+
+	Expression dut = (a + 3) * (b | ~c) - Expression::realOf(2.5) + cast("int", Expression::stringOf("x"));
+	string data = serialize(dut);
+
+	Expression result;
+	ASSERT_TRUE(deserialize(data.data(), data.size(), result));
+	EXPECT_EQ(result.top, dut.top);
+	EXPECT_EQ(result.exprIndex(), dut.exprIndex());
+	EXPECT_EQ(result.to_string(), dut.to_string());
+
+	// truncated data never decodes
+	EXPECT_FALSE(deserialize(data.data(), data.size()-1, result));
+	// the kind is checked
+	RuleSet rules;
+	EXPECT_FALSE(deserialize(data.data(), data.size(), rules));
+}
+
+TEST(Serialize, RuleSet) {
+	RuleSet rules = rewriteCanonical() + rewriteSimple();
+	string path = testing::TempDir() + "rules.bin";
+	ASSERT_TRUE(save(path, rules));
+
+	RuleSet result;
+	ASSERT_TRUE(load(path, result));
+	ASSERT_EQ(result.rules.size(), rules.rules.size());
+	EXPECT_EQ(::to_string(result), ::to_string(rules));
+
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression dut = (a & ~a) | (b - b);
+	EXPECT_EQ(dut.minimized(result).to_string(), dut.minimized(rules).to_string());
+}
+
+TEST(Serialize, State) {
+	State s;
+	s.push_back(Value::intOf(-5));
+	s.push_back(Value::vdd());
+	s.push_back(Value::arrOf({Value::boolOf(true), Value::realOf(0.25)}));
+	s.push_back(Value::structOf("point", {Value::intOf(1), Value::intOf(2)}));
+
+	Region r;
+	r.states.push_back(s);
+	r.states.push_back(State());
+
+	string data = serialize(r);
+	Region result;
+	ASSERT_TRUE(deserialize(data.data(), data.size(), result));
+	ASSERT_EQ(result.states.size(), 2u);
+	EXPECT_EQ(::to_string(result.states[0]), ::to_string(s));
+	EXPECT_TRUE(result.states[1].values.empty());
+}
+
+// Corrupt or hostile data must fail to decode instead of crashing or
+// allocating without bound
+TEST(Serialize, Corrupt) {
+	Expression result;
+
+	// an operation index far past anything reasonable
+	Encoder enc;
+	enc.header(Serial::EXPRESSION);
+	enc.u32(1);
+	encode(enc, Operation(Operation::ADD, {Operand::varOf(0), Operand::varOf(1)}, ((size_t)1) << 40));
+	encode(enc, Operand::varOf(0));
+	EXPECT_FALSE(deserialize(enc.data.data(), enc.data.size(), result));
+
+	// an operator that doesn't exist
+	enc = Encoder();
+	enc.header(Serial::EXPRESSION);
+	enc.u32(1);
+	enc.u64(0);
+	enc.u32(9999);
+	enc.u32(0);
+	encode(enc, Operand::exprOf(0));
+	EXPECT_FALSE(deserialize(enc.data.data(), enc.data.size(), result));
+
+	// an operand type that doesn't exist
+	enc = Encoder();
+	enc.header(Serial::EXPRESSION);
+	enc.u32(0);
+	enc.u8(7);
+	enc.u64(0);
+	EXPECT_FALSE(deserialize(enc.data.data(), enc.data.size(), result));
+
+	// a value type that doesn't exist
+	enc = Encoder();
+	enc.header(Serial::STATE);
+	enc.u32(1);
+	enc.u32((uint32_t)-100);
+	enc.u8(Value::VALID);
+	State s;
+	EXPECT_FALSE(deserialize(enc.data.data(), enc.data.size(), s));
+
+	// an operand that refers to an operation that isn't there
+	enc = Encoder();
+	enc.header(Serial::EXPRESSION);
+	enc.u32(1);
+	encode(enc, Operation(Operation::ADD, {Operand::exprOf(5), Operand::varOf(1)}, 0));
+	encode(enc, Operand::exprOf(0));
+	EXPECT_FALSE(deserialize(enc.data.data(), enc.data.size(), result));
+
+	// arrays nested too deep
+	enc = Encoder();
+	enc.header(Serial::STATE);
+	enc.u32(1);
+	for (int i = 0; i < 1000; i++) {
+		enc.u32((uint32_t)Value::ARRAY);
+		enc.u8(Value::VALID);
+		enc.u32(1);
+	}
+	enc.u32((uint32_t)Value::INT);
+	enc.u8(Value::VALID);
+	enc.i64(0);
+	EXPECT_FALSE(deserialize(enc.data.data(), enc.data.size(), s));
+
+	// flipping any byte of a valid expression either decodes to something
+	// consistent or fails cleanly
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression dut = (a + 3) * (b | ~a) - Expression::arrOf({Value::intOf(1), Value::intOf(2)});
+	string data = serialize(dut);
+	for (size_t i = 12; i < data.size(); i++) {
+		for (int bits : {0x01, 0x80, 0xFF}) {
+			string bad = data;
+			bad[i] ^= (char)bits;
+			if (deserialize(bad.data(), bad.size(), result) and result.top.isExpr()) {
+				EXPECT_NE(result.getExpr(result.top.index), nullptr);
+			}
+		}
+	}
+}
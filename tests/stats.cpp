@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/algorithm.h>
+#include <arithmetic/expression.h>
+#include <arithmetic/builtin.h>
+#include <arithmetic/generate.h>
+
+#include <sstream>
+
+using namespace arithmetic;
+using namespace std;
+
+TEST(Stats, Minimize) {
+	Expression a = Expression::varOf(0);
+	Expression b = Expression::varOf(1);
+	Expression e = (a+b)-(a+b)+a*Expression(Value::intOf(1));
+
+	RewriteStats stats;
+	e.minimize(RuleSet(), &stats);
+
+	stringstream out;
+	stats.print(out, Builtin::get(Builtin::DEFAULT));
+	EXPECT_FALSE(out.str().empty());
+
+	if (not RewriteStats::enabled()) {
+		// compiled out, nothing is recorded
+		EXPECT_TRUE(stats.rules.empty());
+		EXPECT_EQ(stats.searches, 0u);
+		EXPECT_EQ(stats.tidies, 0u);
+		return;
+	}
+
+	size_t attempts = 0, matches = 0;
+	for (auto i = stats.rules.begin(); i != stats.rules.end(); i++) {
+		attempts += i->attempts;
+		matches += i->matches;
+		EXPECT_LE(i->matches, i->attempts);
+	}
+	EXPECT_GT(matches, 0u);
+	EXPECT_GE(attempts, matches);
+	EXPECT_EQ(stats.replaces, matches);
+	EXPECT_EQ(stats.tidies, stats.replaces+1);
+	EXPECT_EQ(stats.searches, stats.replaces+1);
+	EXPECT_GT(stats.peakDepth, 0u);
+	EXPECT_GT(stats.nodesBefore, stats.nodesAfter);
+	EXPECT_GT(stats.seconds, 0.0);
+	EXPECT_NE(out.str().find("attempts"), string::npos);
+}
+
+TEST(Stats, Threads) {
+	Generator g(5);
+	g.size = 200;
+	Expression e = g.expression();
+	e.tidy();
+	RuleSet rules = Builtin::get(Builtin::DEFAULT);
+
+	RewriteStats one, four;
+	SearchOptions sequential, parallel;
+	sequential.stats = &one;
+	parallel.threads = 4;
+	parallel.stats = &four;
+	vector<Match> m1 = arithmetic::search(e, {e.top}, rules, sequential);
+	vector<Match> m4 = arithmetic::search(e, {e.top}, rules, parallel);
+	EXPECT_EQ(m1.size(), m4.size());
+
+	// every seed is searched either way, so the counts agree
+	EXPECT_EQ(one.seeds, four.seeds);
+	EXPECT_EQ(one.peakDepth, four.peakDepth);
+	ASSERT_EQ(one.rules.size(), four.rules.size());
+	for (size_t i = 0; i < one.rules.size(); i++) {
+		EXPECT_EQ(one.rules[i].attempts, four.rules[i].attempts);
+		EXPECT_EQ(one.rules[i].matches, four.rules[i].matches);
+	}
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <arithmetic/trace.h>
+#include <arithmetic/algorithm.h>
+#include <arithmetic/action.h>
+#include <arithmetic/builtin.h>
+#include <arithmetic/generate.h>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace arithmetic;
+using namespace std;
+
+static size_t countOf(const string &text, const string &pattern) {
+	size_t result = 0;
+	for (size_t i = text.find(pattern); i != string::npos; i = text.find(pattern, i+1)) {
+		result++;
+	}
+	return result;
+}
+
+static string readFile(string path) {
+	std::ifstream fin(path.c_str());
+	stringstream buf;
+	buf << fin.rdbuf();
+	return buf.str();
+}
+
+TEST(Trace, Events) {
+	string path = ::testing::TempDir() + "arithmetic_trace.json";
+	EXPECT_FALSE(tracing());
+	traceStart(path);
+	EXPECT_TRUE(tracing());
+
+	Generator g(11);
+	g.size = 100;
+	Expression e = g.expression();
+	evaluate(e, e.top, g.state());
+	e.minimize();
+	SearchOptions options;
+	options.threads = 2;
+	arithmetic::search(e, {e.top}, Builtin::get(Builtin::DEFAULT), options);
+	g.size = 4;
+	g.choice(2, 2).evaluate(g.state());
+
+	ASSERT_TRUE(traceStop());
+	EXPECT_FALSE(tracing());
+
+	string text = readFile(path);
+	EXPECT_EQ(text.find("{\"traceEvents\":["), 0u);
+	EXPECT_EQ(countOf(text, "\"name\":\"minimize\""), 1u);
+	EXPECT_GE(countOf(text, "\"name\":\"search\""), 2u);
+	EXPECT_GE(countOf(text, "\"name\":\"tidy\""), 1u);
+	EXPECT_GE(countOf(text, "\"name\":\"evaluate\""), 1u);
+	EXPECT_EQ(countOf(text, "\"name\":\"Choice::evaluate\""), 1u);
+	EXPECT_EQ(countOf(text, "\"name\":\"search/worker\""), 2u);
+
+	// nothing is recorded once tracing stops
+	evaluate(e, e.top, g.state());
+	stringstream out;
+	traceWrite(out);
+	EXPECT_EQ(countOf(out.str(), "\"ph\":\"X\""), countOf(text, "\"ph\":\"X\""));
+}
+
+TEST(Trace, Wrap) {
+	string path = ::testing::TempDir() + "arithmetic_trace_wrap.json";
+	traceStart(path, 16);
+
+	// a new thread gets a buffer with the new capacity
+	std::thread t([]() {
+		for (int i = 0; i < 100; i++) {
+			TraceScope trace("wrap");
+		}
+	});
+	t.join();
+
+	ASSERT_TRUE(traceStop());
+	EXPECT_EQ(countOf(readFile(path), "\"name\":\"wrap\""), 16u);
+}
+
+TEST(Trace, Reuse) {
+	string path = ::testing::TempDir() + "arithmetic_trace_reuse.json";
+	traceStart(path, 64);
+
+	// threads that come and go share the buffers of the ones that exited
+	size_t before = traceBuffers();
+	for (int i = 0; i < 20; i++) {
+		std::thread t([]() {
+			TraceScope trace("reuse");
+		});
+		t.join();
+	}
+	EXPECT_LE(traceBuffers(), before+1u);
+
+	ASSERT_TRUE(traceStop());
+	EXPECT_EQ(countOf(readFile(path), "\"name\":\"reuse\""), 20u);
+}
+
+TEST(Trace, Concurrent) {
+	string path = ::testing::TempDir() + "arithmetic_trace_concurrent.json";
+	traceStart(path, 32);
+	// events from an earlier trace are never written
+	{
+		TraceScope trace("stale");
+	}
+	traceStart(path, 32);
+
+	std::atomic<bool> done(false);
+	vector<std::thread> threads;
+	for (int t = 0; t < 2; t++) {
+		threads.push_back(std::thread([&]() {
+			while (not done.load()) {
+				TraceScope trace("busy");
+			}
+		}));
+	}
+
+	// writing while the other threads record only ever sees whole events
+	for (int i = 0; i < 50; i++) {
+		stringstream out;
+		traceWrite(out);
+		string text = out.str();
+		EXPECT_EQ(countOf(text, "\"name\":\"stale\""), 0u);
+		EXPECT_EQ(countOf(text, "\"name\":\"busy\""), countOf(text, "\"ph\":\"X\""));
+		EXPECT_LE(countOf(text, "\"ph\":\"X\""), 64u);
+	}
+
+	done.store(true);
+	for (auto t = threads.begin(); t != threads.end(); t++) {
+		t->join();
+	}
+	ASSERT_TRUE(traceStop());
+}
@@ -0,0 +1,46 @@
+// Generates the precompiled built in rule sets. This is linked against the
+// library without the generated tables, so it provides empty ones and the
+// rule sets are built directly.
+
+#include <arithmetic/builtin.h>
+#include <arithmetic/serialize.h>
+
+#include <cstdio>
+
+using namespace arithmetic;
+
+const unsigned char *const Builtin::data[Builtin::COUNT] = {nullptr, nullptr, nullptr, nullptr, nullptr};
+const size_t Builtin::size[Builtin::COUNT] = {0, 0, 0, 0, 0};
+
+int main() {
+	printf("// Generated by tools/genrules.cpp, do not edit.\n\n");
+	printf("#include <arithmetic/builtin.h>\n\n");
+	printf("namespace arithmetic {\n\n");
+
+	vector<size_t> sizes;
+	for (int i = 0; i < Builtin::COUNT; i++) {
+		string data = serialize(Builtin::build(i));
+		sizes.push_back(data.size());
+
+		printf("static const unsigned char %sData[%zu] = {", Builtin::name(i), data.size());
+		for (size_t j = 0; j < data.size(); j++) {
+			printf("%s%s%u", j == 0 ? "" : ",", j%16 == 0 ? "\n\t" : " ", (unsigned)(unsigned char)data[j]);
+		}
+		printf("\n};\n\n");
+	}
+
+	printf("const unsigned char *const Builtin::data[Builtin::COUNT] = {\n");
+	for (int i = 0; i < Builtin::COUNT; i++) {
+		printf("\t%sData,\n", Builtin::name(i));
+	}
+	printf("};\n\n");
+
+	printf("const size_t Builtin::size[Builtin::COUNT] = {\n");
+	for (int i = 0; i < Builtin::COUNT; i++) {
+		printf("\t%zu,\n", sizes[i]);
+	}
+	printf("};\n\n");
+
+	printf("}\n");
+	return 0;
+}